@@ -19,4 +19,56 @@ void heapmgr_free(void *pv_bytes);
    pointer to space that was not previously allocated by
    heapmgr_malloc(). */
 
+/* Bucket count of the free-list search histogram.  Bucket 0 counts
+   searches that visited no node; bucket k (k >= 1) counts searches
+   that visited 2^(k-1) .. 2^k - 1 nodes; the last bucket also holds
+   everything longer. */
+enum {HEAPMGR_SEARCH_BUCKETS = 16};
+
+static inline int heapmgr_search_bucket(unsigned long ul_n)
+/* Return the search histogram bucket of a search that visited ul_n
+   nodes: 0 for none, else floor(log2 ul_n) + 1, capped at the last
+   bucket. */
+{
+   int i_b;
+   if (ul_n == 0)
+      return 0;
+   i_b = (int)(sizeof(unsigned long) * 8) - __builtin_clzl(ul_n);
+   return (i_b < HEAPMGR_SEARCH_BUCKETS) ? i_b : HEAPMGR_SEARCH_BUCKETS - 1;
+}
+
+struct heapmgr_stats {
+   size_t ui_heap_bytes;       /* bytes obtained from the system */
+   size_t ui_bytes_in_use;     /* bytes in allocated blocks, overhead
+                                  included */
+   size_t ui_bytes_free;       /* bytes in free blocks */
+   size_t ui_free_blocks;      /* number of free blocks */
+   size_t ui_largest_free;     /* bytes in the largest free block */
+   unsigned long ul_mallocs;   /* successful heapmgr_malloc() calls */
+   unsigned long ul_frees;     /* heapmgr_free() calls with non-NULL */
+   unsigned long ul_growths;   /* times the heap was grown */
+   unsigned long ul_splits;    /* free blocks split by an allocation */
+   unsigned long ul_coalesces; /* pairs of free blocks merged */
+   unsigned long aul_search_hist[HEAPMGR_SEARCH_BUCKETS];
+                               /* free-list nodes visited per malloc */
+};
+
+void heapmgr_stats(struct heapmgr_stats *ps_stats);
+/* Fill *ps_stats with the heap manager's current statistics.  Fields
+   an implementation cannot observe are set to 0.  The counters are
+   maintained on the hot paths and are always available, including in
+   NDEBUG builds. */
+
+extern const int heapmgr_thread_safe __attribute__((weak));
+/* Optional.  An implementation whose functions may be called from
+   several threads at once defines heapmgr_thread_safe as 1.  Clients
+   that run several threads must check &heapmgr_thread_safe != NULL
+   first and serialize all calls themselves if it is absent or 0. */
+
+void heapmgr_profile_dump(void) __attribute__((weak));
+/* Optional.  An implementation built with per-phase profiling
+   (heapmgr1.c with -D HEAPMGR_PROFILE) defines heapmgr_profile_dump
+   to write the time spent in each internal phase to stdout.  Clients
+   must check heapmgr_profile_dump != NULL before calling it. */
+
 #endif
\ No newline at end of file
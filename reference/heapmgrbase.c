@@ -7,6 +7,7 @@
 #include <assert.h>
 
 #include "chunkbase.h"  /* Provides Chunk_T and span-based header API */
+#include "heapmgr.h"
 
 #define FALSE 0
 #define TRUE  1
@@ -22,6 +23,10 @@ static Chunk_T s_free_head = NULL;
  * s_heap_hi moves forward whenever the heap grows. */
 static void *s_heap_lo = NULL, *s_heap_hi = NULL;
 
+/* Counters reported by heapmgr_stats(). Free-space fields are
+ * computed on demand from the free list. */
+static struct heapmgr_stats s_stats;
+
 /*--------------------------------------------------------------------*/
 /* check_heap_validity
  *
@@ -135,6 +140,7 @@ coalesce_two(Chunk_T a, Chunk_T b)
 
     chunk_set_span_units(a, chunk_get_span_units(a) + chunk_get_span_units(b));
     chunk_set_next_free(a, chunk_get_next_free(b));
+    s_stats.ul_coalesces++;
     return a;
 }
 
@@ -177,6 +183,7 @@ split_for_alloc(Chunk_T c, size_t need_units)
     chunk_set_span_units(alloc, alloc_span);
     chunk_set_status(alloc, CHUNK_USED);
     chunk_set_next_free(alloc, chunk_get_next_free(c));  /* harmless for allocated */
+    s_stats.ul_splits++;
 
     return alloc;
 }
@@ -285,6 +292,8 @@ sys_grow_and_link(Chunk_T prev, size_t need_units)
         return NULL;
 
     s_heap_hi = sbrk(0); // 현재 위치 가쟈와서 힙의 끝을 표현하는 변수에 세팅
+    s_stats.ui_heap_bytes += grow_span * CHUNK_UNIT;
+    s_stats.ul_growths++;
 
     chunk_set_span_units(c, (int)grow_span);
     chunk_set_next_free(c, NULL);
@@ -299,6 +308,24 @@ sys_grow_and_link(Chunk_T prev, size_t need_units)
     return c;
 }
 
+/*--------------------------------------------------------------------*/
+/* count_malloc
+ *
+ * Record a successful allocation whose first-fit search visited
+ * 'visited' free-list nodes (see HEAPMGR_SEARCH_BUCKETS). */
+static void
+count_malloc(unsigned long visited)
+{
+    int b = 0;
+
+    while (visited != 0 && b < HEAPMGR_SEARCH_BUCKETS - 1) {
+        visited >>= 1;
+        b++;
+    }
+    s_stats.ul_mallocs++;
+    s_stats.aul_search_hist[b]++;
+}
+
 /*--------------------------------------------------------------------*/
 /* heapmgr_malloc
  *
@@ -317,6 +344,7 @@ heapmgr_malloc(size_t size)
     static int booted = FALSE;
     Chunk_T cur, prev, prevprev;
     size_t need_units;
+    unsigned long visited = 0;
 
     if (size == 0)
         return NULL;
@@ -339,11 +367,13 @@ heapmgr_malloc(size_t size)
             else
                 freelist_detach(prev, cur);
 
+            count_malloc(visited);
             assert(check_heap_validity());
             return (void *)((char *)cur + CHUNK_UNIT);
         }
         prevprev = prev;
         prev = cur;
+        visited++;
     }
 
     /* Need to grow the heap. */
@@ -362,6 +392,7 @@ heapmgr_malloc(size_t size)
     else
         freelist_detach(prev, cur);
 
+    count_malloc(visited);
     assert(check_heap_validity());
     return (void *)((char *)cur + CHUNK_UNIT);
 }
@@ -401,6 +432,31 @@ heapmgr_free(void *p)
         freelist_push_front(c);
     else
         (void)freelist_insert_after(prev, c);
+    s_stats.ul_frees++;
 
     assert(check_heap_validity());
 }
+
+/*--------------------------------------------------------------------*/
+/* heapmgr_stats
+ *
+ * Copy the counters into *ps and derive the free-space fields by
+ * walking the free list once. */
+void
+heapmgr_stats(struct heapmgr_stats *ps)
+{
+    Chunk_T c;
+
+    assert(ps != NULL);
+
+    *ps = s_stats;
+    for (c = s_free_head; c != NULL; c = chunk_get_next_free(c)) {
+        size_t bytes = (size_t)chunk_get_span_units(c) * CHUNK_UNIT;
+
+        ps->ui_bytes_free += bytes;
+        ps->ui_free_blocks++;
+        if (bytes > ps->ui_largest_free)
+            ps->ui_largest_free = bytes;
+    }
+    ps->ui_bytes_in_use = ps->ui_heap_bytes - ps->ui_bytes_free;
+}
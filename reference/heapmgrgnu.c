@@ -6,6 +6,20 @@
 
 #include "heapmgr.h"
 #include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+
+/* mallinfo2() appeared in glibc 2.33. */
+#if defined(__GLIBC_PREREQ)
+#if __GLIBC_PREREQ(2, 33)
+#define HAVE_MALLINFO2
+#endif
+#endif
+
+/*--------------------------------------------------------------------*/
+
+/* GNU malloc() and free() are thread-safe. */
+const int heapmgr_thread_safe = 1;
 
 /*--------------------------------------------------------------------*/
 
@@ -31,3 +45,30 @@ void heapmgr_free(void *pv_bytes)
 {
    free(pv_bytes);
 }
+
+/*--------------------------------------------------------------------*/
+
+void heapmgr_stats(struct heapmgr_stats *ps_stats)
+
+/* Fill *ps_stats from glibc's mallinfo2(), or from mallinfo() before
+   glibc 2.33, whose int fields are clamped at 0 once they overflow.
+   Memory glibc obtained with mmap() counts as heap and in use.  glibc
+   does not expose growth, split, coalesce or search counts, so those
+   are 0. */
+
+{
+#ifdef HAVE_MALLINFO2
+   struct mallinfo2 s_info = mallinfo2();
+#define INFO(field) ((size_t)s_info.field)
+#else
+   struct mallinfo s_info = mallinfo();
+#define INFO(field) (s_info.field < 0 ? (size_t)0 : (size_t)s_info.field)
+#endif
+
+   memset(ps_stats, 0, sizeof(*ps_stats));
+   ps_stats->ui_heap_bytes = INFO(arena) + INFO(hblkhd);
+   ps_stats->ui_bytes_in_use = INFO(uordblks) + INFO(hblkhd);
+   ps_stats->ui_bytes_free = INFO(fordblks);
+   ps_stats->ui_free_blocks = INFO(ordblks) + INFO(smblks);
+#undef INFO
+}
@@ -14,6 +14,7 @@ typedef struct header Header;
 
 static Header base;       /* empty list to get started */
 static Header *freep = NULL;     /* start of free list */
+static struct heapmgr_stats stats;  /* counters for heapmgr_stats() */
 
 static Header *morecore(unsigned);
 
@@ -22,6 +23,7 @@ void *heapmgr_malloc(size_t nbytes)
 {
     Header *p, *prevp;
     unsigned nunits;
+    unsigned long nvisited = 0;
 
     nunits = (nbytes+sizeof(Header)-1)/sizeof(Header) + 1; // 몇 칸 차지할 놈인지 체크
     if ((prevp = freep) == NULL) { /* no free list yet */
@@ -38,10 +40,14 @@ void *heapmgr_malloc(size_t nbytes)
                 p->size -= nunits;
                 p += p->size;
                 p->size = nunits;
+                stats.ul_splits++;
             }
             freep = prevp;
+            stats.ul_mallocs++;
+            stats.aul_search_hist[heapmgr_search_bucket(nvisited)]++;
             return (void*)(p+1);
         }
+        nvisited++;
         if (p == freep)  /* wrapped around free list 그리고 첫 init시에도 여기로 옴 */ 
             if ((p = morecore(nunits)) == NULL) // 추가 메모리 확보한 뒤, 거기로 가기
                 return NULL;   /* none left */
@@ -63,7 +69,10 @@ static Header *morecore(unsigned int nu)
         return NULL;
     up = (Header *) cp; // 헤더 구조체의 포인터로 여기기로 함. 헤더 형태로 구조체를 해석하고 값을 넣어주려고 그럼. 
     up->size = nu;
+    stats.ui_heap_bytes += (size_t)nu * sizeof(Header);
+    stats.ul_growths++;
     heapmgr_free((void *)(up+1)); // 헤더가 이미 차지한 뒤의 데이터부터 heapmgr_free에 넘겨줌.
+    stats.ul_frees--;  /* internal free, not a client call */
     return freep;
 }
 
@@ -81,12 +90,38 @@ void heapmgr_free(void *ap) // ap = address pointer
     if (bp + bp->size == p->ptr) {    /* join to upper nbr */
         bp->size += p->ptr->size;
         bp->ptr = p->ptr->ptr;
+        stats.ul_coalesces++;
     } else
         bp->ptr = p->ptr; // 일반적 수순
     if (p + p->size == bp) {            /* join to lower nbr */
         p->size += bp->size;
         p->ptr = bp->ptr;
+        stats.ul_coalesces++;
     } else
         p->ptr = bp; // 일반적 수순
     freep = p;
+    stats.ul_frees++;
+}
+
+/* heapmgr_stats:  report counters and walk the free list for sizes */
+void heapmgr_stats(struct heapmgr_stats *ps)
+{
+    Header *p;
+
+    *ps = stats;
+    ps->ui_bytes_free = ps->ui_free_blocks = ps->ui_largest_free = 0;
+    if (freep != NULL) {
+        p = freep;
+        do {
+            if (p != &base) {    /* base is a zero-size sentinel */
+                size_t bytes = (size_t)p->size * sizeof(Header);
+                ps->ui_bytes_free += bytes;
+                ps->ui_free_blocks++;
+                if (bytes > ps->ui_largest_free)
+                    ps->ui_largest_free = bytes;
+            }
+            p = p->ptr;
+        } while (p != freep);
+    }
+    ps->ui_bytes_in_use = ps->ui_heap_bytes - ps->ui_bytes_free;
 }
\ No newline at end of file
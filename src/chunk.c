@@ -20,39 +20,43 @@
 #include "chunk.h"
 
 /* Internal header layout
- * - status: CHUNK_FREE or CHUNK_USED
- * - span:   total units, including the header itself
- * - next:   next-free pointer for the singly-linked free list
+ * - word:   (span << FLAG_BITS) | flags
+ *           span은 헤더/푸터 포함 전체 unit 수, flags는 FLAG_ALLOC/FLAG_HEADER
+ *           푸터의 flags는 항상 0 (헤더 아님)
+ * - ptr:    헤더면 next-free, 푸터면 prev-free
  */
 struct Chunk {
-    int     status;
-    int     span;
+    size_t  word;
     Chunk_T ptr;
 };
 
+#define WORD_SPAN(w)  ((w) >> FLAG_BITS)
+#define WORD_FLAGS(w) ((w) & FLAG_MASK)
+
 /* ----------------------- Getters / Setters ------------------------ */
 /* 받은 주소를 기준으로 header flag를 ON. header assertion 걸려 있는 애들이 많아서
 명시적으로 세팅해주도록 하자.
 */
 void header_chunk_init(Chunk_T h_c) {
-    h_c->status |= FLAG_HEADER;
+    // 새 헤더 자리는 예전 payload라 쓰레기 비트가 있을 수 있음. 통째로 초기화
+    h_c->word = FLAG_HEADER;
 }
 bool chunk_is_allocated(Chunk_T c) {
     assert(c); // not null인 것만 하도록. 외부에서 거르도록
     // 먼저 이 친구가 헤더인지 푸터인지 확인
     int is_header = chunk_is_header(c);
     if (is_header) {
-        return (c-> status & FLAG_ALLOC) != 0;
+        return (c->word & FLAG_ALLOC) != 0;
     } else {
         // 푸터인 경우, 이전 블록의 헤더로 가서 확인
-        Chunk_T header = c - (c->span -1);
-        return (header-> status & FLAG_ALLOC) != 0;
+        Chunk_T header = c - (WORD_SPAN(c->word) - 1);
+        return (header->word & FLAG_ALLOC) != 0;
     }
 }
 
 bool chunk_is_header(Chunk_T c) {
     assert(c); // not null인 것만 하도록. 외부에서 거르도록
-    return (c->status & FLAG_HEADER) != 0;
+    return (c->word & FLAG_HEADER) != 0;
 }
 
 void header_chunk_set_status_allocated(Chunk_T h_c) {
@@ -64,7 +68,7 @@ void header_chunk_set_status_allocated(Chunk_T h_c) {
     assert(chunk_get_span_units(h_c) > 2);
 
 
-    h_c->status |= FLAG_ALLOC;
+    h_c->word |= FLAG_ALLOC;
 }
 
 void header_chunk_set_status_free(Chunk_T h_c) {
@@ -74,20 +78,22 @@ void header_chunk_set_status_free(Chunk_T h_c) {
     // 이거 하는데 span이 2 이하면 좀 이상한 애임.
     assert(chunk_get_span_units(h_c) > 2);
 
-    h_c -> status &= ~FLAG_ALLOC;
+    h_c->word &= ~(size_t)FLAG_ALLOC;
 }
 
 
 
-int   chunk_get_span_units(Chunk_T c)             { return c->span; }
-/*span units를 헤더 뿐 아니라 푸터에서도 업데이트해준다.*/
-void  header_chunk_set_span_units(Chunk_T h_c, int span_u) { 
+size_t chunk_get_span_units(Chunk_T c)            { return WORD_SPAN(c->word); }
+/*span units를 헤더 뿐 아니라 푸터에서도 업데이트해준다.
+ * 푸터 word는 통째로 덮어써서 flag를 0으로 만든다. 예전 payload/헤더 자리였던
+ * 곳에 푸터가 생기면 남아 있던 비트가 헤더로 오인될 수 있기 때문. */
+void   header_chunk_set_span_units(Chunk_T h_c, size_t span_u) {
     // 항상 헤더에서만 이 명령을 실행할 수 있게 하자.
-    assert(chunk_is_header(h_c)); 
-    // span_u가 기존보다 크냐 작냐에 따라서 로직이 좀 달라짐
-    Chunk_T f_c = h_c + (span_u -1);;
-    h_c->span = span_u; 
-    f_c->span = span_u;
+    assert(chunk_is_header(h_c));
+    assert(span_u >= 2 && span_u <= CHUNK_MAX_SPAN_UNITS);
+    Chunk_T f_c = h_c + (span_u - 1);
+    h_c->word = (span_u << FLAG_BITS) | WORD_FLAGS(h_c->word);
+    f_c->word = span_u << FLAG_BITS;
     // 포인터 정보도 갖다 박기
     // 생각해보니 footer ptr은 이전꺼를 갖고 있어야 하는데 어케 함? ㅋㅋ
 }
@@ -135,8 +141,8 @@ Chunk_T chunk_get_prev(Chunk_T c, void *start, void *end) {
     }
 
     // 여기서 이전 블록의 헤더로 가기, span 참조
-    int p_span = p_footer->span;
-    int p_span_except_footer = p_span - 1;
+    size_t p_span = WORD_SPAN(p_footer->word);
+    size_t p_span_except_footer = p_span - 1;
     Chunk_T p_header = p_footer - p_span_except_footer;
 
     assert((void *)p_header >= start);
@@ -146,7 +152,7 @@ Chunk_T chunk_get_prev(Chunk_T c, void *start, void *end) {
 
 Chunk_T chunk_get_next(Chunk_T c, void *start, void *end) {
     assert((void *)c >= start);
-    Chunk_T n_header = c + c->span;
+    Chunk_T n_header = c + WORD_SPAN(c->word);
     if ((void*) n_header >= end) return NULL;
     return n_header;
 }
@@ -165,7 +171,7 @@ chunk_is_valid(Chunk_T c, void *start, void *end)
 
     if (c < (Chunk_T)start) { fprintf(stderr, "Bad heap start\n"); return 0; }
     if (c >= (Chunk_T)end)  { fprintf(stderr, "Bad heap end\n");   return 0; }
-    if (c->span <= 0)       { fprintf(stderr, "Non-positive span\n"); return 0; }
+    if (WORD_SPAN(c->word) == 0) { fprintf(stderr, "Non-positive span\n"); return 0; }
     return 1;
 }
 #endif
@@ -14,6 +14,7 @@
 #define _CHUNK_
 #pragma once
 
+#include <stddef.h>
 #include <stdbool.h>
 #include <unistd.h>
 
@@ -30,15 +31,22 @@
 
 typedef struct Chunk *Chunk_T;
 
-/* Status flags */
+/* Status flags
+ * span과 같은 워드의 하위 비트에 packing된다. (word = span << FLAG_BITS | flags)
+ * 따라서 헤더 크기(16 bytes)는 그대로 두고 span을 64-bit로 쓸 수 있음. */
 # define FLAG_ALLOC (1u << 0) /*allocated면 0001, free면 0000*/
 # define FLAG_HEADER (1u << 1) /*chunk가 헤더면 0010, 푸터면 0000*/
+# define FLAG_BITS 2
+# define FLAG_MASK ((1u << FLAG_BITS) - 1)
 
 /* Chunk unit size (bytes). This equals sizeof(struct Chunk) in this baseline. */
 enum {
     CHUNK_UNIT = 16,
 };
 
+/* 표현 가능한 최대 span (flag 비트를 제외한 나머지 비트) */
+# define CHUNK_MAX_SPAN_UNITS ((size_t)-1 >> FLAG_BITS)
+
 /* ----------------------- Getters / Setters ------------------------ */
 
 void header_chunk_init(Chunk_T h_c);
@@ -52,8 +60,8 @@ void header_chunk_set_status_free(Chunk_T h_c);
 /* chunk_get_span_units / chunk_set_span_units:
  * 사이즈를 unit 단위로 다루기, 헤더와 푸터 둘 다 있으므로 사이즈는 항상 아래와 같음. 
  * (span = 2 header unit + payload units) 즉, 항상 2를 더해준 뒤 parameter에 패스해야 함*/
-int   chunk_get_span_units(Chunk_T c);
-void  header_chunk_set_span_units(Chunk_T h_c, int span_units);
+size_t chunk_get_span_units(Chunk_T c);
+void   header_chunk_set_span_units(Chunk_T h_c, size_t span_units);
 
 Chunk_T header_chunk_get_next_free(Chunk_T h_c);
 void    header_chunk_set_next_free(Chunk_T h_c, Chunk_T next_h_c);
@@ -1,27 +1,402 @@
 
 #include <stdlib.h>
+#include <stdint.h>
 #include <assert.h>
+#include <time.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
 #include "chunk.h"
+#include "heapmgr.h"
+#include "heapmgr1.h"
 
 #define FALSE 0
 #define TRUE  1
 
-/* heap growth 시, 최소 단위
+/* heap growth 시, 최소 단위 (자가 튜닝의 시작값이자 하한)
 */
 enum { SYS_MIN_ALLOC_UNITS = 1024 };
 
+/* 자가 튜닝되는 값들 (tune_window, HEAPMGR_OPTS 참고).
+ * s_grow_units: heap growth 최소 payload unit 수
+ * s_split_min: 분할 후 남는 블록의 최소 span. 이보다 작게 남으면 통째로 할당 (최소 3) */
+static size_t s_grow_units = SYS_MIN_ALLOC_UNITS;
+static size_t s_split_min = 3;
+
+/* 한 블록이 가질 수 있는 최대 payload unit 수.
+ * sbrk()가 intptr_t를 받으므로 span * CHUNK_UNIT이 INTPTR_MAX를 넘으면 안 됨. */
+#define MAX_PAYLOAD_UNITS ((size_t)INTPTR_MAX / CHUNK_UNIT - 2)
+
 /* Free list head (오름차순 주소 정렬) */
 static Chunk_T s_free_head = NULL;
 
+/* next-fit의 탐색 시작 블록 (NULL이면 head부터).
+ * 가리키던 블록이 detach되면 다음 free 블록으로, 앞 블록에 병합되면 그 블록으로 옮김 */
+static Chunk_T s_rover = NULL;
+
 /* Heap 경계: [s_heap_lo, s_heap_hi).
  * s_heap_hi는 heap이 커질 때마다 앞으로 이동. */
 static void *s_heap_lo = NULL, *s_heap_hi = NULL;
 
+/* 런타임 통계. release 빌드에서도 항상 켜져 있음.
+ * writer는 heapmgr 호출 스레드 하나뿐이라 RMW(lock add) 대신 relaxed load/store로
+ * 충분하고, 다른 스레드(나 stats page를 읽는 다른 프로세스)가 읽어도 카운터 값은
+ * 찢어지지 않음. ui_bytes_in_use, ui_largest_free는 heapmgr_stats()에서 계산.
+ * 단 ui_largest_free를 위한 free-list 순회는 HEAP_LOCK으로만 보호되고, 그 lock은
+ * HEAPMGR_DEFER 빌드가 아니면 no-op이므로 heapmgr_stats()는 malloc/free와 같은
+ * 스레드에서 부르거나 호출자가 직렬화해야 한다.
+ * 값은 s_pstats가 가리키는 곳에 있고, stats page가 켜지면 그 페이지로 옮겨 간다
+ * (stats_page_boot 참고). */
+static struct heapmgr_stats s_stats;
+static struct heapmgr_stats *s_pstats = &s_stats;
+
+#define STAT_ADD(field, n) \
+    __atomic_store_n(&s_pstats->field, \
+        __atomic_load_n(&s_pstats->field, __ATOMIC_RELAXED) + (n), __ATOMIC_RELAXED)
+#define STAT_SUB(field, n) STAT_ADD(field, -(n))
+
+
+static size_t bytes_to_payload_units(size_t bytes) {
+    return (bytes + (CHUNK_UNIT - 1)) / CHUNK_UNIT; 
+}
+
+static Chunk_T header_from_payload(void *h_p) {
+    return (Chunk_T)((char *)h_p - CHUNK_UNIT);
+}
+
+static Chunk_T footer_from_header(Chunk_T h_c) {
+    assert(chunk_is_header(h_c));
+    size_t span_units = chunk_get_span_units(h_c);
+    return (Chunk_T)((char *)h_c + (span_units - 1) * CHUNK_UNIT);
+}
+
+/* Phase별 tick 집계 (-D HEAPMGR_PROFILE)
+ * phase에 들어가거나 나올 때마다 tick을 읽어서, 직전 읽기 이후의 시간을 그동안
+ * 실행 중이던(스택 맨 위) phase에 더한다. 그래서 중첩된 phase(grow 안의 insert,
+ * insert 안의 coalesce 등)는 바깥 phase에서 빠지고, 모든 phase 합이 heapmgr 호출
+ * 전체 시간이 된다. search는 malloc/free 본체에서 다른 phase를 뺀 나머지
+ * (free-list 순회와 통계 갱신). 정의하지 않으면 PROF_*는 빈 매크로. */
+#ifdef HEAPMGR_PROFILE
+enum prof_phase {
+    PH_MALLOC_SEARCH, PH_FREE_SEARCH, PH_SPLIT, PH_DETACH, PH_INSERT,
+    PH_COALESCE, PH_GROW, PH_CHECK, PH_COUNT
+};
+static const char *const s_prof_names[PH_COUNT] = {
+    "malloc search", "free search", "split", "detach", "insert",
+    "coalesce", "grow", "check"
+};
+static unsigned long long s_prof_ticks[PH_COUNT], s_prof_calls[PH_COUNT];
+static unsigned long long s_prof_last;
+static int s_prof_stack[8]; // 최대 malloc > grow > insert > coalesce
+static int s_prof_depth = 0;
+
+/* test/latency.h와 같은 tick: x86 TSC, AArch64 virtual counter, 그 외 ns */
+static inline unsigned long long prof_ticks(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned int lo, hi;
+    __asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((unsigned long long)hi << 32) | lo;
+#elif defined(__aarch64__)
+    unsigned long long v;
+    __asm__ __volatile__("isb; mrs %0, cntvct_el0" : "=r"(v));
+    return v;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ull + (unsigned long long)ts.tv_nsec;
+#endif
+}
+
+static inline void prof_push(int ph) {
+    unsigned long long t = prof_ticks();
+    if (s_prof_depth > 0) s_prof_ticks[s_prof_stack[s_prof_depth - 1]] += t - s_prof_last;
+    s_prof_stack[s_prof_depth++] = ph;
+    s_prof_calls[ph]++;
+    s_prof_last = t;
+}
+
+static inline void prof_pop(void) {
+    unsigned long long t = prof_ticks();
+    s_prof_ticks[s_prof_stack[--s_prof_depth]] += t - s_prof_last;
+    s_prof_last = t;
+}
+
+#define PROF_PUSH(ph) prof_push(ph)
+#define PROF_POP()    prof_pop()
+
+/* heapmgr_profile_dump: phase별 호출 수, tick, 비율을 stdout에 출력 */
+void heapmgr_profile_dump(void) {
+    unsigned long long total = 0;
+    int i;
+
+    for (i = 0; i < PH_COUNT; i++) total += s_prof_ticks[i];
+    printf("%-14s %12s %16s %10s %6s\n", "phase", "calls", "ticks", "ticks/call", "%");
+    for (i = 0; i < PH_COUNT; i++) {
+        printf("%-14s %12llu %16llu %10.1f %6.2f\n", s_prof_names[i],
+               s_prof_calls[i], s_prof_ticks[i],
+               s_prof_calls[i] ? (double)s_prof_ticks[i] / s_prof_calls[i] : 0.0,
+               total ? 100.0 * s_prof_ticks[i] / total : 0.0);
+    }
+    printf("%-14s %12s %16llu\n", "total", "", total);
+}
+#else
+#define PROF_PUSH(ph) ((void)0)
+#define PROF_POP()    ((void)0)
+#endif
+
+/* 지연 free (-D HEAPMGR_DEFER, 아래 defer_* 참고)에서는 백그라운드 스레드도 heap을
+ * 고치므로, heap 상태는 모두 s_heap_lock 아래에서만 읽고 쓴다. 아니면 빈 매크로 */
+#ifdef HEAPMGR_DEFER
+#ifdef HEAPMGR_PROFILE
+#error "HEAPMGR_DEFER cannot be combined with HEAPMGR_PROFILE"
+#endif
+static pthread_mutex_t s_heap_lock = PTHREAD_MUTEX_INITIALIZER;
+#define HEAP_LOCK()   pthread_mutex_lock(&s_heap_lock)
+#define HEAP_UNLOCK() pthread_mutex_unlock(&s_heap_lock)
+#else
+#define HEAP_LOCK()   ((void)0)
+#define HEAP_UNLOCK() ((void)0)
+#endif
+
+/* Free 블록 side index (-D HEAPMGR_INDEX)
+ * free-list의 블록들을 주소 순으로 두 배열에 따로 둔다 (structure-of-arrays).
+ *  spans[i]: i번째 free 블록의 span (UINT32_MAX에서 포화)
+ *  addrs[i]: 그 블록의 헤더
+ * first-fit은 헤더를 하나씩 따라가는 대신 spans를 SIMD로 훑고 (AVX2 16개, SSE2 8개씩,
+ * 그 외 scalar), free의 삽입 위치는 addrs의 이분 탐색으로 찾는다. 찾은 블록의 헤더와
+ * 푸터 주소는 index만으로 알 수 있으므로 읽기 전에 미리 prefetch한다.
+ * list는 그대로 유지하므로 다른 정책과 검사 코드는 바뀌지 않음. 배열은 mmap으로 잡아
+ * sbrk heap을 건드리지 않고, 늘릴 수 없으면 index를 버리고 list만 쓴다. */
+#ifdef HEAPMGR_INDEX
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+enum { IDX_MIN_CAP = 1024 };
+
+static struct {
+    uint32_t *spans;
+    Chunk_T *addrs;
+    size_t n, cap;
+    size_t hit;     // 마지막으로 찾은 slot. idx_slot이 이분 탐색 전에 먼저 확인
+    int off;        // mmap 실패로 index를 버림
+} s_idx;
+
+static inline uint32_t idx_span(size_t span) {
+    return (span < UINT32_MAX) ? (uint32_t)span : UINT32_MAX;
+}
+
+/* idx_scan_*: spans[i..n)에서 need 이상인 첫 위치, 없으면 n */
+typedef size_t (*idx_scan_fn)(const uint32_t *spans, size_t i, size_t n, uint32_t need);
+
+static size_t idx_scan_scalar(const uint32_t *spans, size_t i, size_t n, uint32_t need) {
+    while (i < n && spans[i] < need) i++;
+    return i;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+/* SSE2/AVX2에는 unsigned 32비트 비교가 없으므로 부호 비트를 뒤집어 signed로 비교.
+ * x >= need  <=>  (x ^ 2^31) > ((need - 1) ^ 2^31)   (need >= 3) */
+__attribute__((target("sse2")))
+static size_t idx_scan_sse2(const uint32_t *spans, size_t i, size_t n, uint32_t need) {
+    const __m128i bias = _mm_set1_epi32(INT32_MIN);
+    const __m128i lim = _mm_set1_epi32((int32_t)((need - 1) ^ 0x80000000u));
+
+    for (; i + 8 <= n; i += 8) {
+        __m128i a = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(spans + i)), bias);
+        __m128i b = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(spans + i + 4)), bias);
+        int m = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(a, lim)))
+              | _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(b, lim))) << 4;
+        if (m) return i + (size_t)__builtin_ctz((unsigned)m);
+    }
+    return idx_scan_scalar(spans, i, n, need);
+}
+
+__attribute__((target("avx2")))
+static size_t idx_scan_avx2(const uint32_t *spans, size_t i, size_t n, uint32_t need) {
+    const __m256i bias = _mm256_set1_epi32(INT32_MIN);
+    const __m256i lim = _mm256_set1_epi32((int32_t)((need - 1) ^ 0x80000000u));
+
+    for (; i + 16 <= n; i += 16) {
+        __m256i a = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(spans + i)), bias);
+        __m256i b = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(spans + i + 8)), bias);
+        unsigned m = (unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(a, lim)))
+                   | (unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(b, lim))) << 8;
+        if (m) return i + (size_t)__builtin_ctz(m);
+    }
+    return idx_scan_sse2(spans, i, n, need);
+}
+#endif
+
+static idx_scan_fn s_idx_scan = idx_scan_scalar;
+
+/* idx_boot: CPU가 지원하는 가장 넓은 scan 선택 */
+static void idx_boot(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) s_idx_scan = idx_scan_avx2;
+    else if (__builtin_cpu_supports("sse2")) s_idx_scan = idx_scan_sse2;
+#endif
+}
+
+/* idx_slot: h가 index에 있으면 그 위치, 없으면 h보다 큰 첫 위치 (lower bound).
+ * 직전 탐색 위치(hit)가 맞으면 이분 탐색을 생략 */
+static size_t idx_slot(Chunk_T h) {
+    size_t lo = 0, hi = s_idx.n;
+
+    if (s_idx.hit <= s_idx.n
+        && (s_idx.hit == s_idx.n || s_idx.addrs[s_idx.hit] >= h)
+        && (s_idx.hit == 0 || s_idx.addrs[s_idx.hit - 1] < h))
+        return s_idx.hit;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (s_idx.addrs[mid] < h) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static void *idx_map(size_t bytes) {
+    void *p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return (p == MAP_FAILED) ? NULL : p;
+}
+
+/* idx_reserve: 한 칸 더 넣을 자리 확보. 실패하면 index를 끔 */
+static int idx_reserve(void) {
+    size_t cap = s_idx.cap ? 2 * s_idx.cap : IDX_MIN_CAP;
+    uint32_t *spans;
+    Chunk_T *addrs;
+
+    if (s_idx.n < s_idx.cap) return TRUE;
+    spans = idx_map(cap * sizeof(*spans));
+    addrs = idx_map(cap * sizeof(*addrs));
+    if (spans == NULL || addrs == NULL) {
+        if (spans) munmap(spans, cap * sizeof(*spans));
+        if (addrs) munmap(addrs, cap * sizeof(*addrs));
+        s_idx.off = TRUE;
+        return FALSE;
+    }
+    if (s_idx.cap) {
+        memcpy(spans, s_idx.spans, s_idx.n * sizeof(*spans));
+        memcpy(addrs, s_idx.addrs, s_idx.n * sizeof(*addrs));
+        munmap(s_idx.spans, s_idx.cap * sizeof(*spans));
+        munmap(s_idx.addrs, s_idx.cap * sizeof(*addrs));
+    }
+    s_idx.spans = spans;
+    s_idx.addrs = addrs;
+    s_idx.cap = cap;
+    return TRUE;
+}
+
+static void idx_insert_at(size_t i, Chunk_T h, size_t span) {
+    if (!idx_reserve()) return;
+    memmove(s_idx.spans + i + 1, s_idx.spans + i, (s_idx.n - i) * sizeof(*s_idx.spans));
+    memmove(s_idx.addrs + i + 1, s_idx.addrs + i, (s_idx.n - i) * sizeof(*s_idx.addrs));
+    s_idx.spans[i] = idx_span(span);
+    s_idx.addrs[i] = h;
+    s_idx.n++;
+}
+
+static void idx_remove_at(size_t i) {
+    s_idx.n--;
+    memmove(s_idx.spans + i, s_idx.spans + i + 1, (s_idx.n - i) * sizeof(*s_idx.spans));
+    memmove(s_idx.addrs + i, s_idx.addrs + i + 1, (s_idx.n - i) * sizeof(*s_idx.addrs));
+}
+
+static inline void idx_set(size_t i, Chunk_T h, size_t span) {
+    s_idx.spans[i] = idx_span(span);
+    s_idx.addrs[i] = h;
+}
+
+/* idx_prefetch: i번째 블록의 헤더와 푸터를 곧 읽고 쓸 것이므로 미리 가져옴 */
+static inline void idx_prefetch(size_t i) {
+    char *h = (char *)s_idx.addrs[i];
+    __builtin_prefetch(h, 1);
+    if (s_idx.spans[i] != UINT32_MAX)
+        __builtin_prefetch(h + (s_idx.spans[i] - 1) * CHUNK_UNIT, 1);
+}
+#endif
 
 /*디버그용 함수*/
 #ifndef NDEBUG
+
+/* Incremental 검증 모드 (-D HEAPMGR_CHECK_SLICE=N)
+ * 매 호출마다 전체 heap을 도는 대신
+ *  1. 이번 연산이 건드린 블록과 그 이웃, free-list 링크만 완전히 검사하고
+ *  2. rotating cursor로 물리 블록 N개씩만 이어서 검사하고
+ *  3. HEAPMGR_CHECK_EVERY번 연산마다 한 번 전체 검사를 한다.
+ * 정의하지 않으면 예전처럼 매번 전체 검사. */
+#ifdef HEAPMGR_CHECK_SLICE
+#ifndef HEAPMGR_CHECK_EVERY
+#define HEAPMGR_CHECK_EVERY 4096
+#endif
+#define CHECK_HEAP_NOW(touched) check_heap_budgeted(touched)
+#else
+#define CHECK_HEAP_NOW(touched) check_heap_validity()
+#endif
+#ifdef HEAPMGR_PROFILE
+#define CHECK_HEAP(touched) \
+    ({ int ok_; PROF_PUSH(PH_CHECK); ok_ = CHECK_HEAP_NOW(touched); PROF_POP(); ok_; })
+#else
+#define CHECK_HEAP(touched) CHECK_HEAP_NOW(touched)
+#endif
+
+/* slice 검사를 이어갈 물리 블록 헤더. 병합으로 사라지면 coalesce_two가 옮김 */
+static Chunk_T s_check_cursor = NULL;
+
+/* check_chunk_local
+ * 헤더 h 하나와 물리적 이웃, (free라면) free-list 앞뒤 링크를 검사 */
+static int check_chunk_local(Chunk_T h) {
+    Chunk_T f, p, n;
+    size_t span;
+
+    if (!chunk_is_valid(h, s_heap_lo, s_heap_hi)) return FALSE;
+    if (!chunk_is_header(h)) { fprintf(stderr, "Non-header chunk in the heap\n"); return FALSE; }
+
+    span = chunk_get_span_units(h);
+    if (span < 3 || span > (size_t)((char *)s_heap_hi - (char *)h) / CHUNK_UNIT) {
+        fprintf(stderr, "Span out of heap\n");
+        return FALSE;
+    }
+    f = footer_from_header(h);
+    if (chunk_is_header(f) || chunk_get_span_units(f) != span) {
+        fprintf(stderr, "Header/footer mismatch\n");
+        return FALSE;
+    }
+
+    p = chunk_get_prev(h, s_heap_lo, s_heap_hi);
+    n = chunk_get_next(h, s_heap_lo, s_heap_hi);
+    if ((p && !chunk_is_header(p)) || (n && !chunk_is_header(n))) {
+        fprintf(stderr, "Corrupted neighbour chunk\n");
+        return FALSE;
+    }
+    if (chunk_is_allocated(h)) return TRUE;
+
+    if ((p && !chunk_is_allocated(p)) || (n && !chunk_is_allocated(n))) {
+        fprintf(stderr, "Uncoalesced adjacent free chunks\n");
+        return FALSE;
+    }
+
+    /* 양방향 링크: prev->next == h, next->prev == h, 주소 오름차순 */
+    n = header_chunk_get_next_free(h);
+    p = footer_chunk_get_prev_free(f);
+    if (n && (n <= h || footer_chunk_get_prev_free(footer_from_header(n)) != h)) {
+        fprintf(stderr, "Broken free-list next link\n");
+        return FALSE;
+    }
+    if (p ? (p >= h || header_chunk_get_next_free(p) != h) : s_free_head != h) {
+        fprintf(stderr, "Broken free-list prev link\n");
+        return FALSE;
+    }
+    return TRUE;
+}
+
 static int check_heap_validity(void) {
     Chunk_T w;
+    size_t n_free_blocks = 0;
 
     if (s_heap_lo == NULL) { fprintf(stderr, "Uninitialized heap start\n"); return FALSE; }
     if (s_heap_hi == NULL) { fprintf(stderr, "Uninitialized heap end\n");   return FALSE; }
@@ -37,46 +412,87 @@ static int check_heap_validity(void) {
     for (w = (Chunk_T)s_heap_lo;
          w && w < (Chunk_T)s_heap_hi;
          w = chunk_get_next(w, s_heap_lo, s_heap_hi)) {
-        if (!chunk_is_valid(w, s_heap_lo, s_heap_hi)) return FALSE;
+        if (!check_chunk_local(w)) return FALSE;
+        if (!chunk_is_allocated(w)) n_free_blocks++;
     }
 
+#ifdef HEAPMGR_INDEX
+    size_t slot = 0;
+#endif
     for (w = s_free_head; w; w = header_chunk_get_next_free(w)) {
-        Chunk_T n;
-
         if (chunk_is_allocated(w)) {
             fprintf(stderr, "Non-free chunk in the free list\n");
             return FALSE;
         }
         if (!chunk_is_valid(w, s_heap_lo, s_heap_hi)) return FALSE;
-
-        n = chunk_get_next(w, s_heap_lo, s_heap_hi);
-        if (n != NULL && n == header_chunk_get_next_free(w)) {
-            fprintf(stderr, "Uncoalesced adjacent free chunks\n");
+        if (n_free_blocks-- == 0) {
+            fprintf(stderr, "Free list longer than free blocks\n");
             return FALSE;
         }
+#ifdef HEAPMGR_INDEX
+        if (!s_idx.off && (slot >= s_idx.n || s_idx.addrs[slot] != w
+                           || s_idx.spans[slot] != idx_span(chunk_get_span_units(w)))) {
+            fprintf(stderr, "Free index out of sync with the free list\n");
+            return FALSE;
+        }
+        slot++;
+#endif
     }
-
+    if (n_free_blocks != 0) {
+        fprintf(stderr, "Free chunk missing from the free list\n");
+        return FALSE;
+    }
+#ifdef HEAPMGR_INDEX
+    if (!s_idx.off && slot != s_idx.n) {
+        fprintf(stderr, "Free index longer than the free list\n");
+        return FALSE;
+    }
+#endif
 
     return TRUE;
 }
-#endif
 
-static size_t bytes_to_payload_units(size_t bytes) {
-    return (bytes + (CHUNK_UNIT - 1)) / CHUNK_UNIT; 
-}
+#ifdef HEAPMGR_CHECK_SLICE
+static unsigned long s_check_ops = 0;
 
-static Chunk_T header_from_payload(void *h_p) {
-    return (Chunk_T)((char *)h_p - CHUNK_UNIT);
-}
-
-static Chunk_T footer_from_header(Chunk_T h_c) {
-    assert(chunk_is_header(h_c));
-    int span_units = chunk_get_span_units(h_c);
-    return (Chunk_T)((char *)h_c + (span_units - 1) * CHUNK_UNIT);
+/* check_heap_budgeted
+ * touched(NULL 가능)를 완전히 검사하고, cursor부터 블록 HEAPMGR_CHECK_SLICE개를
+ * 이어서 검사. HEAPMGR_CHECK_EVERY번마다 전체 검사로 대체 */
+static int check_heap_budgeted(Chunk_T touched) {
+    Chunk_T w;
+    int i;
+
+    if (++s_check_ops % HEAPMGR_CHECK_EVERY == 0) return check_heap_validity();
+    if (s_heap_lo == NULL || s_heap_lo == s_heap_hi) return check_heap_validity();
+    if (touched && !check_chunk_local(touched)) return FALSE;
+
+    w = s_check_cursor;
+    if (w == NULL || w >= (Chunk_T)s_heap_hi) w = (Chunk_T)s_heap_lo;
+    for (i = 0; i < HEAPMGR_CHECK_SLICE; i++) {
+        if (!check_chunk_local(w)) return FALSE;
+        w = chunk_get_next(w, s_heap_lo, s_heap_hi);
+        if (w == NULL) w = (Chunk_T)s_heap_lo;
+    }
+    s_check_cursor = w;
+    return TRUE;
 }
+#endif
 
+#endif
 
-
+/* heapmgr_check_heap: 전체 검사를 즉시 수행 (NDEBUG 빌드에서는 항상 TRUE) */
+int heapmgr_check_heap(void) {
+#ifndef NDEBUG
+    int ok;
+    if (s_heap_lo == NULL) return TRUE; /* 아직 한 번도 안 쓴 heap */
+    HEAP_LOCK();
+    ok = check_heap_validity();
+    HEAP_UNLOCK();
+    return ok;
+#else
+    return TRUE;
+#endif
+}
 
 static void heap_bootstrap(void) {
     s_heap_lo = s_heap_hi = sbrk(0);
@@ -99,34 +515,52 @@ static Chunk_T coalesce_two(Chunk_T h_a, Chunk_T h_b) {
     assert (chunk_is_allocated(h_a) == FALSE);
     assert (chunk_is_allocated(h_b) == FALSE);
     assert(chunk_get_next(h_a, s_heap_lo, s_heap_hi) == h_b);
-    int span_a = chunk_get_span_units(h_a);
-    int span_b = chunk_get_span_units(h_b);
+    PROF_PUSH(PH_COALESCE);
+    size_t span_a = chunk_get_span_units(h_a);
+    size_t span_b = chunk_get_span_units(h_b);
 
     Chunk_T prev = footer_chunk_get_prev_free(footer_from_header(h_a));
     Chunk_T next = header_chunk_get_next_free(h_b);
 
     header_chunk_set_span_units(h_a, span_a + span_b);
+    STAT_SUB(ui_free_blocks, 1);
+    STAT_ADD(ul_coalesces, 1);
+#ifndef NDEBUG
+    if (s_check_cursor == h_b) s_check_cursor = h_a; // h_b 헤더는 이제 payload
+#endif
+    if (s_rover == h_b) s_rover = h_a;
     // free-list 링크: prev <-> h_a <-> next
     header_chunk_set_next_free(h_a, next);
     if (next) {
         footer_chunk_set_prev_free(footer_from_header(next), h_a);
     }
     footer_chunk_set_prev_free(footer_from_header(h_a), prev);
+    PROF_POP();
     return h_a;
 }
 
 static Chunk_T split_for_alloc(Chunk_T h_c, size_t need_payload_units) {
     Chunk_T alloc; //할당할 거, 리턴할 변수
-    int old_span = chunk_get_span_units(h_c);
-    int alloc_span = (int) (1 + need_payload_units + 1) ; // 헤더 1개 + 필요 유닛 수 + 푸터 1개
-    int remain_span = old_span - alloc_span;
+    size_t old_span = chunk_get_span_units(h_c);
+    size_t alloc_span = 1 + need_payload_units + 1; // 헤더 1개 + 필요 유닛 수 + 푸터 1개
+    size_t remain_span;
+    Chunk_T prev_free;
 
+    PROF_PUSH(PH_SPLIT);
     assert (h_c >= (Chunk_T)s_heap_lo && h_c <= (Chunk_T)s_heap_hi);
     assert (chunk_is_allocated(h_c) == FALSE);
-    assert (remain_span >= 2); // 의문인건... 2보단 더 커야 하지 않나?
+    assert (old_span >= alloc_span + 3); // 남는 블록은 최소 헤더+1유닛+푸터
+    remain_span = old_span - alloc_span;
 
-    /*원래 블록 span을 줄여주자*/
+    /*원래 블록 span을 줄여주자. 푸터 위치가 바뀌므로 prev 링크를 옮겨 준다*/
+    prev_free = footer_chunk_get_prev_free(footer_from_header(h_c));
     header_chunk_set_span_units(h_c, remain_span);
+    footer_chunk_set_prev_free(footer_from_header(h_c), prev_free);
+#ifdef HEAPMGR_INDEX
+    if (!s_idx.off) s_idx.spans[idx_slot(h_c)] = idx_span(remain_span);
+#endif
+    STAT_SUB(ui_bytes_free, alloc_span * CHUNK_UNIT);
+    STAT_ADD(ul_splits, 1);
 
     alloc = chunk_get_next(h_c, s_heap_lo, s_heap_hi); //할당할 블록 헤더 위치, split한 직후 놈
     header_chunk_init(alloc); // header flag 세팅
@@ -140,6 +574,7 @@ static Chunk_T split_for_alloc(Chunk_T h_c, size_t need_payload_units) {
     Chunk_T f_alloc = footer_from_header(alloc);
     footer_chunk_set_prev_free(f_alloc, NULL);
     
+    PROF_POP();
     return alloc;
 }
 
@@ -154,8 +589,11 @@ static Chunk_T freelist_insert_between(Chunk_T prev_h_c, Chunk_T next_h_c, Chunk
     assert(chunk_get_span_units(h_c) >=2);
     assert(chunk_is_allocated(h_c));
 
+    PROF_PUSH(PH_INSERT);
     // free로 만들기
     header_chunk_set_status_free(h_c);
+    STAT_ADD(ui_free_blocks, 1);
+    STAT_ADD(ui_bytes_free, chunk_get_span_units(h_c) * CHUNK_UNIT);
 
     header_chunk_set_next_free(h_c, next_h_c);
     footer_chunk_set_prev_free(footer_from_header(h_c), prev_h_c);
@@ -168,17 +606,45 @@ static Chunk_T freelist_insert_between(Chunk_T prev_h_c, Chunk_T next_h_c, Chunk
 
     if (next_h_c) footer_chunk_set_prev_free(footer_from_header(next_h_c), h_c);
 
+#ifdef HEAPMGR_INDEX
+    /* 병합 결과에 따라 index는 한 번만 고침: slot은 next_h_c 자리, prev_h_c는 slot-1 */
+    size_t slot = s_idx.off ? 0 : idx_slot(h_c);
+    int merged_prev = FALSE, merged_next = FALSE;
+    assert(s_idx.off || slot == 0 || s_idx.addrs[slot - 1] == prev_h_c);
+    assert(s_idx.off || slot == s_idx.n || s_idx.addrs[slot] == next_h_c);
+#endif
+
     // lower 병합 if needed
     Chunk_T prev = chunk_get_prev(h_c, s_heap_lo, s_heap_hi);
     if (prev && prev == prev_h_c) {
         h_c = coalesce_two(prev_h_c, h_c);
+#ifdef HEAPMGR_INDEX
+        merged_prev = TRUE;
+#endif
     }
 
     Chunk_T next = chunk_get_next(h_c, s_heap_lo, s_heap_hi);
     if (next!=NULL && next == next_h_c) {
         h_c = coalesce_two(h_c, next_h_c);
+#ifdef HEAPMGR_INDEX
+        merged_next = TRUE;
+#endif
     }
 
+#ifdef HEAPMGR_INDEX
+    if (!s_idx.off) {
+        if (merged_prev) {
+            if (merged_next) idx_remove_at(slot);
+            idx_set(slot - 1, h_c, chunk_get_span_units(h_c));
+        } else if (merged_next) {
+            idx_set(slot, h_c, chunk_get_span_units(h_c));
+        } else {
+            idx_insert_at(slot, h_c, chunk_get_span_units(h_c));
+        }
+    }
+#endif
+
+    PROF_POP();
     return h_c;
 }
 
@@ -186,31 +652,42 @@ static Chunk_T
 sys_grow_and_link(Chunk_T prev, size_t need_units)
 {
     Chunk_T new_h_c;
-    size_t grow_data = (need_units < SYS_MIN_ALLOC_UNITS) ? SYS_MIN_ALLOC_UNITS : need_units;
+    size_t grow_data = (need_units < s_grow_units) ? s_grow_units : need_units;
     size_t grow_span = 2 + grow_data;  /* header + payload units + footer*/
 
-    new_h_c = (Chunk_T)sbrk(grow_span * CHUNK_UNIT);
-    if (new_h_c == (Chunk_T)-1)
+    if (need_units > MAX_PAYLOAD_UNITS)
+        return NULL;
+
+    PROF_PUSH(PH_GROW);
+    new_h_c = (Chunk_T)sbrk((intptr_t)(grow_span * CHUNK_UNIT));
+    if (new_h_c == (Chunk_T)-1) {
+        PROF_POP();
         return NULL;
+    }
 
     s_heap_hi = sbrk(0); // 현재 위치 가쟈와서 힙의 끝을 표현하는 변수에 세팅
+    STAT_ADD(ui_heap_bytes, grow_span * CHUNK_UNIT);
+    STAT_ADD(ul_growths, 1);
     header_chunk_init(new_h_c);
-    header_chunk_set_span_units(new_h_c, (int)grow_span);
+    header_chunk_set_span_units(new_h_c, grow_span);
     header_chunk_set_next_free(new_h_c, NULL);
     header_chunk_set_status_allocated(new_h_c);
 
     Chunk_T new_f_c = footer_from_header(new_h_c);
     footer_chunk_set_prev_free(new_f_c, prev);
 
-    freelist_insert_between(prev, NULL, new_h_c);
+    /* prev와 물리적으로 붙어 있으면 병합되어 prev가 반환됨 */
+    new_h_c = freelist_insert_between(prev, NULL, new_h_c);
 
-    assert(check_heap_validity());
+    assert(CHECK_HEAP(new_h_c));
 
+    PROF_POP();
     return new_h_c;
 }
 
 static void freelist_detach(Chunk_T prev_h_c, Chunk_T h_c) {
     assert(!chunk_is_allocated(h_c));
+    PROF_PUSH(PH_DETACH);
     // h_c가 헤드인 경우는 h_c를 링크드 리스트 맨 앞에 있는 놈을 갈아끼는 케이스라고 상상하자.
 
     Chunk_T next = header_chunk_get_next_free(h_c);
@@ -225,95 +702,651 @@ static void freelist_detach(Chunk_T prev_h_c, Chunk_T h_c) {
         footer_chunk_set_prev_free(footer_from_header(next), prev_h_c);
     }
 
+    if (s_rover == h_c) s_rover = next;
+#ifdef HEAPMGR_INDEX
+    if (!s_idx.off) idx_remove_at(idx_slot(h_c));
+#endif
     header_chunk_set_next_free(h_c, NULL);
     header_chunk_set_status_allocated(h_c);
+    STAT_SUB(ui_free_blocks, 1);
+    STAT_SUB(ui_bytes_free, chunk_get_span_units(h_c) * CHUNK_UNIT);
+    PROF_POP();
+}
+
+/* 자가 튜닝
+ * 매 malloc의 요청 크기(unit)를 histogram에 넣고, TUNE_WINDOW번마다
+ *  1. s_split_min = 요청 크기 하위 TUNE_SPLIT_PERCENTILE%의 span. 그보다 작은 조각은
+ *     거의 재사용되지 않고 free-list만 길게 만드므로 쪼개지 않고 통째로 준다.
+ *  2. window 동안 growth가 TUNE_GROWS_HIGH번 이상이면 s_grow_units를 두 배로,
+ *     TUNE_IDLE_WINDOWS window 연속 growth가 없으면 절반으로 (SYS_MIN_ALLOC_UNITS 이상).
+ *     단 free가 거의 없는 window(채우기 구간)에서는 두 배로 하지 않는다. worst의
+ *     채우기 구간에서 growth를 키우면 이후 first-fit이 오히려 두 배 가까이 느려졌다.
+ * 값은 [3, TUNE_SPLIT_MAX], [SYS_MIN_ALLOC_UNITS, TUNE_GROW_MAX] 안에서만 움직인다.
+ * heapmgr1은 size class(bin)가 없으므로 bin 경계는 튜닝 대상이 아님.
+ *
+ * HEAPMGR_OPTS="tune=0,grow=N,split=N,window=N" (쉼표 구분, 모두 선택)
+ *  tune=0: 튜닝 끔 (grow/split은 기본값 또는 지정값 고정)
+ *  grow=N: growth 최소 unit 수를 N으로 고정, split=N: s_split_min을 N으로 고정
+ *  window=N: 튜닝 주기(malloc 횟수) */
+enum {
+    TUNE_BUCKETS = 64,              // 1..63 unit은 정확히, 그 이상은 마지막 bucket
+    TUNE_WINDOW = 4096,
+    TUNE_SPLIT_PERCENTILE = 10,
+    TUNE_SPLIT_MAX = 64,
+    TUNE_GROWS_HIGH = 16,
+    TUNE_FILL_RATIO = 4,            // free가 malloc의 1/4 미만인 window는 채우기 구간
+    TUNE_IDLE_WINDOWS = 8,
+    TUNE_GROW_MAX = 8192            // 128 KiB
+};
+
+static int s_tune_split = TRUE, s_tune_grow = TRUE;
+static unsigned long s_tune_window = TUNE_WINDOW;
+static unsigned long s_tune_hist[TUNE_BUCKETS];
+static unsigned long s_tune_count = 0;
+static unsigned long s_tune_growths = 0;   // window 시작 시점의 ul_growths
+static unsigned long s_tune_frees = 0;     // window 시작 시점의 ul_frees
+static unsigned s_tune_idle = 0;
+
+static void tune_window(void) {
+    unsigned long target = s_tune_count * TUNE_SPLIT_PERCENTILE / 100, sum = 0;
+    unsigned long growths = s_pstats->ul_growths - s_tune_growths;
+    unsigned long frees = s_pstats->ul_frees - s_tune_frees;
+    size_t u;
+
+    if (s_tune_split) {
+        for (u = 1; u < TUNE_BUCKETS - 1; u++) {
+            sum += s_tune_hist[u];
+            if (sum > target) break;
+        }
+        u += 2; // header + footer
+        s_split_min = (u < 3) ? 3 : (u > TUNE_SPLIT_MAX) ? TUNE_SPLIT_MAX : u;
+    }
+    if (s_tune_grow) {
+        if (growths >= TUNE_GROWS_HIGH && frees * TUNE_FILL_RATIO >= s_tune_count) {
+            if (s_grow_units < TUNE_GROW_MAX) s_grow_units *= 2;
+            s_tune_idle = 0;
+        } else if (growths == 0 && ++s_tune_idle >= TUNE_IDLE_WINDOWS) {
+            if (s_grow_units > SYS_MIN_ALLOC_UNITS) s_grow_units /= 2;
+            s_tune_idle = 0;
+        }
+    }
+    memset(s_tune_hist, 0, sizeof(s_tune_hist));
+    s_tune_count = 0;
+    s_tune_growths = s_pstats->ul_growths;
+    s_tune_frees = s_pstats->ul_frees;
 }
 
+/* tune_sample: malloc마다 요청 크기 기록 */
+static inline void tune_sample(size_t need_units) {
+    if (!s_tune_split && !s_tune_grow) return;
+    s_tune_hist[need_units < TUNE_BUCKETS ? need_units : TUNE_BUCKETS - 1]++;
+    if (++s_tune_count == s_tune_window) tune_window();
+}
+
+/* opts_from_env: HEAPMGR_OPTS 해석. 모르는 항목은 경고 후 무시 */
+static void opts_from_env(void) {
+    const char *v = getenv("HEAPMGR_OPTS");
+    char *end;
+    unsigned long n;
+
+    while (v != NULL && *v != '\0') {
+        size_t len = strcspn(v, ",");
+        const char *eq = memchr(v, '=', len);
+
+        /* '='가 없거나 값 뒤에 다른 글자가 붙은 항목은 경고만 하고 다음 ','로 */
+        if (eq == NULL || (n = strtoul(eq + 1, &end, 10), end == eq + 1 || end != v + len)) {
+            fprintf(stderr, "HEAPMGR_OPTS: ignoring %.*s\n", (int)len, v);
+        } else if (strncmp(v, "tune=", 5) == 0) {
+            s_tune_split = s_tune_grow = (n != 0);
+        } else if (strncmp(v, "grow=", 5) == 0 && n >= 1 && n <= MAX_PAYLOAD_UNITS) {
+            s_grow_units = n;
+            s_tune_grow = FALSE;
+        } else if (strncmp(v, "split=", 6) == 0 && n >= 3 && n <= TUNE_SPLIT_MAX) {
+            s_split_min = n;
+            s_tune_split = FALSE;
+        } else if (strncmp(v, "window=", 7) == 0 && n >= 1) {
+            s_tune_window = n;
+        } else {
+            fprintf(stderr, "HEAPMGR_OPTS: ignoring %.*s\n", (int)len, v);
+        }
+        v = (v[len] == ',') ? v + len + 1 : NULL;
+    }
+}
+
+void heapmgr_get_params(struct heapmgr_params *ps_params) {
+    ps_params->ui_grow_units = s_grow_units;
+    ps_params->ui_split_min = s_split_min;
+    ps_params->i_tuning = s_tune_split || s_tune_grow;
+}
+
+/* 배치 정책
+ * find 함수는 payload가 need unit 이상인 free 블록을 골라 돌려주고, 없으면 NULL과 함께
+ * *p_tail에 free-list의 마지막 블록(heap을 키울 때 sys_grow_and_link에 넘길 prev)을
+ * 넣는다. *p_visited에는 고른 블록 외에 살펴본 노드 수. 분할/detach는 호출자가 한다. */
+typedef Chunk_T (*find_fn)(size_t need, Chunk_T *p_tail, unsigned long *p_visited);
+
+enum { GOOD_FIT_DEFAULT_K = 8 };
+
+/* 남는 부분이 s_split_min 미만이면 split하지 않으므로, 그보다 더 잘 맞는 블록은 없다고 본다 */
+#define FITS_TIGHTLY(payload, need) ((payload) - (need) < s_split_min)
+
+/* 주소 순 첫 번째로 맞는 블록: list를 따라감 */
+static Chunk_T find_first_fit_list(size_t need, Chunk_T *p_tail, unsigned long *p_visited) {
+    Chunk_T cur, prev = NULL;
+    unsigned long n = 0;
+
+    for (cur = s_free_head; cur != NULL; prev = cur, cur = header_chunk_get_next_free(cur)) {
+        if (chunk_get_span_units(cur) - 2 >= need) {
+            *p_visited = n;
+            return cur;
+        }
+        n++;
+    }
+    *p_tail = prev;
+    *p_visited = n;
+    return NULL;
+}
+
+#ifdef HEAPMGR_INDEX
+/* 주소 순 첫 번째로 맞는 블록: index의 spans를 훑음.
+ * 포화된 span(UINT32_MAX)은 실제 헤더로 다시 확인 */
+static Chunk_T find_first_fit_index(size_t need, Chunk_T *p_tail, unsigned long *p_visited) {
+    size_t need_span = need + 2;
+    uint32_t need32 = idx_span(need_span);
+    size_t i = 0;
+
+    for (;;) {
+        i = s_idx_scan(s_idx.spans, i, s_idx.n, need32);
+        if (i == s_idx.n) {
+            *p_tail = s_idx.n ? s_idx.addrs[s_idx.n - 1] : NULL;
+            *p_visited = s_idx.n;
+            return NULL;
+        }
+        if (s_idx.spans[i] < UINT32_MAX || chunk_get_span_units(s_idx.addrs[i]) >= need_span)
+            break;
+        i++;
+    }
+    idx_prefetch(i);
+    s_idx.hit = i;
+    *p_visited = i;
+    return s_idx.addrs[i];
+}
+#endif
+
+static Chunk_T find_first_fit(size_t need, Chunk_T *p_tail, unsigned long *p_visited) {
+#ifdef HEAPMGR_INDEX
+    if (!s_idx.off) return find_first_fit_index(need, p_tail, p_visited);
+#endif
+    return find_first_fit_list(need, p_tail, p_visited);
+}
+
+/* s_rover부터 끝까지, 다시 head부터 s_rover 전까지 first-fit (K&R의 roving freep) */
+static Chunk_T find_next_fit(size_t need, Chunk_T *p_tail, unsigned long *p_visited) {
+    Chunk_T start = (s_rover != NULL) ? s_rover : s_free_head;
+    Chunk_T cur, prev = NULL;
+    unsigned long n = 0;
+
+    for (cur = start; cur != NULL; prev = cur, cur = header_chunk_get_next_free(cur)) {
+        if (chunk_get_span_units(cur) - 2 >= need) goto found;
+        n++;
+    }
+    *p_tail = prev; // start가 list 안에 있으므로 끝까지 간 prev가 tail
+    for (cur = s_free_head; cur != start; cur = header_chunk_get_next_free(cur)) {
+        if (chunk_get_span_units(cur) - 2 >= need) goto found;
+        n++;
+    }
+    *p_visited = n;
+    return NULL;
+
+found:
+    s_rover = cur; // detach되면 freelist_detach가 다음 블록으로 옮김
+    *p_visited = n;
+    return cur;
+}
+
+/* 맞는 블록 중 가장 작은 것. 후보를 limit개 보면 멈춤 (best-fit은 limit 없음) */
+static Chunk_T find_smallest_fit(size_t need, Chunk_T *p_tail, unsigned long *p_visited,
+                                 unsigned long limit) {
+    Chunk_T cur, prev = NULL, best = NULL;
+    size_t best_payload = SIZE_MAX;
+    unsigned long n = 0, candidates = 0;
+
+    for (cur = s_free_head; cur != NULL; prev = cur, cur = header_chunk_get_next_free(cur)) {
+        size_t payload = chunk_get_span_units(cur) - 2;
+        n++;
+        if (payload < need) continue;
+        if (payload < best_payload) {
+            best = cur;
+            best_payload = payload;
+            if (FITS_TIGHTLY(payload, need)) break;
+        }
+        if (++candidates == limit) break;
+    }
+    if (best == NULL) {
+        *p_tail = prev;
+        *p_visited = n;
+        return NULL;
+    }
+    *p_visited = n - 1;
+    return best;
+}
+
+static unsigned long s_good_k = GOOD_FIT_DEFAULT_K;
+
+static Chunk_T find_best_fit(size_t need, Chunk_T *p_tail, unsigned long *p_visited) {
+    return find_smallest_fit(need, p_tail, p_visited, 0);
+}
+
+static Chunk_T find_good_fit(size_t need, Chunk_T *p_tail, unsigned long *p_visited) {
+    return find_smallest_fit(need, p_tail, p_visited, s_good_k);
+}
+
+/* 현재 정책. NULL이면 첫 malloc에서 HEAPMGR_POLICY를 읽어 정함 */
+static find_fn s_find = NULL;
+
+int heapmgr_set_policy(enum heapmgr_policy e_policy, unsigned ui_k) {
+    switch (e_policy) {
+    case HEAPMGR_FIRST_FIT: s_find = find_first_fit; break;
+    case HEAPMGR_NEXT_FIT:  s_find = find_next_fit;  break;
+    case HEAPMGR_BEST_FIT:  s_find = find_best_fit;  break;
+    case HEAPMGR_GOOD_FIT:
+        s_find = find_good_fit;
+        s_good_k = (ui_k != 0) ? ui_k : GOOD_FIT_DEFAULT_K;
+        break;
+    default:
+        return -1;
+    }
+    s_rover = NULL;
+    return 0;
+}
+
+/* stats page (heapmgr1.h 참고)
+ * HEAPMGR_STATS_PAGE가 켜져 있으면 첫 malloc에서 shm 객체 한 페이지를 만들어 지금까지의
+ * 통계를 옮기고 s_pstats를 그리로 돌린다. hot path는 그대로 relaxed store만 하므로
+ * 추가 비용은 s_pstats load 하나. magic은 마지막에 써서 읽는 쪽이 덜 채워진 페이지를
+ * 보지 않게 한다. 객체는 exit에서 지운다. fork된 자식은 부모 페이지에 섞어 쓰지 않도록
+ * 자기 사본으로 돌아가고 publish하지 않는다 (_exit하는 자식이 객체를 남기지 않게).
+ * shm_open/snprintf/atexit는 malloc을 부르지 않으므로 sbrk heap을 건드리지 않음 */
+static struct heapmgr_stats_page *s_page = NULL;
+static char s_page_name[32];
+
+static void stats_page_unlink(void) {
+    if (s_page != NULL && s_page->i_pid == (int)getpid()) shm_unlink(s_page_name);
+}
+
+static void stats_page_atfork_child(void) {
+    s_stats = *s_pstats;
+    s_pstats = &s_stats;
+    if (s_page != NULL) munmap(s_page, sizeof(*s_page));
+    s_page = NULL;
+}
+
+static void stats_page_boot(void) {
+    const char *v = getenv("HEAPMGR_STATS_PAGE");
+    struct heapmgr_stats_page *p;
+    int fd;
+
+    if (v == NULL || *v == '\0' || strcmp(v, "0") == 0) return;
+    snprintf(s_page_name, sizeof(s_page_name), HEAPMGR_STATS_PAGE_FMT, (int)getpid());
+    fd = shm_open(s_page_name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "HEAPMGR_STATS_PAGE: %s: %s\n", s_page_name, strerror(errno));
+        return;
+    }
+    if (ftruncate(fd, sizeof(*p)) != 0
+        || (p = mmap(NULL, sizeof(*p), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+        fprintf(stderr, "HEAPMGR_STATS_PAGE: %s: %s\n", s_page_name, strerror(errno));
+        close(fd);
+        shm_unlink(s_page_name);
+        return;
+    }
+    close(fd);
+
+    p->ui_version = HEAPMGR_STATS_PAGE_VERSION;
+    p->i_pid = (int)getpid();
+    p->s_stats = s_stats;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(p->ac_magic, HEAPMGR_STATS_PAGE_MAGIC, sizeof(p->ac_magic));
+    s_pstats = &p->s_stats;
+    s_page = p;
+    atexit(stats_page_unlink);
+    pthread_atfork(NULL, NULL, stats_page_atfork_child);
+}
+
+/* policy_from_env: HEAPMGR_POLICY 해석. 모르는 값이면 경고 후 first-fit.
+ * getenv/strtoul은 malloc을 부르지 않으므로 sbrk heap을 건드리지 않음 */
+static void policy_from_env(void) {
+    const char *v = getenv("HEAPMGR_POLICY");
+
+    if (v == NULL || strcmp(v, "first") == 0) heapmgr_set_policy(HEAPMGR_FIRST_FIT, 0);
+    else if (strcmp(v, "next") == 0) heapmgr_set_policy(HEAPMGR_NEXT_FIT, 0);
+    else if (strcmp(v, "best") == 0) heapmgr_set_policy(HEAPMGR_BEST_FIT, 0);
+    else if (strncmp(v, "good", 4) == 0 && (v[4] == '\0' || v[4] == ':'))
+        heapmgr_set_policy(HEAPMGR_GOOD_FIT,
+                           v[4] == ':' ? (unsigned)strtoul(v + 5, NULL, 10) : 0);
+    else {
+        fprintf(stderr, "HEAPMGR_POLICY: unknown policy %s, using first\n", v);
+        heapmgr_set_policy(HEAPMGR_FIRST_FIT, 0);
+    }
+}
+
+/* found_after: malloc 성공 시 카운터 갱신. free-list 길이 분포는 stats page에만
+ * 있으므로 페이지가 켜졌을 때만 센다 */
+static void found_after(unsigned long n_visited) {
+    STAT_ADD(ul_mallocs, 1);
+    STAT_ADD(aul_search_hist[heapmgr_search_bucket(n_visited)], 1);
+    if (s_page != NULL) {
+        unsigned long *pl = &s_page->aul_length_hist[heapmgr_search_bucket(
+            __atomic_load_n(&s_pstats->ui_free_blocks, __ATOMIC_RELAXED))];
+        __atomic_store_n(pl, __atomic_load_n(pl, __ATOMIC_RELAXED) + 1, __ATOMIC_RELAXED);
+    }
+}
+
+static Chunk_T free_now(void *pv_bytes, Chunk_T from);
+
+/* 지연 free (-D HEAPMGR_DEFER)
+ * heapmgr_free는 블록을 lock-free stack(s_defer_head)에 넣기만 하고, 백그라운드
+ * 스레드가 DEFER_BATCH개가 쌓이거나 DEFER_WAIT_US가 지날 때마다 통째로 꺼내
+ * s_heap_lock을 잡고 원래의 free(free_now: 삽입 위치 탐색, 병합)를 한다. 병합으로
+ * PURGE_MIN_BYTES 이상이 된 free 블록에 들어간 페이지는 madvise로 돌려준다.
+ * stack 링크는 payload의 첫 word에 두고, 블록은 꺼낼 때까지 allocated 상태이므로
+ * 검사 코드와 통계에서는 아직 사용 중인 블록이다.
+ *  - malloc은 맞는 블록이 없으면 heap을 키우기 전에 queue를 직접 비움
+ *  - queue가 DEFER_MAX개를 넘으면 free하는 스레드가 직접 비움 (back-pressure)
+ * 스레드는 첫 malloc에서 heap보다 먼저 만든다 (pthread_create가 glibc malloc으로
+ * program break를 옮길 수 있으므로). */
+#ifdef HEAPMGR_DEFER
+enum {
+    DEFER_BATCH = 256,
+    DEFER_MAX = 8192,
+    DEFER_WAIT_US = 1000,
+    PURGE_MIN_BYTES = 64 * 4096
+};
+
+static pthread_mutex_t s_defer_mu = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_defer_cv = PTHREAD_COND_INITIALIZER;
+static void *s_defer_head = NULL;
+static size_t s_defer_count = 0;
+
+/* defer_purge: [lo, hi)의 페이지를 커널에 돌려줌 (내용은 0이 됨) */
+static void defer_purge(uintptr_t lo, uintptr_t hi) {
+    if (hi > lo) madvise((void *)lo, hi - lo, MADV_DONTNEED);
+}
+
+/* defer_sort: 링크로 이어진 블록들을 주소순으로 (merge sort) */
+static void *defer_sort(void *head) {
+    void *a = NULL, *b = NULL, *out = NULL, **tail = &out;
+
+    if (head == NULL || *(void **)head == NULL) return head;
+    while (head != NULL) { /* 번갈아 a, b로 나눔 */
+        void *next = *(void **)head;
+        *(void **)head = a;
+        a = head;
+        head = next;
+        if (head == NULL) break;
+        next = *(void **)head;
+        *(void **)head = b;
+        b = head;
+        head = next;
+    }
+    a = defer_sort(a);
+    b = defer_sort(b);
+    while (a != NULL && b != NULL) {
+        void **pp = (a < b) ? &a : &b;
+        *tail = *pp;
+        tail = (void **)*pp;
+        *pp = *(void **)*pp;
+    }
+    *tail = (a != NULL) ? a : b;
+    return out;
+}
+
+/* defer_drain_locked: queue를 통째로 꺼내 free. s_heap_lock을 쥔 채로 부름
+ * 주소순으로 넣으면 삽입 위치 탐색이 직전 블록에서 이어지므로, batch 전체가
+ * free list를 한 번만 돈다 */
+static void defer_drain_locked(void) {
+    void *pv = __atomic_exchange_n(&s_defer_head, NULL, __ATOMIC_ACQUIRE);
+    Chunk_T from = NULL;
+    uintptr_t purge_lo = 0, purge_hi = 0; /* 모아 둔 purge 구간 */
+    size_t n = 0;
+
+    pv = defer_sort(pv);
+    while (pv != NULL) {
+        void *next = *(void **)pv;
+        uintptr_t lo = (uintptr_t)header_from_payload(pv) & ~(uintptr_t)4095;
+        uintptr_t hi = ((uintptr_t)footer_from_header(header_from_payload(pv))
+                        + CHUNK_UNIT + 4095) & ~(uintptr_t)4095;
+        Chunk_T h_c = free_now(pv, from);
+        from = h_c;
+        /* 병합된 블록이 크면, 방금 free한 블록이 덮는 페이지 중 병합된 블록의
+         * 헤더/푸터 페이지를 뺀 부분을 purge. 뒤따르는 병합은 블록을 넓히기만
+         * 하므로 모아 둔 구간은 batch 끝까지 안쪽으로 남는다 */
+        if (chunk_get_span_units(h_c) * CHUNK_UNIT >= PURGE_MIN_BYTES) {
+            uintptr_t in_lo = ((uintptr_t)h_c + CHUNK_UNIT + 4095) & ~(uintptr_t)4095;
+            uintptr_t in_hi = (uintptr_t)footer_from_header(h_c) & ~(uintptr_t)4095;
+            if (lo < in_lo) lo = in_lo;
+            if (hi > in_hi) hi = in_hi;
+            if (lo < hi) {
+                if (lo > purge_hi) {
+                    defer_purge(purge_lo, purge_hi);
+                    purge_lo = lo;
+                }
+                if (hi > purge_hi) purge_hi = hi;
+            }
+        }
+        pv = next;
+        n++;
+    }
+    defer_purge(purge_lo, purge_hi);
+    __atomic_sub_fetch(&s_defer_count, n, __ATOMIC_RELAXED);
+}
+
+static void *defer_main(void *unused) {
+    (void)unused;
+    for (;;) {
+        struct timespec ts;
+        pthread_mutex_lock(&s_defer_mu);
+        if (__atomic_load_n(&s_defer_count, __ATOMIC_RELAXED) < DEFER_BATCH) {
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_nsec += DEFER_WAIT_US * 1000L;
+            if (ts.tv_nsec >= 1000000000L) {
+                ts.tv_sec++;
+                ts.tv_nsec -= 1000000000L;
+            }
+            pthread_cond_timedwait(&s_defer_cv, &s_defer_mu, &ts);
+        }
+        pthread_mutex_unlock(&s_defer_mu);
+        if (__atomic_load_n(&s_defer_head, __ATOMIC_RELAXED) != NULL) {
+            HEAP_LOCK();
+            defer_drain_locked();
+            HEAP_UNLOCK();
+        }
+    }
+    return NULL;
+}
+
+/* defer_start: 스레드를 못 만들면 지연 없이 동작 (s_defer_on == FALSE) */
+static int s_defer_on = FALSE;
+
+static void defer_start(void) {
+    pthread_t tid;
+    if (pthread_create(&tid, NULL, defer_main, NULL) == 0) {
+        pthread_detach(tid);
+        s_defer_on = TRUE;
+    }
+}
+
+static void defer_push(void *pv_bytes) {
+    void *head = __atomic_load_n(&s_defer_head, __ATOMIC_RELAXED);
+    size_t n;
+
+    do {
+        *(void **)pv_bytes = head;
+    } while (!__atomic_compare_exchange_n(&s_defer_head, &head, pv_bytes, TRUE,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    n = __atomic_add_fetch(&s_defer_count, 1, __ATOMIC_RELAXED);
+    if (n >= DEFER_MAX) {
+        HEAP_LOCK();
+        defer_drain_locked();
+        HEAP_UNLOCK();
+    } else if (n == DEFER_BATCH) {
+        pthread_cond_signal(&s_defer_cv);
+    }
+}
+#endif
+
 
 void *heapmgr_malloc(size_t ui_bytes)
 {
     static int booted = FALSE;
-    Chunk_T cur, prev, prevprev;
+    Chunk_T cur, tail = NULL;
     size_t need_payload_units;
+    unsigned long n_visited = 0;
 
     if (ui_bytes == 0) return NULL;
-    if (!booted) { heap_bootstrap(); booted = TRUE; }
+    if (ui_bytes > MAX_PAYLOAD_UNITS * CHUNK_UNIT) return NULL;
+    if (!booted) {
+        stats_page_boot();
+#ifdef HEAPMGR_DEFER
+        defer_start();
+#endif
+        heap_bootstrap();
+#ifdef HEAPMGR_INDEX
+        idx_boot();
+#endif
+        if (s_find == NULL) policy_from_env();
+        opts_from_env();
+        booted = TRUE;
+    }
 
-    assert(check_heap_validity());
+    HEAP_LOCK();
+    PROF_PUSH(PH_MALLOC_SEARCH);
+    assert(CHECK_HEAP(NULL));
 
     need_payload_units = bytes_to_payload_units(ui_bytes); // payload 유닛(헤더/푸터 제외)
-    prevprev = NULL;
-    prev = NULL;
-
-    /* 1) first-fit 검색 */
-    for (cur = s_free_head; cur != NULL; cur = header_chunk_get_next_free(cur)) {
-        int old_span   = chunk_get_span_units(cur);     // 헤더~푸터 포함 유닛 수
-        int alloc_span = (int)(need_payload_units + 2); // 헤더+payload+푸터
-        int remain     = old_span - alloc_span;
-        size_t cur_payload = (size_t)old_span - 2;      // 현재 블록 payload 유닛
-
-        if (cur_payload >= need_payload_units) {
-            if (cur_payload > need_payload_units && remain >= 3) {
-                /* 남는 블록이 최소 헤더+1유닛+푸터(=3)일 때만 split */
-                cur = split_for_alloc(cur, need_payload_units);
-            } else {
-                /* remain <= 2 이면 split 금지 */
-                freelist_detach(prev, cur);
-            }
-            assert(check_heap_validity());
-            return (void *)((char *)cur + CHUNK_UNIT); // payload 포인터
-        }
-
-        prevprev = prev;
-        prev = cur;
+    tune_sample(need_payload_units);
+
+    /* 1) 정책에 따라 free 블록 선택 */
+    cur = s_find(need_payload_units, &tail, &n_visited);
+#ifdef HEAPMGR_DEFER
+    /* 밀린 free가 있으면 heap을 키우기 전에 먼저 처리하고 다시 찾음 */
+    if (cur == NULL && __atomic_load_n(&s_defer_head, __ATOMIC_RELAXED) != NULL) {
+        defer_drain_locked();
+        tail = NULL;
+        cur = s_find(need_payload_units, &tail, &n_visited);
     }
+#endif
 
-    /* 2) 못 찾았으면 힙을 키우고 동일 로직 적용 */
-    cur = sys_grow_and_link(prev, need_payload_units);
+    /* 2) 못 찾았으면 힙을 키움. 새 블록은 tail과 합쳐질 수 있음 */
     if (cur == NULL) {
-        assert(check_heap_validity());
-        return NULL;
+        cur = sys_grow_and_link(tail, need_payload_units);
+        if (cur == NULL) {
+            assert(CHECK_HEAP(NULL));
+            PROF_POP();
+            HEAP_UNLOCK();
+            return NULL;
+        }
     }
 
-    /* 신규 블록이 prev와 합쳐져 cur==prev가 된 경우 */
-    if (cur == prev) prev = prevprev;
-
     {
-        int old_span   = chunk_get_span_units(cur);
-        int alloc_span = (int)(need_payload_units + 2);
-        int remain     = old_span - alloc_span;
+        /* remain = old_span - (need + 2) = cur_payload - need */
+        size_t cur_payload = chunk_get_span_units(cur) - 2;
 
-        if ((size_t)old_span - 2 > need_payload_units && remain >= 3) {
+        if (cur_payload - need_payload_units >= s_split_min) {
+            /* 남는 블록이 s_split_min(최소 헤더+1유닛+푸터=3) 이상일 때만 split */
             cur = split_for_alloc(cur, need_payload_units);
         } else {
-            freelist_detach(prev, cur);
+            /* remain <= 2 이면 split 금지. list 앞 블록은 footer의 prev 링크 */
+            freelist_detach(footer_chunk_get_prev_free(footer_from_header(cur)), cur);
         }
     }
+    found_after(n_visited);
 
-    assert(check_heap_validity());
-    return (void *)((char *)cur + CHUNK_UNIT);
+    assert(CHECK_HEAP(cur));
+    PROF_POP();
+    HEAP_UNLOCK();
+    return (void *)((char *)cur + CHUNK_UNIT); // payload 포인터
 }
 
 
-void heapmgr_free(void *pv_bytes)
+/* free_now: 블록을 free list에 넣고 병합. 병합된 블록 반환
+ * from: 블록보다 앞에 있는 free 블록이 알려져 있으면 거기서부터 찾음 (없으면 NULL) */
+static Chunk_T free_now(void *pv_bytes, Chunk_T from)
 {
-    if (pv_bytes == NULL) return;
-    assert(check_heap_validity());
-
     Chunk_T h_c = header_from_payload(pv_bytes);
+    PROF_PUSH(PH_FREE_SEARCH);
+    assert(CHECK_HEAP(h_c));
     assert(chunk_is_allocated(h_c));
 
-    // 순회하면서 insertion point 찾기. starts from head
+    // 순회하면서 insertion point 찾기. starts from head (또는 from)
     // 순방향 단일 패스: prev < h_c <= curr
-    Chunk_T prev = NULL;
-    Chunk_T curr = s_free_head;
+    Chunk_T prev = from;
+    Chunk_T curr = from ? header_chunk_get_next_free(from) : s_free_head;
+#ifdef HEAPMGR_INDEX
+    if (!s_idx.off) {
+        /* index가 있으면 이분 탐색. 이웃 둘의 헤더/푸터를 함께 prefetch */
+        size_t slot = idx_slot(h_c);
+        if (slot > 0) { prev = s_idx.addrs[slot - 1]; idx_prefetch(slot - 1); }
+        curr = (slot < s_idx.n) ? s_idx.addrs[slot] : NULL;
+        if (curr) idx_prefetch(slot);
+        s_idx.hit = slot;
+    } else
+#endif
     while (curr && curr < h_c) {
         prev = curr;
         curr = header_chunk_get_next_free(curr);
     }
 
-    freelist_insert_between(prev, curr, h_c);
+    h_c = freelist_insert_between(prev, curr, h_c);
+    STAT_ADD(ul_frees, 1);
+
+    assert(CHECK_HEAP(h_c));
+    PROF_POP();
+    return h_c;
+}
+
+void heapmgr_free(void *pv_bytes)
+{
+    if (pv_bytes == NULL) return;
 
-    assert(check_heap_validity());
+#ifdef HEAPMGR_DEFER
+    if (s_defer_on) {
+        defer_push(pv_bytes);
+        return;
+    }
+#endif
+    HEAP_LOCK();
+    free_now(pv_bytes, NULL);
+    HEAP_UNLOCK();
+}
 
-}
\ No newline at end of file
+void heapmgr_stats(struct heapmgr_stats *ps_stats)
+{
+    Chunk_T w;
+    size_t largest = 0;
+    int i;
+
+    assert(ps_stats != NULL);
+
+    ps_stats->ui_heap_bytes  = __atomic_load_n(&s_pstats->ui_heap_bytes, __ATOMIC_RELAXED);
+    ps_stats->ui_bytes_free  = __atomic_load_n(&s_pstats->ui_bytes_free, __ATOMIC_RELAXED);
+    ps_stats->ui_free_blocks = __atomic_load_n(&s_pstats->ui_free_blocks, __ATOMIC_RELAXED);
+    ps_stats->ul_mallocs     = __atomic_load_n(&s_pstats->ul_mallocs, __ATOMIC_RELAXED);
+    ps_stats->ul_frees       = __atomic_load_n(&s_pstats->ul_frees, __ATOMIC_RELAXED);
+    ps_stats->ul_growths     = __atomic_load_n(&s_pstats->ul_growths, __ATOMIC_RELAXED);
+    ps_stats->ul_splits      = __atomic_load_n(&s_pstats->ul_splits, __ATOMIC_RELAXED);
+    ps_stats->ul_coalesces   = __atomic_load_n(&s_pstats->ul_coalesces, __ATOMIC_RELAXED);
+    for (i = 0; i < HEAPMGR_SEARCH_BUCKETS; i++)
+        ps_stats->aul_search_hist[i] =
+            __atomic_load_n(&s_pstats->aul_search_hist[i], __ATOMIC_RELAXED);
+    ps_stats->ui_bytes_in_use = ps_stats->ui_heap_bytes - ps_stats->ui_bytes_free;
+
+    /* 가장 큰 free 블록은 hot path에서 유지하기 비싸므로 여기서 list를 한 번 돈다 */
+    HEAP_LOCK();
+    for (w = s_free_head; w != NULL; w = header_chunk_get_next_free(w)) {
+        size_t bytes = chunk_get_span_units(w) * CHUNK_UNIT;
+        if (bytes > largest) largest = bytes;
+    }
+    HEAP_UNLOCK();
+    ps_stats->ui_largest_free = largest;
+}
@@ -0,0 +1,75 @@
+/*--------------------------------------------------------------------*/
+/* heapmgr1.h                                                         */
+/* heapmgr.h 인터페이스 외에 heapmgr1.c가 추가로 제공하는 함수들          */
+/*--------------------------------------------------------------------*/
+
+#ifndef HEAPMGR1_INCLUDED
+#define HEAPMGR1_INCLUDED
+
+#include <stddef.h>
+#include "heapmgr.h"
+
+int heapmgr_check_heap(void);
+/* Walk the whole heap and free list immediately, regardless of the
+   incremental validation budget.  Return 1 if the heap is consistent,
+   0 (after printing the reason to stderr) otherwise.  Always returns 1
+   in NDEBUG builds. */
+
+/* Free-block placement policies.  HEAPMGR_GOOD_FIT takes the best
+   fit among the first k blocks that are large enough. */
+enum heapmgr_policy {
+    HEAPMGR_FIRST_FIT, HEAPMGR_NEXT_FIT, HEAPMGR_BEST_FIT, HEAPMGR_GOOD_FIT
+};
+
+int heapmgr_set_policy(enum heapmgr_policy e_policy, unsigned ui_k);
+/* Select the placement policy used by later heapmgr_malloc() calls;
+   ui_k is the candidate bound of HEAPMGR_GOOD_FIT (0 means the
+   default) and is ignored otherwise.  May be called at any time.
+   Without a call, the policy comes from the HEAPMGR_POLICY
+   environment variable ("first", "next", "best", "good" or
+   "good:k"), read once at the first heapmgr_malloc(), and is
+   first-fit if that is unset.  Return 0, or -1 if e_policy is not a
+   policy. */
+
+/* Parameters that heapmgr1 tunes from its request stream. */
+struct heapmgr_params {
+    size_t ui_grow_units;  /* minimum payload units per heap growth */
+    size_t ui_split_min;   /* smallest remainder span a split leaves */
+    int i_tuning;          /* nonzero while either is being tuned */
+};
+
+void heapmgr_get_params(struct heapmgr_params *ps_params);
+/* Fill *ps_params with the current values.  The HEAPMGR_OPTS
+   environment variable, read once at the first heapmgr_malloc(),
+   is a comma-separated list of tune=0 (keep both fixed), grow=N
+   (pin the growth to N units), split=N (pin the split remainder to
+   N units, 3..64) and window=N (retune every N mallocs, default
+   4096). */
+
+/* Stats page.  If the HEAPMGR_STATS_PAGE environment variable is set
+   (and not "0") at the first heapmgr_malloc(), the heapmgr_stats()
+   counters are kept in a struct heapmgr_stats_page in the POSIX
+   shared memory object HEAPMGR_STATS_PAGE_FMT (with the process ID),
+   so another process can map it read-only and watch the heap while
+   the program runs (test/topheapmgr.c).  The counters are updated
+   with relaxed atomic stores, so a reader sees each one whole but
+   not all of them at the same instant.  ui_bytes_in_use and
+   ui_largest_free are not kept there; in use is heap minus free.
+   The object is removed at exit(); a process that dies otherwise
+   leaves it behind.  A forked child keeps counting privately.
+   aul_length_hist, kept only on the page, counts the successful
+   mallocs by the free-list length (free blocks) left after each,
+   in the buckets of aul_search_hist (see heapmgr.h). */
+#define HEAPMGR_STATS_PAGE_FMT "/heapmgr.%d"
+#define HEAPMGR_STATS_PAGE_MAGIC "HMSTATS"
+enum {HEAPMGR_STATS_PAGE_VERSION = 2};
+
+struct heapmgr_stats_page {
+    char ac_magic[8];              /* HEAPMGR_STATS_PAGE_MAGIC once ready */
+    unsigned ui_version;
+    int i_pid;                     /* the process that writes it */
+    struct heapmgr_stats s_stats;
+    unsigned long aul_length_hist[HEAPMGR_SEARCH_BUCKETS];
+};
+
+#endif
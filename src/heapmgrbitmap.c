@@ -0,0 +1,482 @@
+/*--------------------------------------------------------------------*/
+/* heapmgrbitmap.c                                                    */
+/* 블록 헤더 없이 bitmap으로 관리하는 heapmgr                           */
+/*--------------------------------------------------------------------*/
+
+/* heap은 sbrk로 키우는 CHUNK_UNIT(16 bytes) 배열이고, 블록에는 헤더/푸터가 없다.
+ * 메타데이터는 모두 heap 밖(mmap)의 bitmap 세 개:
+ *  s_used[]:  unit당 1비트, 1이면 할당됨
+ *  s_start[]: unit당 1비트, 1이면 할당 블록의 첫 unit (블록 경계)
+ *  s_full[]:  s_used의 word(64 unit)당 1비트, 1이면 그 word가 가득 참 (요약 레벨)
+ * 할당 블록의 크기는 첫 unit부터 다음 start 비트나 다음 빈 unit까지이고, 연속된 빈
+ * unit들이 곧 free 블록이므로 병합은 비트를 지우는 것만으로 끝난다.
+ * 할당은 주소 순 first-fit. 가득 찬 word는 s_full로 한 번에 64개씩 건너뛰고, word 안의
+ * 빈 run은 ctz/clz와 shift-and로, 여러 word에 걸친 긴 빈 run은 SIMD로 찾는다.
+ * client가 payload 밖에 써도 메타데이터는 망가지지 않는다.
+ * heapmgr1과 같이 sbrk 영역은 이 모듈 혼자 쓴다고 가정한다. */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <sys/mman.h>
+#include "chunk.h"
+#include "heapmgr.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#define FALSE 0
+#define TRUE  1
+
+enum {
+    WORD_BITS = 64,
+    SYS_MIN_ALLOC_UNITS = 1024,     // heap growth 최소 unit 수 (heapmgr1과 같음)
+    MIN_CAP_WORDS = 256             // bitmap 초기 용량 (WORD_BITS의 배수)
+};
+
+/* sbrk()가 intptr_t를 받으므로 heap 전체가 INTPTR_MAX bytes를 넘으면 안 됨 */
+#define MAX_UNITS ((size_t)INTPTR_MAX / CHUNK_UNIT)
+#define NONE ((size_t)-1)
+
+/* unit 0의 주소 (CHUNK_UNIT 정렬). NULL이면 아직 부팅 전 */
+static char *s_heap_lo = NULL;
+/* heap의 unit 수. 항상 WORD_BITS의 배수로 키우므로 마지막 word도 꽉 차 있음 */
+static size_t s_units = 0;
+
+static uint64_t *s_used, *s_start, *s_full;
+/* s_used/s_start의 word 용량. s_full은 s_cap_words / WORD_BITS word.
+ * heap 밖의 word와 그 요약 비트는 모두 0 */
+static size_t s_cap_words = 0;
+
+/* 이보다 앞의 word는 모두 가득 참 (first-fit 탐색 시작점) */
+static size_t s_hint = 0;
+
+static size_t s_units_used = 0;
+
+/* 런타임 통계. ui_* 크기 필드는 heapmgr_stats()에서 계산 */
+static struct heapmgr_stats s_stats;
+
+static inline int bit_get(const uint64_t *map, size_t i) {
+    return (int)((map[i / WORD_BITS] >> (i % WORD_BITS)) & 1);
+}
+
+static inline void bit_set(uint64_t *map, size_t i) {
+    map[i / WORD_BITS] |= 1ull << (i % WORD_BITS);
+}
+
+static inline void bit_clear(uint64_t *map, size_t i) {
+    map[i / WORD_BITS] &= ~(1ull << (i % WORD_BITS));
+}
+
+/* bits_fill: map의 [i, i + n) 비트를 모두 1(on) 또는 0으로 */
+static void bits_fill(uint64_t *map, size_t i, size_t n, int on) {
+    while (n > 0) {
+        size_t b = i % WORD_BITS;
+        size_t k = (WORD_BITS - b < n) ? WORD_BITS - b : n;
+        uint64_t m = (k == WORD_BITS) ? ~0ull : ((1ull << k) - 1) << b;
+        if (on) map[i / WORD_BITS] |= m;
+        else map[i / WORD_BITS] &= ~m;
+        i += k;
+        n -= k;
+    }
+}
+
+/* used_fill: unit [u, u + n)를 할당(on)/해제하고 건드린 word의 요약 비트를 고침 */
+static void used_fill(size_t u, size_t n, int on) {
+    size_t w, w_end = (u + n - 1) / WORD_BITS;
+
+    bits_fill(s_used, u, n, on);
+    for (w = u / WORD_BITS; w <= w_end; w++) {
+        if (s_used[w] == ~0ull) bit_set(s_full, w);
+        else bit_clear(s_full, w);
+    }
+}
+
+/* runs_of: f에서 k(< 64)개 연속으로 1인 구간의 시작 비트들.
+ * f &= f >> sh를 반복하면 비트 p는 p부터 have개가 모두 1일 때만 남는다 */
+static inline uint64_t runs_of(uint64_t f, size_t k) {
+    size_t have = 1;
+
+    while (have < k && f != 0) {
+        size_t sh = (have < k - have) ? have : k - have;
+        f &= f >> sh;
+        have += sh;
+    }
+    return f;
+}
+
+/* zero_words_*: a[i..n)에서 0이 아닌 첫 word 위치, 없으면 n.
+ * 통째로 빈 word가 이어지는 큰 요청에서 빈 run을 늘릴 때 쓴다 */
+typedef size_t (*zero_words_fn)(const uint64_t *a, size_t i, size_t n);
+
+static size_t zero_words_scalar(const uint64_t *a, size_t i, size_t n) {
+    while (i < n && a[i] == 0) i++;
+    return i;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("sse2")))
+static size_t zero_words_sse2(const uint64_t *a, size_t i, size_t n) {
+    const __m128i zero = _mm_setzero_si128();
+
+    for (; i + 4 <= n; i += 4) {
+        __m128i v = _mm_or_si128(_mm_loadu_si128((const __m128i *)(a + i)),
+                                 _mm_loadu_si128((const __m128i *)(a + i + 2)));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(v, zero)) != 0xFFFF) break;
+    }
+    return zero_words_scalar(a, i, n);
+}
+
+__attribute__((target("avx2")))
+static size_t zero_words_avx2(const uint64_t *a, size_t i, size_t n) {
+    for (; i + 8 <= n; i += 8) {
+        __m256i v = _mm256_or_si256(_mm256_loadu_si256((const __m256i *)(a + i)),
+                                    _mm256_loadu_si256((const __m256i *)(a + i + 4)));
+        if (!_mm256_testz_si256(v, v)) break;
+    }
+    return zero_words_sse2(a, i, n);
+}
+#endif
+
+static zero_words_fn s_zero_words = zero_words_scalar;
+
+/* next_nonfull: w 이후 가득 차지 않은 첫 word. heap 밖 요약 비트는 0이므로
+ * 모두 가득 찼으면 heap의 word 수 이상을 돌려줌 */
+static size_t next_nonfull(size_t w) {
+    size_t j = w / WORD_BITS, n = s_cap_words / WORD_BITS;
+    uint64_t m = ~s_full[j] & (~0ull << (w % WORD_BITS));
+
+    while (m == 0) {
+        if (++j >= n) return s_cap_words;
+        m = ~s_full[j];
+    }
+    return j * WORD_BITS + (size_t)__builtin_ctzll(m);
+}
+
+/*디버그용 함수*/
+#ifndef NDEBUG
+
+/* 검사 비용이 heap 크기(word 수)에 비례하므로, 매 호출은 건드린 word들만 검사하고
+ * CHECK_EVERY번마다 전체를 검사한다 */
+enum { CHECK_EVERY = 1024 };
+
+/* check_words: word [w_lo, w_hi)의 비트 불변식 검사. used 비트 수를 *p_used에 더함 */
+static int check_words(size_t w_lo, size_t w_hi, size_t *p_used) {
+    size_t w, words = s_units / WORD_BITS;
+    uint64_t carry = (w_lo == 0) ? 1 : s_used[w_lo - 1] >> 63; // unit -1은 할당된 것으로 봄
+
+    for (w = w_lo; w < w_hi; w++) {
+        uint64_t u = s_used[w], s = s_start[w];
+        if (w >= words) {
+            if (u != 0 || s != 0 || bit_get(s_full, w)) {
+                fprintf(stderr, "Bits set past the end of the heap\n");
+                return FALSE;
+            }
+            continue;
+        }
+        if (bit_get(s_full, w) != (u == ~0ull)) {
+            fprintf(stderr, "Summary bit out of sync\n");
+            return FALSE;
+        }
+        if (w < s_hint && u != ~0ull) {
+            fprintf(stderr, "Free unit before the search hint\n");
+            return FALSE;
+        }
+        if (s & ~u) {
+            fprintf(stderr, "Block start on a free unit\n");
+            return FALSE;
+        }
+        /* 앞 unit이 비어 있는 할당 unit은 반드시 블록의 시작 */
+        if (u & ~((u << 1) | carry) & ~s) {
+            fprintf(stderr, "Allocated run without a block start\n");
+            return FALSE;
+        }
+        carry = u >> 63;
+        *p_used += (size_t)__builtin_popcountll(u);
+    }
+    return TRUE;
+}
+
+static int check_heap_validity(void) {
+    size_t used = 0;
+
+    if (s_heap_lo == NULL) return TRUE;
+    if (s_units % WORD_BITS != 0 || s_units / WORD_BITS > s_cap_words) {
+        fprintf(stderr, "Heap size out of bitmap\n");
+        return FALSE;
+    }
+    if (!check_words(0, s_cap_words, &used)) return FALSE;
+    if (used != s_units_used) {
+        fprintf(stderr, "Used unit count mismatch\n");
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* check_heap: unit [u, u + n)를 덮는 word와 양옆 word를 검사 */
+static int check_heap(size_t u, size_t n) {
+    static unsigned long ops = 0;
+    size_t used = 0, w_lo, w_hi;
+
+    if (s_heap_lo == NULL || s_cap_words == 0) return TRUE;
+    if (++ops % CHECK_EVERY == 0) return check_heap_validity();
+    w_lo = u / WORD_BITS;
+    w_hi = (u + n + WORD_BITS - 1) / WORD_BITS + 1;
+    if (w_lo > 0) w_lo--;
+    if (w_hi > s_cap_words) w_hi = s_cap_words;
+    return check_words(w_lo, w_hi, &used);
+}
+#endif
+
+static void heap_bootstrap(void) {
+    char *p = sbrk(0);
+    size_t pad;
+
+    if (p == (void *)-1) {
+        fprintf(stderr, "sbrk(0) failed\n");
+        exit(-1);
+    }
+    /* unit 0을 CHUNK_UNIT에 맞춤 */
+    pad = (CHUNK_UNIT - (uintptr_t)p % CHUNK_UNIT) % CHUNK_UNIT;
+    if (pad != 0 && sbrk((intptr_t)pad) == (void *)-1) {
+        fprintf(stderr, "sbrk failed\n");
+        exit(-1);
+    }
+    s_heap_lo = p + pad;
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) s_zero_words = zero_words_avx2;
+    else if (__builtin_cpu_supports("sse2")) s_zero_words = zero_words_sse2;
+#endif
+}
+
+static void *map_words(size_t words) {
+    void *p = mmap(NULL, words * sizeof(uint64_t), PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return (p == MAP_FAILED) ? NULL : p;
+}
+
+/* bitmap_reserve: heap이 words word까지 커질 수 있게 bitmap을 늘림 */
+static int bitmap_reserve(size_t words) {
+    size_t cap = s_cap_words ? s_cap_words : MIN_CAP_WORDS;
+    uint64_t *used, *start, *full;
+
+    if (words <= s_cap_words) return TRUE;
+    while (cap < words) cap *= 2;
+    used = map_words(cap);
+    start = map_words(cap);
+    full = map_words(cap / WORD_BITS);
+    if (used == NULL || start == NULL || full == NULL) {
+        if (used) munmap(used, cap * sizeof(uint64_t));
+        if (start) munmap(start, cap * sizeof(uint64_t));
+        if (full) munmap(full, cap / WORD_BITS * sizeof(uint64_t));
+        return FALSE;
+    }
+    if (s_cap_words) {
+        memcpy(used, s_used, s_cap_words * sizeof(uint64_t));
+        memcpy(start, s_start, s_cap_words * sizeof(uint64_t));
+        memcpy(full, s_full, s_cap_words / WORD_BITS * sizeof(uint64_t));
+        munmap(s_used, s_cap_words * sizeof(uint64_t));
+        munmap(s_start, s_cap_words * sizeof(uint64_t));
+        munmap(s_full, s_cap_words / WORD_BITS * sizeof(uint64_t));
+    }
+    s_used = used;
+    s_start = start;
+    s_full = full;
+    s_cap_words = cap;
+    return TRUE;
+}
+
+/* heap_grow: k unit을 할당할 수 있게 heap을 키우고 그 시작 unit을 돌려줌.
+ * heap 끝의 빈 unit tail개는 새 영역과 이어지므로 함께 씀 */
+static size_t heap_grow(size_t k, size_t tail) {
+    size_t g = k - tail;
+
+    if (g < SYS_MIN_ALLOC_UNITS) g = SYS_MIN_ALLOC_UNITS;
+    g = (g + WORD_BITS - 1) / WORD_BITS * WORD_BITS;
+    if (g > MAX_UNITS - s_units) return NONE;
+    if (!bitmap_reserve((s_units + g) / WORD_BITS)) return NONE;
+    if (sbrk((intptr_t)(g * CHUNK_UNIT)) == (void *)-1) return NONE;
+
+    s_units += g;
+    s_stats.ui_heap_bytes += g * CHUNK_UNIT;
+    s_stats.ul_growths++;
+    return s_units - g - tail;
+}
+
+/* find_run: 주소 순으로 k개 연속 빈 unit의 시작을 찾음.
+ * 없으면 NONE을 돌려주고 *p_tail에 heap 끝에 붙은 빈 unit 수를 넣음.
+ * run/start는 지금 word 바로 앞에서 끝나는 빈 run */
+static size_t find_run(size_t k, size_t *p_tail, unsigned long *p_visited) {
+    size_t words = s_units / WORD_BITS, w = s_hint, run = 0, start = 0;
+    unsigned long visited = 0;
+    int first = TRUE;
+
+    while (w < words) {
+        uint64_t used;
+
+        if (run == 0) {
+            /* 이어지는 run이 없으면 가득 찬 word는 통째로 건너뜀 */
+            w = next_nonfull(w);
+            if (first) {
+                s_hint = w;
+                first = FALSE;
+            }
+            if (w >= words) break;
+        }
+        used = s_used[w];
+        visited++;
+
+        if (used == 0) {
+            size_t j;
+            if (run == 0) start = w * WORD_BITS;
+            if (run + WORD_BITS >= k) goto found;
+            j = s_zero_words(s_used, w + 1, words);
+            run += (j - w) * WORD_BITS;
+            if (run >= k) goto found;
+            w = j;
+            continue;
+        }
+        if (used == ~0ull) {
+            run = 0;
+            w++;
+            continue;
+        }
+        /* 아래쪽 빈 unit은 앞 word의 run에 이어짐 */
+        if (run > 0 && run + (size_t)__builtin_ctzll(used) >= k) goto found;
+        if (k < WORD_BITS) {
+            uint64_t m = runs_of(~used, k);
+            if (m != 0) {
+                start = w * WORD_BITS + (size_t)__builtin_ctzll(m);
+                goto found;
+            }
+        }
+        /* 위쪽 빈 unit은 다음 word로 이어질 수 있는 새 run */
+        run = (size_t)__builtin_clzll(used);
+        start = (w + 1) * WORD_BITS - run;
+        w++;
+    }
+    *p_tail = run;
+    *p_visited = visited;
+    return NONE;
+
+found:
+    *p_visited = visited;
+    return start;
+}
+
+/* block_units: u에서 시작하는 할당 블록의 unit 수 (다음 블록 시작이나 빈 unit까지) */
+static size_t block_units(size_t u) {
+    size_t i = u + 1, w, words = s_units / WORD_BITS;
+    uint64_t stop;
+
+    if (i >= s_units) return s_units - u;
+    w = i / WORD_BITS;
+    stop = (s_start[w] | ~s_used[w]) & (~0ull << (i % WORD_BITS));
+    while (stop == 0) {
+        if (++w >= words) return s_units - u;
+        stop = s_start[w] | ~s_used[w];
+    }
+    return w * WORD_BITS + (size_t)__builtin_ctzll(stop) - u;
+}
+
+void *heapmgr_malloc(size_t ui_bytes)
+{
+    size_t k, u, tail = 0;
+    unsigned long n_visited = 0;
+
+    if (ui_bytes == 0) return NULL;
+    if (ui_bytes > MAX_UNITS * CHUNK_UNIT) return NULL;
+    if (s_heap_lo == NULL) heap_bootstrap();
+
+    k = (ui_bytes + CHUNK_UNIT - 1) / CHUNK_UNIT;
+    u = find_run(k, &tail, &n_visited);
+    if (u == NONE) {
+        u = heap_grow(k, tail);
+        if (u == NONE) return NULL;
+    }
+
+    /* 빈 run의 일부만 쓰면 split으로 셈 */
+    if (u + k < s_units && !bit_get(s_used, u + k)) s_stats.ul_splits++;
+    used_fill(u, k, TRUE);
+    bit_set(s_start, u);
+    s_units_used += k;
+    s_stats.ul_mallocs++;
+    s_stats.aul_search_hist[heapmgr_search_bucket(n_visited)]++;
+
+    assert(check_heap(u, k));
+    return s_heap_lo + u * CHUNK_UNIT;
+}
+
+
+void heapmgr_free(void *pv_bytes)
+{
+    size_t u, n;
+
+    if (pv_bytes == NULL) return;
+    assert((char *)pv_bytes >= s_heap_lo);
+    assert(((char *)pv_bytes - s_heap_lo) % CHUNK_UNIT == 0);
+
+    u = (size_t)((char *)pv_bytes - s_heap_lo) / CHUNK_UNIT;
+    assert(u < s_units && bit_get(s_start, u));
+    /* 블록 시작이 아닌 포인터(이중 free 포함)는 메타데이터를 건드리지 않고 무시 */
+    if ((char *)pv_bytes < s_heap_lo || u >= s_units || !bit_get(s_start, u)) return;
+
+    n = block_units(u);
+    bit_clear(s_start, u);
+    used_fill(u, n, FALSE);
+    s_units_used -= n;
+    if (u > 0 && !bit_get(s_used, u - 1)) s_stats.ul_coalesces++;
+    if (u + n < s_units && !bit_get(s_used, u + n)) s_stats.ul_coalesces++;
+    if (u / WORD_BITS < s_hint) s_hint = u / WORD_BITS;
+    s_stats.ul_frees++;
+
+    assert(check_heap(u, n));
+}
+
+void heapmgr_stats(struct heapmgr_stats *ps_stats)
+{
+    size_t w, words = s_units / WORD_BITS, run = 0, largest = 0, blocks = 0;
+    uint64_t carry = 1; // unit -1은 할당된 것으로 봄
+
+    assert(ps_stats != NULL);
+
+    *ps_stats = s_stats;
+    ps_stats->ui_bytes_in_use = s_units_used * CHUNK_UNIT;
+    ps_stats->ui_bytes_free = ps_stats->ui_heap_bytes - ps_stats->ui_bytes_in_use;
+
+    /* free 블록 = 최대 빈 run. 앞 unit이 할당된 빈 unit 수를 popcount로 세고,
+     * 가장 긴 run은 word 안의 run 경계를 ctz로 따라가며 잰다 */
+    for (w = 0; w < words; w++) {
+        uint64_t used = s_used[w];
+        unsigned b = 0;
+
+        blocks += (size_t)__builtin_popcountll(~used & ((used << 1) | carry));
+        carry = used >> 63;
+        if (used == 0) {
+            run += WORD_BITS;
+            continue;
+        }
+        if (used == ~0ull) {
+            if (run > largest) largest = run;
+            run = 0;
+            continue;
+        }
+        while (b < WORD_BITS) {
+            uint64_t rest = used >> b;
+            if (rest & 1) {
+                if (run > largest) largest = run;
+                run = 0;
+                b += (unsigned)__builtin_ctzll(~rest); // used != ~0이거나 b > 0이라 ~rest != 0
+            } else {
+                unsigned z = rest ? (unsigned)__builtin_ctzll(rest) : WORD_BITS - b;
+                run += z;
+                b += z;
+            }
+        }
+    }
+    if (run > largest) largest = run;
+    ps_stats->ui_free_blocks = blocks;
+    ps_stats->ui_largest_free = largest * CHUNK_UNIT;
+}
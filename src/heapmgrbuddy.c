@@ -0,0 +1,312 @@
+/*--------------------------------------------------------------------*/
+/* heapmgrbuddy.c                                                     */
+/* binary buddy heapmgr                                               */
+/*--------------------------------------------------------------------*/
+
+/* 모든 블록은 2^k bytes (order k, MIN_ORDER <= k <= MAX_ORDER)이고, heap 시작점에서
+ * 자기 크기의 배수 위치에 있다. 그래서 offset이 off인 order k 블록의 buddy는 항상
+ * off ^ 2^k이고, split/merge는 order마다 한 번씩, 최대 O(log n)번이면 끝난다.
+ *  s_lists[k]: order k free 블록의 이중 연결 리스트 (링크는 free 블록 안에 둠)
+ *  s_nonempty: 비어 있지 않은 s_lists의 bitmask. 맞는 order를 ctz 한 번으로 찾음
+ *  s_order[]:  unit(16 bytes)당 1 byte, 그 unit에서 시작하는 블록의 order
+ *  s_free_map: unit당 1비트, 그 unit에서 free 블록이 시작함 (buddy 상태)
+ * 블록 안에 헤더가 없으므로 payload가 곧 블록이고, heap 시작점을 페이지에 맞추므로
+ * 페이지 이하 블록은 절대 주소로도 자기 크기에 정렬된다 (I/O 버퍼 등).
+ * 대신 요청 크기를 2의 거듭제곱으로 올리는 만큼 내부 단편화가 생긴다.
+ * heapmgr1과 같이 sbrk 영역은 이 모듈 혼자 쓴다고 가정한다. */
+
+#define _GNU_SOURCE // mremap
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <assert.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "heapmgr.h"
+
+#define FALSE 0
+#define TRUE  1
+
+enum {
+    MIN_ORDER = 4,          // 16 bytes: free-list 링크 두 개
+    MAX_ORDER = 62,
+    GROW_ORDER = 16,        // heap은 최소 64 KiB 블록 단위로 키움
+    BASE_ALIGN = 4096,
+    MIN_META_UNITS = 1 << 16
+};
+
+typedef struct FreeBlock *FreeBlock_T;
+struct FreeBlock {
+    FreeBlock_T next, prev;
+};
+
+/* heap: [s_base, s_base + s_top). s_base는 BASE_ALIGN에 정렬 */
+static char *s_base = NULL;
+static size_t s_top = 0;
+
+static FreeBlock_T s_lists[MAX_ORDER + 1];
+static uint64_t s_nonempty = 0;
+
+static uint8_t *s_order;
+static uint64_t *s_free_map;
+static size_t s_meta_units = 0;     // s_order/s_free_map 용량 (unit 수)
+
+/* 런타임 통계. ui_bytes_free, ui_free_blocks는 list를 고칠 때마다 갱신 */
+static struct heapmgr_stats s_stats;
+
+static inline size_t unit_of(size_t off) {
+    return off >> MIN_ORDER;
+}
+
+static inline int free_bit(size_t u) {
+    return (int)((s_free_map[u / 64] >> (u % 64)) & 1);
+}
+
+static inline size_t order_size(int k) {
+    return (size_t)1 << k;
+}
+
+/* order_for: n bytes를 담는 가장 작은 order */
+static int order_for(size_t n) {
+    if (n <= order_size(MIN_ORDER)) return MIN_ORDER;
+    return 64 - __builtin_clzll((unsigned long long)(n - 1));
+}
+
+static void list_push(size_t off, int k) {
+    FreeBlock_T b = (FreeBlock_T)(s_base + off);
+    size_t u = unit_of(off);
+
+    b->prev = NULL;
+    b->next = s_lists[k];
+    if (b->next) b->next->prev = b;
+    s_lists[k] = b;
+    s_nonempty |= 1ull << k;
+    s_order[u] = (uint8_t)k;
+    s_free_map[u / 64] |= 1ull << (u % 64);
+    s_stats.ui_bytes_free += order_size(k);
+    s_stats.ui_free_blocks++;
+}
+
+static void list_remove(size_t off, int k) {
+    FreeBlock_T b = (FreeBlock_T)(s_base + off);
+    size_t u = unit_of(off);
+
+    if (b->prev) b->prev->next = b->next;
+    else s_lists[k] = b->next;
+    if (b->next) b->next->prev = b->prev;
+    if (s_lists[k] == NULL) s_nonempty &= ~(1ull << k);
+    s_free_map[u / 64] &= ~(1ull << (u % 64));
+    s_stats.ui_bytes_free -= order_size(k);
+    s_stats.ui_free_blocks--;
+}
+
+/* free_insert: order k 블록을 free로. buddy도 같은 order의 free 블록이면 합쳐서 올라감 */
+static void free_insert(size_t off, int k) {
+    while (k < MAX_ORDER) {
+        size_t buddy = off ^ order_size(k);
+        /* 정렬돼 있으므로 buddy는 heap 안에 통째로 있거나 통째로 밖에 있음 */
+        if (buddy >= s_top || !free_bit(unit_of(buddy)) || s_order[unit_of(buddy)] != k)
+            break;
+        list_remove(buddy, k);
+        s_stats.ul_coalesces++;
+        off &= ~order_size(k);
+        k++;
+    }
+    list_push(off, k);
+}
+
+/*디버그용 함수*/
+#ifndef NDEBUG
+static int check_heap_validity(void) {
+    size_t off, n_free = 0, free_bytes = 0;
+    int k;
+
+    if (s_base == NULL) return TRUE;
+    if ((uintptr_t)s_base % BASE_ALIGN != 0 || unit_of(s_top) > s_meta_units) {
+        fprintf(stderr, "Bad heap bounds\n");
+        return FALSE;
+    }
+
+    /* 모든 블록을 주소 순서대로 순회 */
+    for (off = 0; off < s_top; off += order_size(k)) {
+        size_t u = unit_of(off);
+        k = s_order[u];
+        if (k < MIN_ORDER || k > MAX_ORDER || off % order_size(k) != 0
+            || order_size(k) > s_top - off) {
+            fprintf(stderr, "Misaligned or oversized block\n");
+            return FALSE;
+        }
+        if (free_bit(u)) {
+            size_t buddy = off ^ order_size(k);
+            n_free++;
+            free_bytes += order_size(k);
+            if (buddy < s_top && free_bit(unit_of(buddy)) && s_order[unit_of(buddy)] == k) {
+                fprintf(stderr, "Uncoalesced free buddies\n");
+                return FALSE;
+            }
+        }
+    }
+    if (n_free != s_stats.ui_free_blocks || free_bytes != s_stats.ui_bytes_free) {
+        fprintf(stderr, "Free block count mismatch\n");
+        return FALSE;
+    }
+
+    /* free list마다 order, free 비트, 역방향 링크 확인 */
+    for (k = 0; k <= MAX_ORDER; k++) {
+        FreeBlock_T b, prev = NULL;
+        if ((s_lists[k] != NULL) != (int)((s_nonempty >> k) & 1)) {
+            fprintf(stderr, "Non-empty mask out of sync\n");
+            return FALSE;
+        }
+        for (b = s_lists[k]; b != NULL; prev = b, b = b->next) {
+            size_t off_b = (size_t)((char *)b - s_base);
+            if ((char *)b < s_base || off_b >= s_top || b->prev != prev
+                || !free_bit(unit_of(off_b)) || s_order[unit_of(off_b)] != k) {
+                fprintf(stderr, "Broken free list of order %d\n", k);
+                return FALSE;
+            }
+            if (n_free-- == 0) {
+                fprintf(stderr, "Free lists longer than free blocks\n");
+                return FALSE;
+            }
+        }
+    }
+    if (n_free != 0) {
+        fprintf(stderr, "Free block missing from the free lists\n");
+        return FALSE;
+    }
+    return TRUE;
+}
+#endif
+
+static void heap_bootstrap(void) {
+    char *p = sbrk(0);
+    size_t pad;
+
+    if (p == (void *)-1) {
+        fprintf(stderr, "sbrk(0) failed\n");
+        exit(-1);
+    }
+    pad = (BASE_ALIGN - (uintptr_t)p % BASE_ALIGN) % BASE_ALIGN;
+    if (pad != 0 && sbrk((intptr_t)pad) == (void *)-1) {
+        fprintf(stderr, "sbrk failed\n");
+        exit(-1);
+    }
+    s_base = p + pad;
+}
+
+/* meta_reserve: unit units개를 덮도록 s_order/s_free_map을 늘림.
+ * mremap은 페이지를 복사하지 않으므로 건드리지 않은 부분은 계속 0 페이지로 남음 */
+static int meta_reserve(size_t units) {
+    size_t cap = s_meta_units ? s_meta_units : MIN_META_UNITS;
+    void *o, *f;
+
+    if (units <= s_meta_units) return TRUE;
+    while (cap < units) cap *= 2;
+    if (s_meta_units == 0) {
+        o = mmap(NULL, cap, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (o == MAP_FAILED) return FALSE;
+        f = mmap(NULL, cap / 8, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (f == MAP_FAILED) {
+            munmap(o, cap);
+            return FALSE;
+        }
+    } else {
+        /* 하나만 늘어나도 둘 다 유효하므로 s_meta_units만 그대로 두면 됨 */
+        o = mremap(s_order, s_meta_units, cap, MREMAP_MAYMOVE);
+        if (o == MAP_FAILED) return FALSE;
+        s_order = o;
+        f = mremap(s_free_map, s_meta_units / 8, cap / 8, MREMAP_MAYMOVE);
+        if (f == MAP_FAILED) return FALSE;
+    }
+    s_order = o;
+    s_free_map = f;
+    s_meta_units = cap;
+    return TRUE;
+}
+
+/* heap_extend: heap 끝(이미 2^j에 정렬)에 order j 블록을 붙여 free로 */
+static int heap_extend(int j) {
+    size_t size = order_size(j);
+
+    if (size > (size_t)INTPTR_MAX - s_top) return FALSE;
+    if (!meta_reserve(unit_of(s_top + size))) return FALSE;
+    if (sbrk((intptr_t)size) == (void *)-1) return FALSE;
+    s_top += size;
+    s_stats.ui_heap_bytes += size;
+    s_stats.ul_growths++;
+    free_insert(s_top - size, j);
+    return TRUE;
+}
+
+/* heap_grow: order k 이상의 free 블록이 생기도록 heap을 키움.
+ * 새 블록은 자기 크기에 정렬돼야 하므로, heap 끝이 정렬될 때까지 끝의 정렬에 맞는
+ * 작은 블록들로 먼저 채운다. 이 블록들도 free list에 들어가 재사용됨 */
+static int heap_grow(int k) {
+    int kg = (k < GROW_ORDER) ? GROW_ORDER : k;
+
+    while (s_top & (order_size(kg) - 1)) {
+        if (!heap_extend(__builtin_ctzll(s_top))) return FALSE;
+    }
+    return heap_extend(kg);
+}
+
+void *heapmgr_malloc(size_t ui_bytes)
+{
+    size_t off;
+    int k, j;
+
+    if (ui_bytes == 0) return NULL;
+    if (ui_bytes > order_size(MAX_ORDER)) return NULL;
+    if (s_base == NULL) heap_bootstrap();
+    assert(check_heap_validity());
+
+    k = order_for(ui_bytes);
+    if ((s_nonempty >> k) == 0 && !heap_grow(k)) return NULL;
+
+    /* k 이상에서 가장 작은 free 블록을 떼어 k가 될 때까지 반으로 나눔.
+     * 위쪽 절반(buddy)은 한 order 아래 list로 */
+    j = k + __builtin_ctzll(s_nonempty >> k);
+    off = (size_t)((char *)s_lists[j] - s_base);
+    list_remove(off, j);
+    s_stats.aul_search_hist[heapmgr_search_bucket((unsigned long)(j - k))]++;
+    while (j > k) {
+        j--;
+        list_push(off + order_size(j), j);
+        s_stats.ul_splits++;
+    }
+    s_order[unit_of(off)] = (uint8_t)k;
+    s_stats.ul_mallocs++;
+
+    assert(check_heap_validity());
+    return s_base + off;
+}
+
+
+void heapmgr_free(void *pv_bytes)
+{
+    size_t off;
+
+    if (pv_bytes == NULL) return;
+    assert(check_heap_validity());
+
+    off = (size_t)((char *)pv_bytes - s_base);
+    assert((char *)pv_bytes >= s_base && off < s_top);
+    assert(off % order_size(MIN_ORDER) == 0 && !free_bit(unit_of(off)));
+    assert(off % order_size(s_order[unit_of(off)]) == 0);
+
+    free_insert(off, s_order[unit_of(off)]);
+    s_stats.ul_frees++;
+
+    assert(check_heap_validity());
+}
+
+void heapmgr_stats(struct heapmgr_stats *ps_stats)
+{
+    assert(ps_stats != NULL);
+
+    *ps_stats = s_stats;
+    ps_stats->ui_bytes_in_use = s_stats.ui_heap_bytes - s_stats.ui_bytes_free;
+    /* 가장 큰 free 블록은 비어 있지 않은 가장 높은 order */
+    ps_stats->ui_largest_free = s_nonempty ? order_size(63 - __builtin_clzll(s_nonempty)) : 0;
+}
@@ -0,0 +1,685 @@
+/*--------------------------------------------------------------------*/
+/* heapmgrpersist.c                                                   */
+/* file-backed persistent heapmgr                                     */
+/*--------------------------------------------------------------------*/
+
+/* heap 전체가 MAP_SHARED로 map된 파일 하나다. 파일은 다음 프로세스에서 다른 주소에
+ * map될 수 있으므로, 파일 안에는 포인터 대신 파일 시작점부터의 offset만 저장한다.
+ *  [0, HEAP_ALIGN):    struct persist_header (magic, top, free list heads, root, 통계)
+ *  [HEAP_ALIGN, top):  블록들. heapmgr1과 같은 16-byte unit, header/footer 태그
+ *                      (word = span << 2 | flags), header.link = 다음 free 블록,
+ *                      footer.link = 이전 free 블록 (offset, 0이면 없음)
+ * free list는 span의 floor(log2)별 class마다 하나씩 있는 LIFO 이중 연결 리스트이고,
+ * free할 때 앞뒤 블록과 바로 합친다. 주소 순서 삽입처럼 list를 훑지 않으므로 free는
+ * O(1)이고, 작은 요청이 큰 free 블록을 갉아먹지 않는다 (한 list로 LIFO first-fit을
+ * 하면 huge_mixed에서 방금 free된 GiB 블록이 잘게 쪼개져 heap이 수십 GiB로 늘었음).
+ *
+ * crash 일관성: 태그의 header word가 유일한 기준이고, free list, footer, 통계는
+ * header word들로부터 다시 만들 수 있는 캐시다. 모든 연산은 header word 하나를
+ * 쓰는 것으로 commit되도록 순서를 맞춘다 (split은 떼어낼 블록의 태그를 먼저 쓰고
+ * 남는 free 블록의 span을 줄임, 병합은 앞 블록의 span을 늘림, heap 확장은 ul_top을
+ * 먼저 올림). open 중에는 ui_clean이 0이므로, close 없이 끝난 파일을 다시 열면
+ * 블록을 처음부터 끝까지 한 번 훑어 footer와 free list를 다시 만든다 (recover).
+ * 이 순서는 프로세스 crash에 대한 것이고, 시스템 crash까지 견디려면
+ * heapmgr_persist_sync()로 파일에 내려 써야 한다.
+ *
+ * 여러 프로세스가 같은 파일(또는 shm_open 객체)을 열 수 있다. 각자 다른 주소에
+ * map하고, 모든 연산은 헤더 안의 process-shared robust mutex를 잡고 한다. 다른
+ * 프로세스가 파일을 늘렸으면 mutex를 잡을 때 그만큼 따라서 map한다 (catch_up).
+ * mutex를 쥔 채 죽은 프로세스가 있으면 다음에 잡는 쪽이 recover를 돌린다.
+ * 파일의 첫 byte에 건 OFD lock (프로세스가 죽으면 풀림)으로 처음 여는 프로세스와
+ * 마지막으로 닫는 프로세스를 가려, 처음 여는 쪽만 mutex를 새로 만들고 복구를 하며
+ * 마지막으로 닫는 쪽만 clean 표시를 한다. */
+
+#define _GNU_SOURCE // F_OFD_SETLK
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include "heapmgr.h"
+#include "heapmgrpersist.h"
+
+#define FALSE 0
+#define TRUE  1
+
+enum {
+    UNIT = 16,
+    CLASSES = 64,               // span의 floor(log2)
+    HEAP_ALIGN = 4096,          // 파일 헤더 크기이자 파일 크기 단위 (페이지)
+    MIN_SPAN = 3,               // header + payload 1 unit + footer
+    GROW_MIN_BYTES = 1 << 20,
+    PERSIST_VERSION = 2
+};
+
+#define PERSIST_MAGIC "HEAPMGRP"
+#define DEFAULT_MAX_BYTES ((size_t)1 << 40)
+
+/* 태그 word의 flag 비트 (chunk.h와 같은 배치) */
+#define F_ALLOC  1u
+#define F_HEADER 2u
+#define F_BITS   2
+
+struct Unit {
+    uint64_t word;
+    uint64_t link;
+};
+typedef struct Unit *Unit_T;
+
+/* 파일 맨 앞의 헤더. offset 0에는 블록이 없으므로 0을 "없음"으로 씀 */
+struct persist_header {
+    char ac_magic[8];
+    uint32_t ui_version;
+    uint32_t ui_clean;          // close가 1로, open이 0으로
+    uint64_t ul_top;            // 블록 영역의 끝
+    uint64_t ul_root;
+    uint64_t ul_nonempty;       // 비어 있지 않은 class의 bitmask
+    uint64_t ul_bytes_free;
+    uint64_t ul_free_blocks;
+    uint64_t ul_opens;
+    uint64_t ul_file_bytes;     // 파일 크기. 늘리는 프로세스가 갱신
+    uint64_t aul_free_heads[CLASSES];
+    pthread_mutex_t s_lock;     // process-shared, robust
+};
+
+/* s_base부터 s_reserved bytes의 주소 공간을 예약해 두고, 그 앞쪽 s_mapped bytes에
+ * 파일을 map한다 (s_mapped <= ul_file_bytes). heap이 커져도 블록은 움직이지 않음 */
+static char *s_base = NULL;
+static struct persist_header *s_hdr;
+static size_t s_reserved, s_mapped;
+static int s_fd = -1;
+
+/* 이 프로세스에서 이번 open 이후의 런타임 통계. heap 크기와 free 블록 수, bytes는
+ * 헤더에 있음 */
+static struct heapmgr_stats s_stats;
+
+static inline Unit_T at(uint64_t off) {
+    return (Unit_T)(s_base + off);
+}
+
+static inline uint64_t span_of(uint64_t off) {
+    return at(off)->word >> F_BITS;
+}
+
+static inline int is_alloc(uint64_t off) {
+    return (int)(at(off)->word & F_ALLOC);
+}
+
+static inline int class_of(uint64_t span) {
+    return 63 - __builtin_clzll(span);
+}
+
+static inline uint64_t footer_of(uint64_t off, uint64_t span) {
+    return off + (span - 1) * UNIT;
+}
+
+static inline void set_header(uint64_t off, uint64_t span, unsigned alloc) {
+    at(off)->word = span << F_BITS | F_HEADER | alloc;
+}
+
+static inline void set_footer(uint64_t off, uint64_t span, unsigned alloc) {
+    at(footer_of(off, span))->word = span << F_BITS | alloc;
+}
+
+/* list_push / list_remove: free 블록의 span을 바꾸기 전에 빼고, 바꾼 뒤에 넣음 */
+static void list_push(uint64_t off) {
+    uint64_t span = span_of(off);
+    int c = class_of(span);
+    uint64_t head = s_hdr->aul_free_heads[c];
+
+    at(off)->link = head;
+    at(footer_of(off, span))->link = 0;
+    if (head != 0) at(footer_of(head, span_of(head)))->link = off;
+    s_hdr->aul_free_heads[c] = off;
+    s_hdr->ul_nonempty |= 1ull << c;
+    s_hdr->ul_free_blocks++;
+    s_hdr->ul_bytes_free += span * UNIT;
+}
+
+static void list_remove(uint64_t off) {
+    uint64_t span = span_of(off);
+    uint64_t next = at(off)->link, prev = at(footer_of(off, span))->link;
+    int c = class_of(span);
+
+    if (prev != 0) at(prev)->link = next;
+    else if ((s_hdr->aul_free_heads[c] = next) == 0) s_hdr->ul_nonempty &= ~(1ull << c);
+    if (next != 0) at(footer_of(next, span_of(next)))->link = prev;
+    s_hdr->ul_free_blocks--;
+    s_hdr->ul_bytes_free -= span * UNIT;
+}
+
+/* coalesce_push: free로 표시된 블록(list 밖)을 앞뒤 free 블록과 합쳐 list에 넣음.
+ * 합쳐진 블록의 offset 반환 */
+static uint64_t coalesce_push(uint64_t off) {
+    uint64_t span = span_of(off), next = off + span * UNIT;
+
+    if (next < s_hdr->ul_top && !is_alloc(next)) {
+        list_remove(next);
+        span += span_of(next);
+        set_header(off, span, 0);   // commit
+        set_footer(off, span, 0);
+        s_stats.ul_coalesces++;
+    }
+    if (off > HEAP_ALIGN && !is_alloc(off - UNIT)) {
+        /* 앞 블록의 footer에도 span이 있음 */
+        uint64_t prev = off - span_of(off - UNIT) * UNIT;
+        list_remove(prev);
+        span += span_of(prev);
+        set_header(prev, span, 0);  // commit
+        set_footer(prev, span, 0);
+        off = prev;
+        s_stats.ul_coalesces++;
+    }
+    list_push(off);
+    return off;
+}
+
+/*디버그용 함수*/
+#ifndef NDEBUG
+static int check_heap_validity(void) {
+    uint64_t off, n_free = 0, free_bytes = 0, prev = 0;
+    int prev_free = FALSE, c;
+
+    if (s_base == NULL) return TRUE;
+    if (s_hdr->ul_top < HEAP_ALIGN || s_hdr->ul_top > s_mapped || s_hdr->ul_top % UNIT != 0) {
+        fprintf(stderr, "Bad heap top\n");
+        return FALSE;
+    }
+
+    /* 모든 블록을 주소 순서대로 순회 */
+    for (off = HEAP_ALIGN; off < s_hdr->ul_top; off += span_of(off) * UNIT) {
+        uint64_t word = at(off)->word, span = word >> F_BITS;
+        if (!(word & F_HEADER) || span < MIN_SPAN || span > (s_hdr->ul_top - off) / UNIT) {
+            fprintf(stderr, "Bad block header\n");
+            return FALSE;
+        }
+        if (at(footer_of(off, span))->word != (word & ~(uint64_t)F_HEADER)) {
+            fprintf(stderr, "Footer does not match header\n");
+            return FALSE;
+        }
+        if (!(word & F_ALLOC)) {
+            if (prev_free) {
+                fprintf(stderr, "Uncoalesced free blocks\n");
+                return FALSE;
+            }
+            n_free++;
+            free_bytes += span * UNIT;
+        }
+        prev_free = !(word & F_ALLOC);
+    }
+    if (n_free != s_hdr->ul_free_blocks || free_bytes != s_hdr->ul_bytes_free) {
+        fprintf(stderr, "Free block count mismatch\n");
+        return FALSE;
+    }
+
+    /* free list: 모두 자기 class의 free 블록이고 역방향 링크가 맞는지 */
+    for (c = 0; c < CLASSES; c++) {
+        if ((s_hdr->aul_free_heads[c] != 0) != (int)((s_hdr->ul_nonempty >> c) & 1)) {
+            fprintf(stderr, "Non-empty mask out of sync\n");
+            return FALSE;
+        }
+        for (prev = 0, off = s_hdr->aul_free_heads[c]; off != 0; prev = off, off = at(off)->link) {
+            if (off < HEAP_ALIGN || off >= s_hdr->ul_top || is_alloc(off)
+                || class_of(span_of(off)) != c
+                || at(footer_of(off, span_of(off)))->link != prev) {
+                fprintf(stderr, "Broken free list\n");
+                return FALSE;
+            }
+            if (n_free-- == 0) {
+                fprintf(stderr, "Free lists longer than free blocks\n");
+                return FALSE;
+            }
+        }
+    }
+    if (n_free != 0) {
+        fprintf(stderr, "Free block missing from the free list\n");
+        return FALSE;
+    }
+    return TRUE;
+}
+#endif
+
+/* map_to: 파일이 ui_bytes보다 작으면 늘리고, 아직 map하지 않은 부분을 예약 영역에
+ * 이어서 map */
+static int map_to(size_t ui_bytes) {
+    if (ui_bytes <= s_mapped) return 0;
+    if (ui_bytes > s_reserved) {
+        errno = ENOMEM;
+        return -1;
+    }
+    if (ui_bytes > s_hdr->ul_file_bytes) {
+        if (ftruncate(s_fd, (off_t)ui_bytes) != 0) return -1;
+        s_hdr->ul_file_bytes = ui_bytes;
+    }
+    if (mmap(s_base + s_mapped, ui_bytes - s_mapped, PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_FIXED, s_fd, (off_t)s_mapped) == MAP_FAILED)
+        return -1;
+    s_mapped = ui_bytes;
+    return 0;
+}
+
+/* catch_up: 다른 프로세스가 늘린 파일 끝까지 map */
+static int catch_up(void) {
+    return map_to(s_hdr->ul_file_bytes);
+}
+
+/* heap_grow: span need 이상의 free 블록이 생기도록 파일을 키우고 그 블록을 반환.
+ * 마지막 블록이 free면 모자란 만큼만 늘려서 합친다. 0이면 실패 */
+static uint64_t heap_grow(uint64_t need) {
+    uint64_t top = s_hdr->ul_top, bytes = need * UNIT;
+
+    if (top > HEAP_ALIGN && !is_alloc(top - UNIT))
+        bytes -= span_of(top - UNIT) * UNIT;
+    /* 작은 블록 수백만 개를 만들 때 확장 횟수가 로그로 늘도록 heap의 1/8씩 */
+    if (bytes < GROW_MIN_BYTES) bytes = GROW_MIN_BYTES;
+    if (bytes < top / 8) bytes = top / 8;
+    bytes = (bytes + HEAP_ALIGN - 1) / HEAP_ALIGN * HEAP_ALIGN;
+
+    if (bytes > s_reserved - top || map_to(top + bytes) != 0) return 0;
+    /* commit: 여기서 멈추면 복구 scan이 [top, top + bytes)를 free 꼬리로 만듦 */
+    s_hdr->ul_top = top + bytes;
+    set_header(top, bytes / UNIT, 0);
+    set_footer(top, bytes / UNIT, 0);
+    s_stats.ul_growths++;
+    return coalesce_push(top);
+}
+
+/* recover_free: 복구 scan에서 연속된 free 블록들 [start, end)를 한 블록으로 */
+static void recover_free(uint64_t start, uint64_t end) {
+    uint64_t span = (end - start) / UNIT;
+
+    if (span < MIN_SPAN) {
+        /* 손상된 꼬리가 태그를 쓸 수 없을 만큼 작으면 버림 */
+        s_hdr->ul_top = start;
+        return;
+    }
+    set_header(start, span, 0);
+    set_footer(start, span, 0);
+    list_push(start);
+}
+
+/* recover: header word만 믿고 블록을 순회해 footer, free list, 통계를 다시 만듦.
+ * 이어진 free 블록은 (병합 도중 멈춘 경우) 합친다. 손상된 header를 만나면
+ * 거기부터 top까지를 free로 돌림 (확장 도중 멈춘 경우의 0 태그도 여기로) */
+static void recover(void) {
+    uint64_t off = HEAP_ALIGN, top = s_hdr->ul_top, run = 0;   // run: free 구간의 시작
+
+    memset(s_hdr->aul_free_heads, 0, sizeof(s_hdr->aul_free_heads));
+    s_hdr->ul_nonempty = 0;
+    s_hdr->ul_free_blocks = 0;
+    s_hdr->ul_bytes_free = 0;
+    while (off < top) {
+        uint64_t word = at(off)->word, span = word >> F_BITS;
+        if (!(word & F_HEADER) || span < MIN_SPAN || span > (top - off) / UNIT) {
+            /* 0이면 heap 확장이 태그를 쓰기 전에 멈춘 것이라 정상 */
+            if (word != 0)
+                fprintf(stderr, "heapmgr_persist: damaged block at offset %llu, "
+                        "freeing the rest of the heap\n", (unsigned long long)off);
+            if (run == 0) run = off;
+            break;
+        }
+        if (word & F_ALLOC) {
+            if (run != 0) recover_free(run, off);
+            run = 0;
+            set_footer(off, span, F_ALLOC);
+        } else if (run == 0) {
+            run = off;
+        }
+        off += span * UNIT;
+    }
+    if (run != 0) recover_free(run, top);
+}
+
+static void detach(void) {
+    munmap(s_base, s_reserved);
+    close(s_fd);
+    s_base = NULL;
+    s_fd = -1;
+}
+
+/* heap_lock: mutex를 잡고 map을 따라잡음. mutex를 쥔 채 죽은 프로세스가 있으면
+ * 연산 도중이었을 수 있으므로 열 때처럼 다시 만든다. 복구하지 못하면 mutex를
+ * consistent로 돌려놓지 않아, 이후의 모든 lock이 실패함 */
+static int heap_lock(void) {
+    int rc = pthread_mutex_lock(&s_hdr->s_lock);
+
+    if (rc == EOWNERDEAD) {
+        if (catch_up() != 0) {
+            pthread_mutex_unlock(&s_hdr->s_lock);
+            return -1;
+        }
+        recover();
+        pthread_mutex_consistent(&s_hdr->s_lock);
+        rc = 0;
+    }
+    if (rc != 0) {
+        errno = rc;
+        return -1;
+    }
+    if (catch_up() != 0) {
+        pthread_mutex_unlock(&s_hdr->s_lock);
+        return -1;
+    }
+    return 0;
+}
+
+static void heap_unlock(void) {
+    pthread_mutex_unlock(&s_hdr->s_lock);
+}
+
+static int lock_init(void) {
+    pthread_mutexattr_t s_attr;
+    int rc;
+
+    pthread_mutexattr_init(&s_attr);
+    pthread_mutexattr_setpshared(&s_attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&s_attr, PTHREAD_MUTEX_ROBUST);
+    rc = pthread_mutex_init(&s_hdr->s_lock, &s_attr);
+    pthread_mutexattr_destroy(&s_attr);
+    return rc;
+}
+
+/* file_lock: 파일 첫 byte의 OFD lock. 같은 fd에서 종류를 바꾸는 것은 원자적 */
+static int file_lock(int fd, short type, int wait) {
+    struct flock s_fl;
+
+    memset(&s_fl, 0, sizeof(s_fl));
+    s_fl.l_type = type;
+    s_fl.l_whence = SEEK_SET;
+    s_fl.l_len = 1;
+    return fcntl(fd, wait ? F_OFD_SETLKW : F_OFD_SETLK, &s_fl);
+}
+
+/* attach: 열린 heap 파일 fd를 map. 빈 파일이면 새 heap을 만듦 */
+static int attach(int fd, size_t ui_max_bytes) {
+    struct stat s_st;
+    void *pv;
+    int result = HEAPMGR_PERSIST_CREATED, exclusive;
+
+    /* 배타 lock이 잡히면 이 파일을 연 프로세스는 우리뿐이다 */
+    exclusive = (file_lock(fd, F_WRLCK, FALSE) == 0);
+    if (!exclusive) {
+        if (file_lock(fd, F_RDLCK, TRUE) != 0) {
+            close(fd);
+            return -1;
+        }
+        exclusive = (file_lock(fd, F_WRLCK, FALSE) == 0);
+    }
+    if (fstat(fd, &s_st) != 0) {
+        close(fd);
+        return -1;
+    }
+    if (ui_max_bytes == 0) ui_max_bytes = DEFAULT_MAX_BYTES;
+    ui_max_bytes = (ui_max_bytes + HEAP_ALIGN - 1) / HEAP_ALIGN * HEAP_ALIGN;
+    if ((size_t)s_st.st_size > ui_max_bytes || s_st.st_size % HEAP_ALIGN != 0
+        || (s_st.st_size == 0 && !exclusive)) {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+    pv = mmap(NULL, ui_max_bytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (pv == MAP_FAILED) {
+        close(fd);
+        return -1;
+    }
+    s_base = pv;
+    s_hdr = (struct persist_header *)s_base;
+    s_reserved = ui_max_bytes;
+    s_fd = fd;
+    s_mapped = (s_st.st_size != 0) ? (size_t)s_st.st_size : HEAP_ALIGN;
+    memset(&s_stats, 0, sizeof(s_stats));
+
+    if ((s_st.st_size == 0 && ftruncate(fd, HEAP_ALIGN) != 0)
+        || mmap(s_base, s_mapped, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0)
+           == MAP_FAILED) {
+        detach();
+        return -1;
+    }
+    if (s_st.st_size == 0) {
+        memcpy(s_hdr->ac_magic, PERSIST_MAGIC, sizeof(s_hdr->ac_magic));
+        s_hdr->ui_version = PERSIST_VERSION;
+        s_hdr->ul_top = HEAP_ALIGN;
+    } else if (memcmp(s_hdr->ac_magic, PERSIST_MAGIC, sizeof(s_hdr->ac_magic)) != 0
+               || s_hdr->ui_version != PERSIST_VERSION) {
+        detach();
+        errno = EINVAL;
+        return -1;
+    }
+    /* 처음 여는 프로세스만 mutex를 새로 만듦 (이전 부팅에서 남은 상태일 수 있음) */
+    if (exclusive) {
+        s_hdr->ul_file_bytes = s_mapped;
+        if (lock_init() != 0) {
+            detach();
+            errno = EINVAL;
+            return -1;
+        }
+    }
+    if (heap_lock() != 0) {
+        detach();
+        return -1;
+    }
+    if (s_st.st_size != 0) {
+        if (s_hdr->ul_top < HEAP_ALIGN || s_hdr->ul_top > s_mapped || s_hdr->ul_top % UNIT != 0) {
+            heap_unlock();
+            detach();
+            errno = EINVAL;
+            return -1;
+        }
+        /* 다른 프로세스가 열고 있는 heap은 살아 있는 것이고, 그 프로세스들의 crash는
+         * heap_lock이 처리함 */
+        if (!exclusive || s_hdr->ui_clean) {
+            result = HEAPMGR_PERSIST_REOPENED;
+        } else {
+            recover();
+            result = HEAPMGR_PERSIST_RECOVERED;
+        }
+    }
+    s_hdr->ui_clean = 0;
+    s_hdr->ul_opens++;
+    assert(check_heap_validity());
+    heap_unlock();
+    if (exclusive) file_lock(fd, F_RDLCK, FALSE);
+    return result;
+}
+
+static void close_at_exit(void) {
+    heapmgr_persist_close();
+}
+
+/* open_default: heapmgr_persist_open() 없이 heapmgr_malloc()이 불린 경우 */
+static int open_default(void) {
+    const char *pc_path = getenv("HEAPMGR_PERSIST_FILE");
+    char ac_tmp[] = "/tmp/heapmgrpersist.XXXXXX";
+    int fd;
+
+    if (pc_path != NULL) {
+        if (heapmgr_persist_open(pc_path, 0) < 0) return -1;
+        atexit(close_at_exit);
+        return 0;
+    }
+    /* 이름 없는 임시 파일: 보통 heap처럼 쓰임 */
+    fd = mkstemp(ac_tmp);
+    if (fd < 0) return -1;
+    unlink(ac_tmp);
+    return attach(fd, 0) < 0 ? -1 : 0;
+}
+
+int heapmgr_persist_open(const char *pc_path, size_t ui_max_bytes) {
+    int fd;
+
+    if (s_base != NULL) {
+        errno = EBUSY;
+        return -1;
+    }
+    fd = open(pc_path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) return -1;
+    return attach(fd, ui_max_bytes);
+}
+
+int heapmgr_persist_open_shm(const char *pc_name, size_t ui_max_bytes) {
+    int fd;
+
+    if (s_base != NULL) {
+        errno = EBUSY;
+        return -1;
+    }
+    fd = shm_open(pc_name, O_RDWR | O_CREAT, 0600);
+    if (fd < 0) return -1;
+    return attach(fd, ui_max_bytes);
+}
+
+int heapmgr_persist_sync(void) {
+    if (s_base == NULL) return 0;
+    return msync(s_base, s_mapped, MS_SYNC);
+}
+
+int heapmgr_persist_close(void) {
+    int status = 0;
+
+    if (s_base == NULL) return 0;
+    /* 마지막으로 닫는 프로세스만 블록을 내려 쓴 뒤에 clean 표시 */
+    if (file_lock(s_fd, F_WRLCK, FALSE) == 0) {
+        status = catch_up();
+        assert(status != 0 || check_heap_validity());
+        if (status == 0) status = heapmgr_persist_sync();
+        if (status == 0) {
+            s_hdr->ui_clean = 1;
+            status = msync(s_base, HEAP_ALIGN, MS_SYNC);
+        }
+    }
+    detach();
+    return status;
+}
+
+void *heapmgr_persist_get_root(void) {
+    if (s_base == NULL) return NULL;
+    return heapmgr_persist_pointer(s_hdr->ul_root);
+}
+
+void heapmgr_persist_set_root(void *pv_root) {
+    assert(s_base != NULL);
+    s_hdr->ul_root = heapmgr_persist_offset(pv_root);
+}
+
+size_t heapmgr_persist_offset(const void *pv) {
+    if (pv == NULL) return 0;
+    assert(s_base != NULL && (const char *)pv > s_base && (const char *)pv < s_base + s_mapped);
+    return (size_t)((const char *)pv - s_base);
+}
+
+void *heapmgr_persist_pointer(size_t ui_offset) {
+    if (ui_offset == 0) return NULL;
+    assert(s_base != NULL);
+    /* 다른 프로세스가 늘린 부분에 있는 블록일 수 있음 */
+    if (ui_offset >= s_mapped) {
+        if (heap_lock() != 0) return NULL;
+        heap_unlock();
+        if (ui_offset >= s_mapped) return NULL;
+    }
+    return s_base + ui_offset;
+}
+
+void *heapmgr_malloc(size_t ui_bytes)
+{
+    uint64_t need, off = 0, span, above;
+    unsigned long visited = 0;
+    int c;
+
+    if (ui_bytes == 0) return NULL;
+    if (s_base == NULL && open_default() != 0) return NULL;
+    if (ui_bytes > s_reserved) return NULL;
+    if (heap_lock() != 0) return NULL;
+    assert(check_heap_validity());
+
+    need = (ui_bytes + UNIT - 1) / UNIT + 2;
+
+    /* need의 class 안에서는 first-fit, 없으면 그보다 큰 class의 아무 블록 */
+    c = class_of(need);
+    if ((s_hdr->ul_nonempty >> c) & 1) {
+        for (off = s_hdr->aul_free_heads[c]; off != 0; off = at(off)->link) {
+            if (span_of(off) >= need) break;
+            visited++;
+        }
+    }
+    above = (c + 1 < CLASSES) ? s_hdr->ul_nonempty >> (c + 1) : 0;
+    if (off == 0 && above != 0)
+        off = s_hdr->aul_free_heads[c + 1 + __builtin_ctzll(above)];
+    s_stats.aul_search_hist[heapmgr_search_bucket(visited)]++;
+    if (off == 0 && (off = heap_grow(need)) == 0) {
+        heap_unlock();
+        return NULL;
+    }
+
+    list_remove(off);
+    span = span_of(off);
+    if (span - need >= MIN_SPAN) {
+        /* 뒤쪽을 떼어냄. 새 블록 태그 -> 남는 블록 header(commit) -> footer 순서 */
+        uint64_t a = off + (span - need) * UNIT;
+        set_footer(a, need, F_ALLOC);
+        set_header(a, need, F_ALLOC);
+        set_header(off, span - need, 0);
+        set_footer(off, span - need, 0);
+        list_push(off);
+        s_stats.ul_splits++;
+        off = a;
+    } else {
+        set_header(off, span, F_ALLOC);
+        set_footer(off, span, F_ALLOC);
+    }
+    s_stats.ul_mallocs++;
+
+    assert(check_heap_validity());
+    heap_unlock();
+    return s_base + off + UNIT;
+}
+
+
+void heapmgr_free(void *pv_bytes)
+{
+    uint64_t off, span;
+
+    if (pv_bytes == NULL) return;
+    assert(s_base != NULL);
+    if (heap_lock() != 0) return;
+    assert(check_heap_validity());
+
+    off = (uint64_t)((char *)pv_bytes - s_base) - UNIT;
+    assert(off >= HEAP_ALIGN && off < s_hdr->ul_top);
+    assert(is_alloc(off));
+
+    span = span_of(off);
+    set_header(off, span, 0);   // commit
+    set_footer(off, span, 0);
+    coalesce_push(off);
+    s_stats.ul_frees++;
+
+    assert(check_heap_validity());
+    heap_unlock();
+}
+
+void heapmgr_stats(struct heapmgr_stats *ps_stats)
+{
+    assert(ps_stats != NULL);
+
+    *ps_stats = s_stats;
+    if (s_base == NULL || heap_lock() != 0) return;
+    ps_stats->ui_heap_bytes = s_hdr->ul_top - HEAP_ALIGN;
+    ps_stats->ui_bytes_free = s_hdr->ul_bytes_free;
+    ps_stats->ui_free_blocks = s_hdr->ul_free_blocks;
+    ps_stats->ui_bytes_in_use = ps_stats->ui_heap_bytes - s_hdr->ul_bytes_free;
+    if (s_hdr->ul_nonempty != 0) {
+        /* 가장 큰 free 블록은 가장 높은 class 안에 있음 */
+        uint64_t off, largest = 0;
+        int c = 63 - __builtin_clzll(s_hdr->ul_nonempty);
+        for (off = s_hdr->aul_free_heads[c]; off != 0; off = at(off)->link)
+            if (span_of(off) * UNIT > largest) largest = span_of(off) * UNIT;
+        ps_stats->ui_largest_free = largest;
+    }
+    heap_unlock();
+}
@@ -0,0 +1,65 @@
+/*--------------------------------------------------------------------*/
+/* heapmgrpersist.h                                                   */
+/* heapmgr.h 인터페이스 외에 heapmgrpersist.c가 추가로 제공하는 함수들    */
+/*--------------------------------------------------------------------*/
+
+#ifndef HEAPMGRPERSIST_INCLUDED
+#define HEAPMGRPERSIST_INCLUDED
+
+#include <stddef.h>
+
+/* What heapmgr_persist_open() found. */
+enum {
+   HEAPMGR_PERSIST_CREATED = 0,   /* empty file, new heap */
+   HEAPMGR_PERSIST_REOPENED = 1,  /* heap closed cleanly, or open in
+                                     another process; used as is */
+   HEAPMGR_PERSIST_RECOVERED = 2  /* heap not closed, rebuilt by a scan */
+};
+
+int heapmgr_persist_open(const char *pc_path, size_t ui_max_bytes);
+/* Map the heap file pc_path, creating it if it does not exist, so
+   that later heapmgr_malloc() and heapmgr_free() calls work in it.
+   ui_max_bytes bounds the file and is reserved as address space up
+   front (0 means 1 TiB), so blocks never move while the heap is
+   open.  The file may be mapped at a different address each time;
+   store references inside the heap as offsets.  Return one of the
+   HEAPMGR_PERSIST_* values, or -1 with errno set (EBUSY if a heap is
+   already open, EINVAL if the file is not a heap).  Without a call,
+   the first heapmgr_malloc() opens the file named by the
+   HEAPMGR_PERSIST_FILE environment variable (closed at exit), or an
+   unnamed temporary file if that is unset.
+
+   Several processes may open the same file at once.  Every call
+   takes a process-shared lock in the file header, so a block
+   allocated in one process may be freed in another, after passing
+   its offset.  If a process dies inside a call, the next call in any
+   process rebuilds the heap with the recovery scan.  Only the last
+   process to close the heap marks it clean. */
+
+int heapmgr_persist_open_shm(const char *pc_name, size_t ui_max_bytes);
+/* Like heapmgr_persist_open(), for the POSIX shared memory object
+   pc_name (shm_open()), created if it does not exist.  The object
+   outlives the processes until shm_unlink(). */
+
+int heapmgr_persist_sync(void);
+/* Write the whole heap to the file with msync().  Until then a
+   process crash loses nothing, but a system crash may.  Return 0, or
+   -1 with errno set. */
+
+int heapmgr_persist_close(void);
+/* Unmap the heap; the last process to close it first syncs it and
+   marks it clean.  Pointers into the heap become invalid.  Return 0,
+   or -1 with errno set. */
+
+void *heapmgr_persist_get_root(void);
+void heapmgr_persist_set_root(void *pv_root);
+/* The root block, stored in the file header: the one object a
+   reopened process can find without any other state.  NULL if none
+   was set. */
+
+size_t heapmgr_persist_offset(const void *pv);
+void *heapmgr_persist_pointer(size_t ui_offset);
+/* Convert between a pointer into the open heap and its offset from
+   the start of the file.  NULL and offset 0 map to each other. */
+
+#endif
@@ -0,0 +1,165 @@
+/*--------------------------------------------------------------------*/
+/* heapmgrpmr.hpp                                                     */
+/* heapmgr 엔진을 C++ std::pmr::memory_resource와 STL allocator로 감싼 것 */
+/*--------------------------------------------------------------------*/
+
+/* Header only; needs C++17.  Works with any engine linked into the
+   program, since it only calls the heapmgr.h interface.  Like the
+   engines themselves, none of this is thread-safe unless the engine
+   defines heapmgr_thread_safe (see heapmgr.h).
+
+   The engines need not be the only allocator in the process, but the
+   sbrk()-based ones (kr, base, heapmgr1, bitmap, buddy) assume they
+   are the only users of the program break, so memory from glibc
+   malloc() or operator new must not grow it while they are in use. */
+
+#ifndef HEAPMGRPMR_INCLUDED
+#define HEAPMGRPMR_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory_resource>
+#include <new>
+
+extern "C" {
+#include "heapmgr.h"
+}
+
+/* Alignment of every block heapmgr_malloc() returns, in all engines
+   (one 16-byte chunk unit).  Larger alignments are served by
+   over-allocating. */
+inline constexpr std::size_t heapmgr_alignment = 16;
+
+inline void *heapmgr_allocate_bytes(std::size_t ui_bytes, std::size_t ui_align)
+/* Return ui_bytes bytes aligned to ui_align (a power of 2) from
+   heapmgr_malloc(), or throw std::bad_alloc.  A block with a larger
+   alignment than heapmgr_alignment keeps the pointer heapmgr_malloc()
+   returned in the word just before it. */
+{
+   void *pv;
+
+   if (ui_bytes == 0)
+      ui_bytes = 1;
+   if (ui_align <= heapmgr_alignment)
+   {
+      if ((pv = heapmgr_malloc(ui_bytes)) == nullptr)
+         throw std::bad_alloc();
+      return pv;
+   }
+   if (ui_bytes > std::numeric_limits<std::size_t>::max() - ui_align
+       || (pv = heapmgr_malloc(ui_bytes + ui_align)) == nullptr)
+      throw std::bad_alloc();
+   std::uintptr_t ui_p = ((std::uintptr_t)pv + ui_align) & ~(std::uintptr_t)(ui_align - 1);
+   ((void **)ui_p)[-1] = pv;
+   return (void *)ui_p;
+}
+
+inline void heapmgr_deallocate_bytes(void *pv, std::size_t ui_align) noexcept
+/* Free a block from heapmgr_allocate_bytes() with the same ui_align. */
+{
+   if (pv != nullptr && ui_align > heapmgr_alignment)
+      pv = ((void **)pv)[-1];
+   heapmgr_free(pv);
+}
+
+/*--------------------------------------------------------------------*/
+
+class heapmgr_memory_resource final : public std::pmr::memory_resource
+/* The engine's heap as a polymorphic memory resource.  It has no
+   state, so all instances compare equal; use heapmgr_resource(). */
+{
+   void *do_allocate(std::size_t ui_bytes, std::size_t ui_align) override
+   {
+      return heapmgr_allocate_bytes(ui_bytes, ui_align);
+   }
+
+   void do_deallocate(void *pv, std::size_t, std::size_t ui_align) override
+   {
+      heapmgr_deallocate_bytes(pv, ui_align);
+   }
+
+   bool do_is_equal(const std::pmr::memory_resource &r_other) const noexcept override
+   {
+      return dynamic_cast<const heapmgr_memory_resource *>(&r_other) != nullptr;
+   }
+};
+
+inline std::pmr::memory_resource *heapmgr_resource() noexcept
+/* The one heapmgr_memory_resource, like std::pmr::new_delete_resource().
+   Pass it to std::pmr containers, or make it the default with
+   std::pmr::set_default_resource(). */
+{
+   static heapmgr_memory_resource s_resource;
+   return &s_resource;
+}
+
+class heapmgr_region : public std::pmr::monotonic_buffer_resource
+/* A region (arena) that takes growing buffers from the engine and
+   hands out memory by bumping a pointer.  Deallocation does nothing;
+   everything goes back to the engine at once when the region is
+   released or destroyed. */
+{
+public:
+   heapmgr_region() : monotonic_buffer_resource(heapmgr_resource()) {}
+
+   explicit heapmgr_region(std::size_t ui_initial_bytes)
+      : monotonic_buffer_resource(ui_initial_bytes, heapmgr_resource()) {}
+};
+
+class heapmgr_pool : public std::pmr::unsynchronized_pool_resource
+/* Pools of fixed-size blocks, one per size class, carved from chunks
+   taken from the engine.  Requests above the largest pooled size go
+   to the engine directly.  For a thread-safe engine,
+   std::pmr::synchronized_pool_resource can be given
+   heapmgr_resource() the same way. */
+{
+public:
+   heapmgr_pool() : unsynchronized_pool_resource(heapmgr_resource()) {}
+
+   explicit heapmgr_pool(const std::pmr::pool_options &r_options)
+      : unsynchronized_pool_resource(r_options, heapmgr_resource()) {}
+};
+
+/*--------------------------------------------------------------------*/
+
+template <class T>
+struct heapmgr_allocator
+/* A stateless STL allocator on the engine, for containers that take
+   an allocator type rather than a memory resource, e.g.
+   std::vector<int, heapmgr_allocator<int>> or
+   std::map<K, V, std::less<K>, heapmgr_allocator<std::pair<const K, V>>>. */
+{
+   using value_type = T;
+
+   heapmgr_allocator() noexcept = default;
+
+   template <class U>
+   heapmgr_allocator(const heapmgr_allocator<U> &) noexcept {}
+
+   T *allocate(std::size_t ui_n)
+   {
+      if (ui_n > std::numeric_limits<std::size_t>::max() / sizeof(T))
+         throw std::bad_array_new_length();
+      return static_cast<T *>(heapmgr_allocate_bytes(ui_n * sizeof(T), alignof(T)));
+   }
+
+   void deallocate(T *p, std::size_t) noexcept
+   {
+      heapmgr_deallocate_bytes(p, alignof(T));
+   }
+};
+
+template <class T, class U>
+bool operator==(const heapmgr_allocator<T> &, const heapmgr_allocator<U> &) noexcept
+{
+   return true;
+}
+
+template <class T, class U>
+bool operator!=(const heapmgr_allocator<T> &, const heapmgr_allocator<U> &) noexcept
+{
+   return false;
+}
+
+#endif
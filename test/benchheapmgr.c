@@ -0,0 +1,398 @@
+/*--------------------------------------------------------------------*/
+/* benchheapmgr.c                                                     */
+/* Repeated, process-level measurement of testheapmgr builds          */
+/*--------------------------------------------------------------------*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/ioctl.h>
+#include <linux/perf_event.h>
+#include "latency.h"
+
+enum {FALSE, TRUE};
+
+#define USAGE "Usage: %s [-w warmup] [-n repeats] [-f csv|json] " \
+   "[-t test,test,...] [-x option]... count size executable...\n"
+
+/* The seven classic testheapmgr scenarios, run when -t is not given. */
+static const char *apc_default_tests[] =
+{
+   "LIFO_fixed", "FIFO_fixed", "LIFO_random", "FIFO_random",
+   "random_fixed", "random_random", "worst"
+};
+
+/* The adversarial testheapmgr scenarios, run for -t adversarial. */
+static const char *apc_adversarial_tests[] =
+{
+   "worst", "binstraddle", "tinyhuge", "sawtooth", "pinning"
+};
+
+enum {MAX_TESTS = 64, MAX_EXTRA_ARGS = 32, MAX_REPEATS = 1000};
+
+/*--------------------------------------------------------------------*/
+
+/* Metrics collected for every run.  The first METRIC_FIRST_PERF come
+   from the clock and wait4(); the rest from perf_event_open(), and
+   are missing when the kernel does not allow counting. */
+enum metric {
+   METRIC_WALL, METRIC_USER, METRIC_SYS, METRIC_MAXRSS, METRIC_MINFLT,
+   METRIC_INSTRUCTIONS, METRIC_CYCLES, METRIC_L1D_MISSES,
+   METRIC_LLC_MISSES, METRIC_DTLB_MISSES,
+   METRIC_COUNT
+};
+enum {METRIC_FIRST_PERF = METRIC_INSTRUCTIONS};
+
+static const char *apc_metric_name[METRIC_COUNT] =
+{
+   "wall_s", "user_s", "sys_s", "maxrss_kb", "minor_faults",
+   "instructions", "cycles", "l1d_read_misses", "llc_read_misses",
+   "dtlb_read_misses"
+};
+
+/* perf_event_attr type and config of each counter metric. */
+static const struct {
+   unsigned int ui_type;
+   unsigned long long ull_config;
+} as_perf_events[METRIC_COUNT - METRIC_FIRST_PERF] =
+{
+   {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+   {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+   {PERF_TYPE_HW_CACHE, CACHE_MISS(PERF_COUNT_HW_CACHE_L1D)},
+   {PERF_TYPE_HW_CACHE, CACHE_MISS(PERF_COUNT_HW_CACHE_LL)},
+   {PERF_TYPE_HW_CACHE, CACHE_MISS(PERF_COUNT_HW_CACHE_DTLB)}
+};
+
+/* One run: a value per metric, and which of them are valid. */
+struct sample {
+   double ad_value[METRIC_COUNT];
+   int ai_valid[METRIC_COUNT];
+};
+
+/*--------------------------------------------------------------------*/
+
+static double now_seconds(void)
+{
+   struct timespec s_now;
+   clock_gettime(CLOCK_MONOTONIC, &s_now);
+   return (double)s_now.tv_sec + (double)s_now.tv_nsec / 1e9;
+}
+
+/*--------------------------------------------------------------------*/
+
+static int read_counter(int i_fd, double *pd_value)
+
+/* Read counter i_fd into *pd_value, scaled up if the kernel had to
+   multiplex it.  Return TRUE on success. */
+
+{
+   unsigned long long aull[3];   /* value, time enabled, time running */
+
+   if (read(i_fd, aull, sizeof(aull)) != (ssize_t)sizeof(aull)
+       || aull[2] == 0)
+      return FALSE;
+   *pd_value = (double)aull[0] * ((double)aull[1] / (double)aull[2]);
+   return TRUE;
+}
+
+/*--------------------------------------------------------------------*/
+
+static int run_once(char *apc_argv[], struct sample *ps_sample)
+
+/* Run apc_argv[0] with arguments apc_argv, its stdout discarded, and
+   fill *ps_sample.  The child waits on a pipe until the counters are
+   attached, so they count from exec to exit.  Return TRUE if the
+   child exited with status 0. */
+
+{
+   int ai_go[2];
+   int ai_fd[METRIC_COUNT];
+   struct rusage s_usage;
+   int i_status, i;
+   double d_start;
+   pid_t pid;
+   char c = 0;
+
+   if (pipe(ai_go) != 0)
+   {
+      perror("pipe");
+      exit(EXIT_FAILURE);
+   }
+   pid = fork();
+   if (pid < 0)
+   {
+      perror("fork");
+      exit(EXIT_FAILURE);
+   }
+   if (pid == 0)
+   {
+      int i_null = open("/dev/null", O_WRONLY);
+      close(ai_go[1]);
+      if (read(ai_go[0], &c, 1) != 1)
+         _exit(127);
+      close(ai_go[0]);
+      if (i_null >= 0)
+         dup2(i_null, STDOUT_FILENO);
+      execv(apc_argv[0], apc_argv);
+      perror(apc_argv[0]);
+      _exit(127);
+   }
+
+   close(ai_go[0]);
+   for (i = METRIC_FIRST_PERF; i < METRIC_COUNT; i++)
+      ai_fd[i] = perf_counter_open(
+         as_perf_events[i - METRIC_FIRST_PERF].ui_type,
+         as_perf_events[i - METRIC_FIRST_PERF].ull_config, pid, TRUE);
+
+   d_start = now_seconds();
+   if (write(ai_go[1], &c, 1) != 1)
+      perror("write");
+   close(ai_go[1]);
+   if (wait4(pid, &i_status, 0, &s_usage) != pid)
+   {
+      perror("wait4");
+      exit(EXIT_FAILURE);
+   }
+
+   ps_sample->ad_value[METRIC_WALL] = now_seconds() - d_start;
+   ps_sample->ad_value[METRIC_USER] = (double)s_usage.ru_utime.tv_sec
+      + (double)s_usage.ru_utime.tv_usec / 1e6;
+   ps_sample->ad_value[METRIC_SYS] = (double)s_usage.ru_stime.tv_sec
+      + (double)s_usage.ru_stime.tv_usec / 1e6;
+   ps_sample->ad_value[METRIC_MAXRSS] = (double)s_usage.ru_maxrss;
+   ps_sample->ad_value[METRIC_MINFLT] = (double)s_usage.ru_minflt;
+   for (i = 0; i < METRIC_FIRST_PERF; i++)
+      ps_sample->ai_valid[i] = TRUE;
+   for (i = METRIC_FIRST_PERF; i < METRIC_COUNT; i++)
+   {
+      ps_sample->ai_valid[i] = ai_fd[i] >= 0
+         && read_counter(ai_fd[i], &ps_sample->ad_value[i]);
+      if (ai_fd[i] >= 0)
+         close(ai_fd[i]);
+   }
+
+   return WIFEXITED(i_status) && WEXITSTATUS(i_status) == 0;
+}
+
+/*--------------------------------------------------------------------*/
+
+struct summary {
+   int i_n;
+   double d_mean, d_stddev, d_ci95, d_min, d_max;
+};
+
+static void summarize(const struct sample *ps_samples, int i_runs,
+   int i_metric, struct summary *ps_sum)
+
+/* Mean, sample standard deviation, 95% confidence half-width of the
+   mean, minimum and maximum of metric i_metric over the valid runs
+   in ps_samples. */
+
+{
+   double d_sum = 0.0, d_sq = 0.0;
+   int i;
+
+   memset(ps_sum, 0, sizeof(*ps_sum));
+   for (i = 0; i < i_runs; i++)
+   {
+      double d;
+      if (!ps_samples[i].ai_valid[i_metric])
+         continue;
+      d = ps_samples[i].ad_value[i_metric];
+      if (ps_sum->i_n == 0 || d < ps_sum->d_min)
+         ps_sum->d_min = d;
+      if (ps_sum->i_n == 0 || d > ps_sum->d_max)
+         ps_sum->d_max = d;
+      d_sum += d;
+      ps_sum->i_n++;
+   }
+   if (ps_sum->i_n == 0)
+      return;
+   ps_sum->d_mean = d_sum / ps_sum->i_n;
+   for (i = 0; i < i_runs; i++)
+      if (ps_samples[i].ai_valid[i_metric])
+      {
+         double d = ps_samples[i].ad_value[i_metric] - ps_sum->d_mean;
+         d_sq += d * d;
+      }
+   if (ps_sum->i_n > 1)
+   {
+      ps_sum->d_stddev = sqrt(d_sq / (ps_sum->i_n - 1));
+      ps_sum->d_ci95 = t_critical_95(ps_sum->i_n - 1)
+         * ps_sum->d_stddev / sqrt((double)ps_sum->i_n);
+   }
+}
+
+/*--------------------------------------------------------------------*/
+
+static int i_json_first = TRUE;
+
+static void print_summary(int i_json, const char *pc_exe,
+   const char *pc_test, const char *pc_count, const char *pc_size,
+   int i_metric, const struct summary *ps_sum)
+
+/* Write one result record: a CSV row, or a JSON array element. */
+
+{
+   if (!i_json)
+   {
+      printf("%s,%s,%s,%s,%s,%d,%.9g,%.9g,%.9g,%.9g,%.9g\n", pc_exe,
+         pc_test, pc_count, pc_size, apc_metric_name[i_metric],
+         ps_sum->i_n, ps_sum->d_mean, ps_sum->d_stddev, ps_sum->d_ci95,
+         ps_sum->d_min, ps_sum->d_max);
+      return;
+   }
+   printf("%s  {\"executable\": \"%s\", \"test\": \"%s\", \"count\": %s, "
+      "\"size\": %s, \"metric\": \"%s\", \"n\": %d, \"mean\": %.9g, "
+      "\"stddev\": %.9g, \"ci95\": %.9g, \"min\": %.9g, \"max\": %.9g}",
+      i_json_first ? "" : ",\n", pc_exe, pc_test, pc_count, pc_size,
+      apc_metric_name[i_metric], ps_sum->i_n, ps_sum->d_mean,
+      ps_sum->d_stddev, ps_sum->d_ci95, ps_sum->d_min, ps_sum->d_max);
+   i_json_first = FALSE;
+}
+
+/*--------------------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+
+/* Run every testheapmgr executable named on the command line, for
+   every test (the seven classic scenarios unless -t lists others;
+   "adversarial" in the list stands for worst and the four
+   adversarial scenarios), with the given count and size plus any
+   -x options.  Each combination is run -w times (default 1) to warm
+   caches and the page cache, then -n times (default 5) for
+   measurement, each time in a fresh process.  For every metric write the number of valid
+   runs, mean, standard deviation, 95% confidence half-width of the
+   mean, minimum and maximum, as CSV (default) or JSON.  Counter
+   metrics missing because perf_event_open() is not permitted are
+   reported with n = 0.  Failed runs are reported on stderr and left
+   out. */
+
+{
+   int i_warmup = 1, i_repeats = 5, i_json = FALSE;
+   const char *apc_tests[MAX_TESTS];
+   int i_test_count = 0;
+   char *apc_extra[MAX_EXTRA_ARGS];
+   int i_extra_count = 0;
+   char *pc_count, *pc_size;
+   struct sample *ps_samples;
+   int i_opt, i_exe, i_test, i;
+
+   while ((i_opt = getopt(argc, argv, "w:n:f:t:x:")) != -1)
+   {
+      switch (i_opt)
+      {
+      case 'w':
+         i_warmup = atoi(optarg);
+         break;
+      case 'n':
+         i_repeats = atoi(optarg);
+         break;
+      case 'f':
+         if (strcmp(optarg, "json") == 0)
+            i_json = TRUE;
+         else if (strcmp(optarg, "csv") != 0)
+         {
+            fprintf(stderr, USAGE, argv[0]);
+            return EXIT_FAILURE;
+         }
+         break;
+      case 't':
+         for (optarg = strtok(optarg, ","); optarg != NULL
+              && i_test_count < MAX_TESTS; optarg = strtok(NULL, ","))
+            if (strcmp(optarg, "adversarial") == 0)
+               for (i = 0; i < (int)(sizeof(apc_adversarial_tests)
+                       / sizeof(apc_adversarial_tests[0]))
+                    && i_test_count < MAX_TESTS; i++)
+                  apc_tests[i_test_count++] = apc_adversarial_tests[i];
+            else
+               apc_tests[i_test_count++] = optarg;
+         break;
+      case 'x':
+         if (i_extra_count == MAX_EXTRA_ARGS)
+         {
+            fprintf(stderr, "Too many -x options\n");
+            return EXIT_FAILURE;
+         }
+         apc_extra[i_extra_count++] = optarg;
+         break;
+      default:
+         fprintf(stderr, USAGE, argv[0]);
+         return EXIT_FAILURE;
+      }
+   }
+   if (argc - optind < 3 || i_warmup < 0 || i_repeats < 1
+       || i_repeats > MAX_REPEATS)
+   {
+      fprintf(stderr, USAGE, argv[0]);
+      fprintf(stderr, "repeats must be 1..%d\n", MAX_REPEATS);
+      return EXIT_FAILURE;
+   }
+   pc_count = argv[optind];
+   pc_size = argv[optind + 1];
+   if (i_test_count == 0)
+      for (i = 0; i < (int)(sizeof(apc_default_tests) / sizeof(apc_default_tests[0])); i++)
+         apc_tests[i_test_count++] = apc_default_tests[i];
+
+   ps_samples = calloc((size_t)i_repeats, sizeof(struct sample));
+   if (ps_samples == NULL)
+   {
+      perror("calloc");
+      return EXIT_FAILURE;
+   }
+
+   if (i_json)
+      printf("[\n");
+   else
+      printf("executable,test,count,size,metric,n,mean,stddev,ci95,min,max\n");
+
+   for (i_exe = optind + 2; i_exe < argc; i_exe++)
+      for (i_test = 0; i_test < i_test_count; i_test++)
+      {
+         char *apc_argv[4 + MAX_EXTRA_ARGS + 1];
+         struct sample s_discard;
+         struct summary s_sum;
+         int i_runs = 0, i_metric;
+
+         apc_argv[0] = argv[i_exe];
+         apc_argv[1] = (char *)apc_tests[i_test];
+         apc_argv[2] = pc_count;
+         apc_argv[3] = pc_size;
+         for (i = 0; i < i_extra_count; i++)
+            apc_argv[4 + i] = apc_extra[i];
+         apc_argv[4 + i_extra_count] = NULL;
+
+         for (i = 0; i < i_warmup; i++)
+            run_once(apc_argv, &s_discard);
+         for (i = 0; i < i_repeats; i++)
+         {
+            if (run_once(apc_argv, &ps_samples[i_runs]))
+               i_runs++;
+            else
+               fprintf(stderr, "%s %s %s %s: run %d failed\n", argv[i_exe],
+                  apc_tests[i_test], pc_count, pc_size, i + 1);
+         }
+
+         for (i_metric = 0; i_metric < METRIC_COUNT; i_metric++)
+         {
+            summarize(ps_samples, i_runs, i_metric, &s_sum);
+            print_summary(i_json, argv[i_exe], apc_tests[i_test], pc_count,
+               pc_size, i_metric, &s_sum);
+         }
+         fflush(stdout);
+      }
+
+   if (i_json)
+      printf("\n]\n");
+   free(ps_samples);
+   return 0;
+}
@@ -0,0 +1,409 @@
+/*--------------------------------------------------------------------*/
+/* cmpheapmgr.c                                                       */
+/* Runs one pre-generated operation stream against several engines    */
+/*--------------------------------------------------------------------*/
+
+#define _GNU_SOURCE
+#include "engine.h"
+#include "workload.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <dlfcn.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+enum {FALSE, TRUE};
+
+#define USAGE "Usage: %s [-n repeats] [-L exp|phase] [-r seed] " \
+   "workload count size engine.so...\n" \
+   "       %s [-n repeats] -T tracefile engine.so...\n"
+
+enum {MAX_ENGINES = 16, MAX_REPEATS = 1000};
+
+/*--------------------------------------------------------------------*/
+
+/* One operation of the stream.  ul_word is (slot << 1) | OP_FREE for
+   a free of the block in that slot, or slot << 1 for a malloc of
+   ui_size bytes into it. */
+enum {OP_FREE = 1};
+
+struct op {
+   unsigned long ul_word;
+   size_t ui_size;
+};
+
+/* The operation stream, shared read-only with every child. */
+static struct op *ps_ops;
+static size_t ui_op_count, ui_op_cap;
+static unsigned long ul_slot_count;
+
+/* What a child reports back through its pipe. */
+struct result {
+   char ac_name[32];              /* heapmgr_engine.pc_name */
+   int i_ok;
+   double d_seconds;
+   size_t ui_heap_bytes;
+   long l_maxrss_kb;
+   long l_minflt;
+};
+
+/*--------------------------------------------------------------------*/
+
+static void add_op(unsigned long ul_slot, int i_free, size_t ui_size)
+
+/* Append one operation to the stream, growing it with mremap(). */
+
+{
+   if (ui_op_count == ui_op_cap)
+   {
+      size_t ui_new_cap = (ui_op_cap == 0) ? (1 << 20) : ui_op_cap * 2;
+      void *pv = (ui_op_cap == 0)
+         ? mmap(NULL, ui_new_cap * sizeof(struct op), PROT_READ | PROT_WRITE,
+              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)
+         : mremap(ps_ops, ui_op_cap * sizeof(struct op),
+              ui_new_cap * sizeof(struct op), MREMAP_MAYMOVE);
+      if (pv == MAP_FAILED)
+      {
+         perror("mmap");
+         exit(EXIT_FAILURE);
+      }
+      ps_ops = pv;
+      ui_op_cap = ui_new_cap;
+   }
+   ps_ops[ui_op_count].ul_word = (ul_slot << 1) | (i_free ? OP_FREE : 0);
+   ps_ops[ui_op_count].ui_size = ui_size;
+   ui_op_count++;
+   if (ul_slot + 1 > ul_slot_count)
+      ul_slot_count = ul_slot + 1;
+}
+
+/*--------------------------------------------------------------------*/
+
+static void generate_stream(enum size_dist e_size, enum life_dist e_life,
+   unsigned long long ull_seed, long l_count, size_t ui_size)
+
+/* Build the stream of testheapmgr's generated tests: l_count mallocs
+   with sizes and lifetimes from workload.h, each followed by the
+   frees of objects whose lifetime has run out, then the frees of the
+   rest.  Freed slots are reused, so the slot table stays at the peak
+   live count. */
+
+{
+   static struct size_gen s_size_gen;
+   static struct life_gen s_life_gen;
+   struct prng s_rng;
+   struct death_heap s_deaths;
+   long *pl_death, *pl_deaths;
+   unsigned long *pul_slot_of, *pul_free_slots;
+   unsigned long ul_free_top = 0, ul_next_slot = 0;
+   long l;
+
+   size_gen_init(&s_size_gen, e_size, ui_size);
+   life_gen_init(&s_life_gen, e_life, l_count / 6.0, ui_size);
+   prng_seed(&s_rng, ull_seed);
+
+   pl_death = malloc((size_t)l_count * sizeof(long));
+   pl_deaths = malloc((size_t)l_count * sizeof(long));
+   pul_slot_of = malloc((size_t)l_count * sizeof(unsigned long));
+   pul_free_slots = malloc((size_t)l_count * sizeof(unsigned long));
+   if (pl_death == NULL || pl_deaths == NULL || pul_slot_of == NULL
+       || pul_free_slots == NULL)
+   {
+      perror("malloc");
+      exit(EXIT_FAILURE);
+   }
+   death_heap_init(&s_deaths, pl_death, pl_deaths);
+
+   for (l = 0; l < l_count; l++)
+   {
+      size_t ui_bytes = size_gen_next(&s_size_gen, &s_rng);
+      unsigned long ul_slot = (ul_free_top > 0)
+         ? pul_free_slots[--ul_free_top] : ul_next_slot++;
+
+      add_op(ul_slot, FALSE, ui_bytes);
+      pul_slot_of[l] = ul_slot;
+      pl_death[l] = life_gen_death(&s_life_gen, &s_rng, l, ui_bytes);
+      death_heap_push(&s_deaths, l);
+      while (s_deaths.l_count > 0 && death_heap_first(&s_deaths) <= l)
+      {
+         long l_obj = death_heap_pop(&s_deaths);
+         add_op(pul_slot_of[l_obj], TRUE, 0);
+         pul_free_slots[ul_free_top++] = pul_slot_of[l_obj];
+      }
+   }
+   while (s_deaths.l_count > 0)
+      add_op(pul_slot_of[death_heap_pop(&s_deaths)], TRUE, 0);
+
+   free(pl_death);
+   free(pl_deaths);
+   free(pul_slot_of);
+   free(pul_free_slots);
+}
+
+/*--------------------------------------------------------------------*/
+
+static void load_trace(const char *pc_path)
+
+/* Build the stream from a trace file.  Trace object ids are reused
+   like slots, so they are used as slots directly. */
+
+{
+   static struct trace_reader s_reader;
+   struct trace_rec s_rec;
+   int i_status;
+
+   if (trace_reader_open(&s_reader, pc_path) != 0)
+   {
+      perror(pc_path);
+      exit(EXIT_FAILURE);
+   }
+   while ((i_status = trace_read(&s_reader, &s_rec)) == 1)
+      add_op(s_rec.ul_id, s_rec.i_op == TRACE_FREE, s_rec.ui_size);
+   trace_reader_close(&s_reader);
+   if (i_status != 0)
+   {
+      fprintf(stderr, "%s: truncated or unreadable trace\n", pc_path);
+      exit(EXIT_FAILURE);
+   }
+}
+
+/*--------------------------------------------------------------------*/
+
+static double now_seconds(void)
+{
+   struct timespec s_now;
+   clock_gettime(CLOCK_MONOTONIC, &s_now);
+   return (double)s_now.tv_sec + (double)s_now.tv_nsec / 1e9;
+}
+
+/*--------------------------------------------------------------------*/
+
+static void child_run(const char *pc_engine, int i_fd)
+
+/* In a fresh child: load the engine, run the whole stream against it
+   and write a struct result to i_fd.  Everything the run needs is set
+   up before the clock starts, and nothing in the timed loop calls
+   the C library's malloc(), so an sbrk()-based engine owns the
+   program break. */
+
+{
+   struct result s_result;
+   const struct heapmgr_engine *ps_engine;
+   struct rusage s_usage;
+   void *pv_handle;
+   void **ppv_slots;
+   double d_start;
+   size_t i;
+
+   memset(&s_result, 0, sizeof(s_result));
+   pv_handle = dlopen(pc_engine, RTLD_NOW | RTLD_LOCAL);
+   if (pv_handle == NULL)
+   {
+      fprintf(stderr, "%s\n", dlerror());
+      _exit(EXIT_FAILURE);
+   }
+   ps_engine = dlsym(pv_handle, HEAPMGR_ENGINE_SYMBOL);
+   if (ps_engine == NULL)
+   {
+      fprintf(stderr, "%s: no %s\n", pc_engine, HEAPMGR_ENGINE_SYMBOL);
+      _exit(EXIT_FAILURE);
+   }
+   strncpy(s_result.ac_name, ps_engine->pc_name, sizeof(s_result.ac_name) - 1);
+   ppv_slots = mmap(NULL, ul_slot_count * sizeof(void *),
+      PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE,
+      -1, 0);
+   if (ppv_slots == MAP_FAILED)
+   {
+      perror("mmap");
+      _exit(EXIT_FAILURE);
+   }
+
+   d_start = now_seconds();
+   for (i = 0; i < ui_op_count; i++)
+   {
+      unsigned long ul_word = ps_ops[i].ul_word;
+      if (ul_word & OP_FREE)
+         (*ps_engine->pf_free)(ppv_slots[ul_word >> 1]);
+      else if ((ppv_slots[ul_word >> 1] =
+                (*ps_engine->pf_malloc)(ps_ops[i].ui_size)) == NULL)
+         break;
+   }
+   s_result.d_seconds = now_seconds() - d_start;
+   s_result.i_ok = (i == ui_op_count);
+
+   if (ps_engine->pf_stats != NULL)
+   {
+      struct heapmgr_stats s_stats;
+      (*ps_engine->pf_stats)(&s_stats);
+      s_result.ui_heap_bytes = s_stats.ui_heap_bytes;
+   }
+   getrusage(RUSAGE_SELF, &s_usage);
+   s_result.l_maxrss_kb = s_usage.ru_maxrss;
+   s_result.l_minflt = s_usage.ru_minflt;
+
+   if (write(i_fd, &s_result, sizeof(s_result)) != (ssize_t)sizeof(s_result))
+      _exit(EXIT_FAILURE);
+   _exit(EXIT_SUCCESS);
+}
+
+/*--------------------------------------------------------------------*/
+
+static int run_engine(const char *pc_engine, struct result *ps_result)
+
+/* Fork a child that runs the stream against pc_engine, and collect
+   its result.  Return TRUE if the run completed. */
+
+{
+   int ai_pipe[2];
+   int i_status;
+   pid_t pid;
+
+   if (pipe(ai_pipe) != 0)
+   {
+      perror("pipe");
+      exit(EXIT_FAILURE);
+   }
+   fflush(NULL);
+   pid = fork();
+   if (pid < 0)
+   {
+      perror("fork");
+      exit(EXIT_FAILURE);
+   }
+   if (pid == 0)
+   {
+      close(ai_pipe[0]);
+      child_run(pc_engine, ai_pipe[1]);
+   }
+   close(ai_pipe[1]);
+   memset(ps_result, 0, sizeof(*ps_result));
+   if (read(ai_pipe[0], ps_result, sizeof(*ps_result))
+       != (ssize_t)sizeof(*ps_result))
+      ps_result->i_ok = FALSE;
+   close(ai_pipe[0]);
+   waitpid(pid, &i_status, 0);
+   return ps_result->i_ok && WIFEXITED(i_status)
+      && WEXITSTATUS(i_status) == 0;
+}
+
+/*--------------------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+
+/* Build one operation stream, either from the generated workload
+   argv[optind] (uniform, lognormal, zipf or bimodal; see workload.h)
+   with the given count and maximum size, or from the -T trace file.
+   Then run it -n times (default 5) against each engine shared object
+   in turn, round-robin so that drift affects every engine alike,
+   each run in a fresh forked child.  Print one line per run, then
+   the best and mean time per engine and the best time relative to
+   the first engine. */
+
+{
+   int i_repeats = 5, i_opt, i_engine_count, i, j;
+   enum life_dist e_life = LIFE_EXPONENTIAL;
+   enum size_dist e_size;
+   unsigned long long ull_seed = 1;
+   const char *pc_trace = NULL, *pc_workload;
+   char **ppc_engines;
+   double ad_best[MAX_ENGINES], ad_sum[MAX_ENGINES];
+   int ai_runs[MAX_ENGINES];
+
+   while ((i_opt = getopt(argc, argv, "n:L:r:T:")) != -1)
+   {
+      switch (i_opt)
+      {
+      case 'n':
+         i_repeats = atoi(optarg);
+         break;
+      case 'L':
+         if (life_dist_from_name(optarg, &e_life) != 0)
+         {
+            fprintf(stderr, USAGE, argv[0], argv[0]);
+            return EXIT_FAILURE;
+         }
+         break;
+      case 'r':
+         ull_seed = strtoull(optarg, NULL, 10);
+         break;
+      case 'T':
+         pc_trace = optarg;
+         break;
+      default:
+         fprintf(stderr, USAGE, argv[0], argv[0]);
+         return EXIT_FAILURE;
+      }
+   }
+
+   if (pc_trace != NULL)
+   {
+      pc_workload = pc_trace;
+      ppc_engines = &argv[optind];
+      i_engine_count = argc - optind;
+      if (i_engine_count < 1)
+      {
+         fprintf(stderr, USAGE, argv[0], argv[0]);
+         return EXIT_FAILURE;
+      }
+      load_trace(pc_trace);
+   }
+   else
+   {
+      long l_count;
+      long l_size;
+      if (argc - optind < 4 || size_dist_from_name(argv[optind], &e_size) != 0
+          || sscanf(argv[optind + 1], "%ld", &l_count) != 1 || l_count <= 0
+          || sscanf(argv[optind + 2], "%ld", &l_size) != 1 || l_size <= 0)
+      {
+         fprintf(stderr, USAGE, argv[0], argv[0]);
+         fprintf(stderr, "workload is uniform, lognormal, zipf or bimodal\n");
+         return EXIT_FAILURE;
+      }
+      pc_workload = argv[optind];
+      ppc_engines = &argv[optind + 3];
+      i_engine_count = argc - optind - 3;
+      generate_stream(e_size, e_life, ull_seed, l_count, (size_t)l_size);
+   }
+   if (i_engine_count > MAX_ENGINES || i_repeats < 1 || i_repeats > MAX_REPEATS)
+   {
+      fprintf(stderr, "At most %d engines and 1..%d repeats\n",
+         MAX_ENGINES, MAX_REPEATS);
+      return EXIT_FAILURE;
+   }
+
+   printf("%12s %12s %10s %4s %9s %8s %12s %10s\n", "Engine", "Workload",
+      "Ops", "Run", "Time", "ns/op", "Heap", "MaxRSS_kB");
+   memset(ai_runs, 0, sizeof(ai_runs));
+   memset(ad_sum, 0, sizeof(ad_sum));
+   for (i = 0; i < i_repeats; i++)
+      for (j = 0; j < i_engine_count; j++)
+      {
+         struct result s_result;
+         if (!run_engine(ppc_engines[j], &s_result))
+         {
+            fprintf(stderr, "%s: run %d failed\n", ppc_engines[j], i + 1);
+            continue;
+         }
+         printf("%12s %12s %10zu %4d %9.4f %8.1f %12zu %10ld\n",
+            s_result.ac_name, pc_workload, ui_op_count, i + 1,
+            s_result.d_seconds, s_result.d_seconds * 1e9 / (double)ui_op_count,
+            s_result.ui_heap_bytes, s_result.l_maxrss_kb);
+         if (ai_runs[j] == 0 || s_result.d_seconds < ad_best[j])
+            ad_best[j] = s_result.d_seconds;
+         ad_sum[j] += s_result.d_seconds;
+         ai_runs[j]++;
+      }
+
+   for (j = 0; j < i_engine_count; j++)
+      if (ai_runs[j] > 0)
+         printf("%s: best %.4f s mean %.4f s relative %.2f\n",
+            ppc_engines[j], ad_best[j], ad_sum[j] / ai_runs[j],
+            ai_runs[0] > 0 ? ad_best[j] / ad_best[0] : 0.0);
+   return 0;
+}
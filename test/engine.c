@@ -0,0 +1,22 @@
+/*--------------------------------------------------------------------*/
+/* engine.c                                                           */
+/* Wraps a heapmgr.h implementation as a struct heapmgr_engine.       */
+/* Compile with -D HEAPMGR_ENGINE_NAME='"name"' into a shared object  */
+/* together with the implementation.                                  */
+/*--------------------------------------------------------------------*/
+
+#include "engine.h"
+
+#ifndef HEAPMGR_ENGINE_NAME
+#define HEAPMGR_ENGINE_NAME "heapmgr"
+#endif
+
+const struct heapmgr_engine heapmgr_engine =
+{
+   HEAPMGR_ENGINE_NAME,
+   heapmgr_malloc,
+   heapmgr_free,
+   NULL,
+   heapmgr_stats,
+   NULL
+};
@@ -0,0 +1,29 @@
+/*--------------------------------------------------------------------*/
+/* engine.h                                                           */
+/* Uniform interface of a heapmgr engine built as a shared object     */
+/*--------------------------------------------------------------------*/
+
+#ifndef ENGINE_INCLUDED
+#define ENGINE_INCLUDED
+
+#include <stddef.h>
+#include "heapmgr.h"
+
+/* An engine shared object exports one const struct heapmgr_engine
+   named HEAPMGR_ENGINE_SYMBOL.  pf_malloc and pf_free are required;
+   the other entries are NULL when the engine does not provide them. */
+
+#define HEAPMGR_ENGINE_SYMBOL "heapmgr_engine"
+
+struct heapmgr_engine {
+   const char *pc_name;
+   void *(*pf_malloc)(size_t ui_bytes);
+   void (*pf_free)(void *pv_bytes);
+   void *(*pf_realloc)(void *pv_bytes, size_t ui_bytes);
+   void (*pf_stats)(struct heapmgr_stats *ps_stats);
+
+   /* Return the engine to its initial state, freeing every block. */
+   void (*pf_reset)(void);
+};
+
+#endif
@@ -0,0 +1,240 @@
+/*--------------------------------------------------------------------*/
+/* latency.c                                                          */
+/*--------------------------------------------------------------------*/
+
+#include "latency.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+/* Nanoseconds per tick, and the ticks one empty timed interval
+   costs.  Set by latency_calibrate(). */
+static double d_ns_per_tick = 0.0;
+static unsigned long long ull_overhead = 0;
+
+/*--------------------------------------------------------------------*/
+
+static unsigned long long monotonic_ns(void)
+
+/* Return CLOCK_MONOTONIC in nanoseconds. */
+
+{
+   struct timespec s_ts;
+   clock_gettime(CLOCK_MONOTONIC, &s_ts);
+   return (unsigned long long)s_ts.tv_sec * 1000000000ull
+      + (unsigned long long)s_ts.tv_nsec;
+}
+
+/*--------------------------------------------------------------------*/
+
+void latency_calibrate(void)
+
+/* Spin for about 20 ms to relate ticks to nanoseconds, then take the
+   minimum of many back-to-back reads as the timer overhead.  The
+   minimum, not the mean, is the part of every sample that is due to
+   the timer itself. */
+
+{
+   unsigned long long ull_ns0, ull_ns1, ull_t0, ull_t1;
+   unsigned long long ull_min;
+   int i;
+
+   ull_ns0 = monotonic_ns();
+   ull_t0 = latency_ticks();
+   do
+      ull_ns1 = monotonic_ns();
+   while (ull_ns1 - ull_ns0 < 20000000ull);
+   ull_t1 = latency_ticks();
+   d_ns_per_tick = (double)(ull_ns1 - ull_ns0) / (double)(ull_t1 - ull_t0);
+
+   ull_min = ~0ull;
+   for (i = 0; i < 10000; i++)
+   {
+      ull_t0 = latency_ticks();
+      ull_t1 = latency_ticks();
+      if (ull_t1 - ull_t0 < ull_min)
+         ull_min = ull_t1 - ull_t0;
+   }
+   ull_overhead = ull_min;
+}
+
+/*--------------------------------------------------------------------*/
+
+unsigned long long latency_interval(unsigned long long ull_start,
+   unsigned long long ull_end)
+{
+   unsigned long long ull_d = ull_end - ull_start;
+   return (ull_d > ull_overhead) ? ull_d - ull_overhead : 0;
+}
+
+/*--------------------------------------------------------------------*/
+
+static int bucket_of(unsigned long long ull_v)
+
+/* Return the histogram bucket of value ull_v.  Values below
+   2^LATENCY_SUB_BITS map to themselves; a larger value with its top
+   bit at position k is shifted right by s = k - LATENCY_SUB_BITS + 1
+   and lands in the s-th group of 2^(LATENCY_SUB_BITS - 1) buckets. */
+
+{
+   int i_msb, i_shift;
+
+   if (ull_v < (1ull << LATENCY_SUB_BITS))
+      return (int)ull_v;
+   i_msb = 63 - __builtin_clzll(ull_v);
+   i_shift = i_msb - LATENCY_SUB_BITS + 1;
+   return (i_shift << (LATENCY_SUB_BITS - 1)) + (int)(ull_v >> i_shift);
+}
+
+/*--------------------------------------------------------------------*/
+
+static unsigned long long bucket_low(int i_bucket)
+
+/* Return the smallest value that maps to bucket i_bucket. */
+
+{
+   int i_shift;
+
+   if (i_bucket < (1 << LATENCY_SUB_BITS))
+      return (unsigned long long)i_bucket;
+   i_shift = (i_bucket >> (LATENCY_SUB_BITS - 1)) - 1;
+   return (unsigned long long)(i_bucket - (i_shift << (LATENCY_SUB_BITS - 1)))
+      << i_shift;
+}
+
+/*--------------------------------------------------------------------*/
+
+void latency_record(struct latency_hist *ps_hist,
+   unsigned long long ull_ticks)
+{
+   assert(ps_hist != NULL);
+
+   ps_hist->aull_counts[bucket_of(ull_ticks)]++;
+   ps_hist->ull_count++;
+   if (ull_ticks > ps_hist->ull_max)
+      ps_hist->ull_max = ull_ticks;
+}
+
+/*--------------------------------------------------------------------*/
+
+double latency_ticks_to_ns(unsigned long long ull_ticks)
+{
+   return (double)ull_ticks * d_ns_per_tick;
+}
+
+/*--------------------------------------------------------------------*/
+
+double latency_percentile_ns(const struct latency_hist *ps_hist,
+   double d_percent)
+
+/* Report the midpoint of the bucket that holds the requested rank,
+   but never more than the exact maximum. */
+
+{
+   unsigned long long ull_rank, ull_seen = 0;
+   unsigned long long ull_lo, ull_hi;
+   int i;
+
+   assert(ps_hist != NULL);
+   assert(d_percent > 0.0 && d_percent <= 100.0);
+
+   if (ps_hist->ull_count == 0)
+      return 0.0;
+
+   ull_rank = (unsigned long long)(d_percent / 100.0 * (double)ps_hist->ull_count);
+   if (ull_rank == 0)
+      ull_rank = 1;
+
+   for (i = 0; i < LATENCY_BUCKETS; i++)
+   {
+      ull_seen += ps_hist->aull_counts[i];
+      if (ull_seen >= ull_rank)
+         break;
+   }
+   ull_lo = bucket_low(i);
+   ull_hi = (i + 1 < LATENCY_BUCKETS) ? bucket_low(i + 1) - 1 : ull_lo;
+   if (ull_hi > ps_hist->ull_max)
+      ull_hi = ps_hist->ull_max;
+   return latency_ticks_to_ns(ull_lo + (ull_hi - ull_lo) / 2);
+}
+
+/*--------------------------------------------------------------------*/
+
+void latency_print(const char *pc_label,
+   const struct latency_hist *ps_hist)
+{
+   printf("   %-6s lat(ns) n %9llu p50 %8.0f p90 %8.0f p99 %8.0f "
+          "p99.9 %8.0f max %10.0f\n",
+          pc_label, ps_hist->ull_count,
+          latency_percentile_ns(ps_hist, 50.0),
+          latency_percentile_ns(ps_hist, 90.0),
+          latency_percentile_ns(ps_hist, 99.0),
+          latency_percentile_ns(ps_hist, 99.9),
+          latency_ticks_to_ns(ps_hist->ull_max));
+}
+
+/*--------------------------------------------------------------------*/
+
+double now_ns(void)
+{
+   return (double)monotonic_ns();
+}
+
+void *map_array(size_t ui_bytes)
+{
+   void *pv = mmap(NULL, ui_bytes, PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+   if (pv == MAP_FAILED)
+   {
+      perror("mmap");
+      exit(EXIT_FAILURE);
+   }
+   return pv;
+}
+
+int perf_counter_open(unsigned int ui_type, unsigned long long ull_config,
+   pid_t pid, int i_on_exec)
+{
+   struct perf_event_attr s_attr;
+
+   memset(&s_attr, 0, sizeof(s_attr));
+   s_attr.size = sizeof(s_attr);
+   s_attr.type = ui_type;
+   s_attr.config = ull_config;
+   s_attr.disabled = 1;
+   s_attr.exclude_kernel = 1;
+   s_attr.exclude_hv = 1;
+   if (i_on_exec)
+   {
+      s_attr.enable_on_exec = 1;
+      s_attr.inherit = 1;
+      s_attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED
+         | PERF_FORMAT_TOTAL_TIME_RUNNING;
+   }
+   return (int)syscall(SYS_perf_event_open, &s_attr, pid, -1, -1, 0);
+}
+
+/*--------------------------------------------------------------------*/
+
+double t_critical_95(int i_df)
+{
+   static const double ad_t[] =
+   {
+      0.0, 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306,
+      2.262, 2.228, 2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110,
+      2.101, 2.093, 2.086, 2.080, 2.074, 2.069, 2.064, 2.060, 2.056,
+      2.052, 2.048, 2.045, 2.042
+   };
+   if (i_df < 1)
+      return 0.0;
+   if (i_df < (int)(sizeof(ad_t) / sizeof(ad_t[0])))
+      return ad_t[i_df];
+   if (i_df < 60)
+      return 2.01;
+   return 1.96;
+}
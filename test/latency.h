@@ -0,0 +1,107 @@
+/*--------------------------------------------------------------------*/
+/* latency.h                                                          */
+/* Cycle counter, latency histograms and shared benchmark helpers     */
+/*--------------------------------------------------------------------*/
+
+#ifndef LATENCY_INCLUDED
+#define LATENCY_INCLUDED
+
+#include <stddef.h>
+#include <time.h>
+#include <sys/types.h>
+
+/* Each power of two is split into 2^(LATENCY_SUB_BITS - 1) linear
+   sub-buckets, so a recorded value is known to within 1/64 (about
+   1.6%).  Values below 2^LATENCY_SUB_BITS are recorded exactly. */
+enum {LATENCY_SUB_BITS = 7};
+enum {LATENCY_BUCKETS = (64 - LATENCY_SUB_BITS + 2) << (LATENCY_SUB_BITS - 1)};
+
+struct latency_hist {
+   unsigned long long aull_counts[LATENCY_BUCKETS];
+   unsigned long long ull_count;   /* number of samples */
+   unsigned long long ull_max;     /* largest sample, in ticks */
+};
+
+/*--------------------------------------------------------------------*/
+
+static inline unsigned long long latency_ticks(void)
+
+/* Return the current value of the cheapest monotonic tick counter
+   the CPU offers: the TSC on x86, the virtual counter on AArch64,
+   and CLOCK_MONOTONIC nanoseconds elsewhere.  The read is not
+   serialized, which is fine for intervals of tens of nanoseconds
+   and up. */
+
+{
+#if defined(__x86_64__) || defined(__i386__)
+   unsigned int ui_lo, ui_hi;
+   __asm__ __volatile__("rdtsc" : "=a"(ui_lo), "=d"(ui_hi));
+   return ((unsigned long long)ui_hi << 32) | ui_lo;
+#elif defined(__aarch64__)
+   unsigned long long ull_v;
+   __asm__ __volatile__("isb; mrs %0, cntvct_el0" : "=r"(ull_v));
+   return ull_v;
+#else
+   struct timespec s_ts;
+   clock_gettime(CLOCK_MONOTONIC, &s_ts);
+   return (unsigned long long)s_ts.tv_sec * 1000000000ull
+      + (unsigned long long)s_ts.tv_nsec;
+#endif
+}
+
+/*--------------------------------------------------------------------*/
+
+void latency_calibrate(void);
+/* Measure the tick rate against CLOCK_MONOTONIC and the cost of two
+   back-to-back latency_ticks() reads.  Must be called once before
+   latency_interval() or any reporting function. */
+
+unsigned long long latency_interval(unsigned long long ull_start,
+   unsigned long long ull_end);
+/* Return ull_end - ull_start with the calibrated timer overhead
+   removed, clamped at 0. */
+
+void latency_record(struct latency_hist *ps_hist,
+   unsigned long long ull_ticks);
+/* Add one sample of ull_ticks ticks to *ps_hist. */
+
+double latency_percentile_ns(const struct latency_hist *ps_hist,
+   double d_percent);
+/* Return the d_percent-th percentile (0 < d_percent <= 100) of
+   *ps_hist in nanoseconds, or 0 if *ps_hist is empty. */
+
+double latency_ticks_to_ns(unsigned long long ull_ticks);
+/* Convert ull_ticks ticks to nanoseconds. */
+
+void latency_print(const char *pc_label,
+   const struct latency_hist *ps_hist);
+/* Write one line with the sample count and the p50, p90, p99, p99.9
+   and maximum latencies of *ps_hist in nanoseconds to stdout. */
+
+double now_ns(void);
+/* Return CLOCK_MONOTONIC in nanoseconds. */
+
+void *map_array(size_t ui_bytes);
+/* Return ui_bytes of zeroed, pre-faulted memory from mmap(), or exit
+   if there is none.  Benchmark arrays come from here, so the heap
+   under test owns the program break. */
+
+/* perf_event_attr config of read misses in cache, one of the
+   PERF_COUNT_HW_CACHE_* constants of <linux/perf_event.h>. */
+#define CACHE_MISS(cache) ((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) \
+   | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+int perf_counter_open(unsigned int ui_type, unsigned long long ull_config,
+   pid_t pid, int i_on_exec);
+/* Open a disabled user-space perf counter of type ui_type and config
+   ull_config on process pid (0 for this one).  If i_on_exec, the
+   counter is enabled when pid calls exec, also counts its children,
+   and reads return the value, time enabled and time running.  Return
+   the descriptor, or -1 if the kernel or the CPU does not support
+   it. */
+
+double t_critical_95(int i_df);
+/* Return the two-sided 95% critical value of Student's t
+   distribution with i_df degrees of freedom, or 0 if i_df < 1. */
+
+#endif
@@ -0,0 +1,550 @@
+/*--------------------------------------------------------------------*/
+/* localheapmgr.c                                                     */
+/* Client-side cache-locality benchmarks for a heapmgr engine         */
+/*--------------------------------------------------------------------*/
+
+#define _GNU_SOURCE
+#include "heapmgr.h"
+#include "latency.h"
+#include "workload.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <linux/perf_event.h>
+
+enum {FALSE, TRUE};
+
+#define USAGE "Usage: %s scenario nodes size [-r seed]\n"
+
+/* Structure-order traversals and allocation-order streams are
+   repeated this many times so short runs still take measurable
+   time. */
+enum {PASSES = 8};
+
+/* Short-lived objects allocated between the nodes, and the chance
+   out of 4 that a node allocation is followed by one. */
+enum {NOISE_SLOTS = 64, NOISE_CHANCE = 2};
+
+/*--------------------------------------------------------------------*/
+
+/* Every node starts with this header; the rest of its size bytes are
+   payload, written when the node is allocated and read by every
+   traversal.  ap_link[0] is the list/chain successor or the left
+   child, ap_link[1] the right child. */
+struct node {
+   struct node *ap_link[2];
+   unsigned long ul_key;
+   unsigned long ul_size;
+};
+
+/* Results of one scenario.  Miss counts are -1 if the kernel does not
+   permit counting. */
+struct result {
+   double d_build;            /* seconds to build, churn included */
+   double d_traverse;         /* seconds for PASSES traversals */
+   double d_stream;           /* seconds for PASSES streams */
+   double d_l1d, d_llc;       /* misses during traversal and stream */
+   double d_median_dist;      /* bytes between consecutive nodes */
+   double d_adjacent;         /* fraction of them within 2 * size */
+};
+
+typedef void (*scenario_function)(long, int, struct result *);
+
+static struct prng s_rng;
+
+/* Nodes by index, their keys, and the noise objects. */
+static struct node **pps_nodes;
+static unsigned long *pul_keys;
+static void *apv_noise[NOISE_SLOTS];
+
+/* Address distance from each node allocation to the previous one, in
+   call order, and the number recorded. */
+static unsigned long *pul_dists;
+static long l_dists;
+static char *pc_last_node;
+
+/* Counter descriptors for the L1D and LLC read misses, or -1. */
+static int i_l1d_fd = -1, i_llc_fd = -1;
+
+/* Traversals add into this so the compiler cannot drop them. */
+static volatile unsigned long ul_sink;
+
+/*--------------------------------------------------------------------*/
+
+static double now_seconds(void)
+{
+   struct timespec s_now;
+   clock_gettime(CLOCK_MONOTONIC, &s_now);
+   return (double)s_now.tv_sec + (double)s_now.tv_nsec / 1e9;
+}
+
+static void counters_start(void)
+{
+   if (i_l1d_fd >= 0)
+   {
+      ioctl(i_l1d_fd, PERF_EVENT_IOC_RESET, 0);
+      ioctl(i_l1d_fd, PERF_EVENT_IOC_ENABLE, 0);
+   }
+   if (i_llc_fd >= 0)
+   {
+      ioctl(i_llc_fd, PERF_EVENT_IOC_RESET, 0);
+      ioctl(i_llc_fd, PERF_EVENT_IOC_ENABLE, 0);
+   }
+}
+
+static double counter_stop(int i_fd)
+
+/* Stop counter i_fd and return its value, or -1 if it is not open. */
+
+{
+   unsigned long long ull_value;
+
+   if (i_fd < 0)
+      return -1.0;
+   ioctl(i_fd, PERF_EVENT_IOC_DISABLE, 0);
+   if (read(i_fd, &ull_value, sizeof(ull_value)) != (ssize_t)sizeof(ull_value))
+      return -1.0;
+   return (double)ull_value;
+}
+
+/*--------------------------------------------------------------------*/
+
+static struct node *new_node(long l_index, int i_size)
+
+/* Allocate node l_index with a random size of sizeof(struct node) to
+   i_size bytes, fill its payload, and record it in allocation order.
+   Sometimes also churn a short-lived noise object, so that the
+   engine's placement decisions, not just the order of the calls,
+   decide where consecutive nodes land. */
+
+{
+   unsigned long ul_size = sizeof(struct node)
+      + (unsigned long)(prng_next(&s_rng)
+         % ((unsigned long)i_size - sizeof(struct node) + 1));
+   struct node *ps = heapmgr_malloc(ul_size);
+   unsigned long long ull = prng_next(&s_rng);
+
+   if (ps == NULL)
+   {
+      fprintf(stderr, "heapmgr_malloc failed\n");
+      exit(EXIT_FAILURE);
+   }
+   ps->ap_link[0] = ps->ap_link[1] = NULL;
+   ps->ul_key = pul_keys[l_index];
+   ps->ul_size = ul_size;
+   memset(ps + 1, (int)l_index, ul_size - sizeof(struct node));
+   pps_nodes[l_index] = ps;
+   if (pc_last_node != NULL)
+      pul_dists[l_dists++] = (unsigned long)((char *)ps > pc_last_node
+         ? (char *)ps - pc_last_node : pc_last_node - (char *)ps);
+   pc_last_node = (char *)ps;
+
+   if ((ull & 3) < NOISE_CHANCE)
+   {
+      int i = (int)((ull >> 2) % NOISE_SLOTS);
+      if (apv_noise[i] != NULL)
+         heapmgr_free(apv_noise[i]);
+      apv_noise[i] = heapmgr_malloc((size_t)((ull >> 8) % (unsigned long)i_size) + 1);
+   }
+   return ps;
+}
+
+static void free_all(long l_nodes)
+{
+   long l;
+   int i;
+
+   for (l = 0; l < l_nodes; l++)
+      heapmgr_free(pps_nodes[l]);
+   for (i = 0; i < NOISE_SLOTS; i++)
+      if (apv_noise[i] != NULL)
+      {
+         heapmgr_free(apv_noise[i]);
+         apv_noise[i] = NULL;
+      }
+}
+
+static unsigned long read_node(const struct node *ps)
+
+/* Read the whole payload of *ps, a word at a time. */
+
+{
+   const unsigned long *pul = (const unsigned long *)(ps + 1);
+   unsigned long ul = ps->ul_key;
+   size_t i, n = (ps->ul_size - sizeof(struct node)) / sizeof(unsigned long);
+
+   for (i = 0; i < n; i++)
+      ul += pul[i];
+   return ul;
+}
+
+/*--------------------------------------------------------------------*/
+
+static unsigned long select_ul(unsigned long *pul, long l_count, long l_k)
+
+/* Return the l_k-th smallest of pul[0 .. l_count-1], reordering them
+   (Hoare's selection).  qsort() is not used because glibc may call
+   malloc() inside it, which would move the program break under an
+   sbrk()-based engine. */
+
+{
+   long l_lo = 0, l_hi = l_count - 1;
+
+   while (l_lo < l_hi)
+   {
+      unsigned long ul_pivot = pul[l_lo + (l_hi - l_lo) / 2], ul;
+      long i = l_lo, j = l_hi;
+      while (i <= j)
+      {
+         while (pul[i] < ul_pivot)
+            i++;
+         while (pul[j] > ul_pivot)
+            j--;
+         if (i <= j)
+         {
+            ul = pul[i];
+            pul[i++] = pul[j];
+            pul[j--] = ul;
+         }
+      }
+      if (l_k <= j)
+         l_hi = j;
+      else if (l_k >= i)
+         l_lo = i;
+      else
+         break;
+   }
+   return pul[l_k];
+}
+
+static void placement(int i_size, struct result *ps_r)
+
+/* Fill the placement-locality metrics of *ps_r from the distances
+   between consecutive node allocations: the median in bytes, and the
+   fraction within 2 * i_size, i.e. roughly neighbours.  Then start a
+   new record. */
+
+{
+   long l, l_near = 0;
+
+   for (l = 0; l < l_dists; l++)
+      if (pul_dists[l] <= 2 * (unsigned long)i_size)
+         l_near++;
+   if (l_dists > 0)
+   {
+      ps_r->d_median_dist = (double)select_ul(pul_dists, l_dists, (l_dists - 1) / 2);
+      ps_r->d_adjacent = (double)l_near / (double)l_dists;
+   }
+   l_dists = 0;
+   pc_last_node = NULL;
+}
+
+static void stream(long l_nodes, struct result *ps_r)
+
+/* Read every node in allocation order, PASSES times. */
+
+{
+   unsigned long ul = 0;
+   double d_t0 = now_seconds();
+   long l;
+   int k;
+
+   for (k = 0; k < PASSES; k++)
+      for (l = 0; l < l_nodes; l++)
+         ul += read_node(pps_nodes[l]);
+   ps_r->d_stream = now_seconds() - d_t0;
+   ul_sink += ul;
+}
+
+/*--------------------------------------------------------------------*/
+
+static void test_list(long l_nodes, int i_size, struct result *ps_r)
+
+/* Build a singly linked list by appending, then walk it. */
+
+{
+   struct node *ps_head = NULL, *ps_tail = NULL, *ps;
+   unsigned long ul = 0;
+   double d_t0 = now_seconds();
+   long l;
+   int k;
+
+   for (l = 0; l < l_nodes; l++)
+   {
+      ps = new_node(l, i_size);
+      if (ps_tail == NULL)
+         ps_head = ps;
+      else
+         ps_tail->ap_link[0] = ps;
+      ps_tail = ps;
+   }
+   ps_r->d_build = now_seconds() - d_t0;
+
+   counters_start();
+   d_t0 = now_seconds();
+   for (k = 0; k < PASSES; k++)
+      for (ps = ps_head; ps != NULL; ps = ps->ap_link[0])
+         ul += read_node(ps);
+   ps_r->d_traverse = now_seconds() - d_t0;
+   ul_sink += ul;
+   stream(l_nodes, ps_r);
+}
+
+/*--------------------------------------------------------------------*/
+
+static void test_tree(long l_nodes, int i_size, struct result *ps_r)
+
+/* Insert nodes with random keys into an unbalanced binary search
+   tree, then visit it in key order. */
+
+{
+   struct node *ps_root = NULL, *ps, **pps;
+   struct node **pps_stack = map_array((size_t)l_nodes * sizeof(struct node *));
+   unsigned long ul = 0;
+   double d_t0 = now_seconds();
+   long l, l_top;
+   int k;
+
+   for (l = 0; l < l_nodes; l++)
+   {
+      ps = new_node(l, i_size);
+      for (pps = &ps_root; *pps != NULL; )
+         pps = &(*pps)->ap_link[ps->ul_key >= (*pps)->ul_key];
+      *pps = ps;
+   }
+   ps_r->d_build = now_seconds() - d_t0;
+
+   counters_start();
+   d_t0 = now_seconds();
+   for (k = 0; k < PASSES; k++)
+   {
+      l_top = 0;
+      ps = ps_root;
+      while (ps != NULL || l_top > 0)
+      {
+         for (; ps != NULL; ps = ps->ap_link[0])
+            pps_stack[l_top++] = ps;
+         ps = pps_stack[--l_top];
+         ul += read_node(ps);
+         ps = ps->ap_link[1];
+      }
+   }
+   ps_r->d_traverse = now_seconds() - d_t0;
+   ul_sink += ul;
+   stream(l_nodes, ps_r);
+   munmap(pps_stack, (size_t)l_nodes * sizeof(struct node *));
+}
+
+/*--------------------------------------------------------------------*/
+
+static void test_hash(long l_nodes, int i_size, struct result *ps_r)
+
+/* Insert nodes into a chained hash table with about two nodes per
+   bucket, then look up random existing keys. */
+
+{
+   size_t ui_buckets = 1;
+   struct node **pps_table, *ps;
+   unsigned long ul = 0;
+   double d_t0;
+   long l;
+   int k;
+
+   while (ui_buckets * 2 < (size_t)l_nodes)
+      ui_buckets *= 2;
+   pps_table = map_array(ui_buckets * sizeof(struct node *));
+
+   d_t0 = now_seconds();
+   for (l = 0; l < l_nodes; l++)
+   {
+      ps = new_node(l, i_size);
+      ps->ap_link[0] = pps_table[ps->ul_key & (ui_buckets - 1)];
+      pps_table[ps->ul_key & (ui_buckets - 1)] = ps;
+   }
+   ps_r->d_build = now_seconds() - d_t0;
+
+   counters_start();
+   d_t0 = now_seconds();
+   for (k = 0; k < PASSES; k++)
+      for (l = 0; l < l_nodes; l++)
+      {
+         unsigned long ul_key = pul_keys[prng_next(&s_rng) % (unsigned long)l_nodes];
+         for (ps = pps_table[ul_key & (ui_buckets - 1)];
+              ps->ul_key != ul_key; ps = ps->ap_link[0])
+            ;
+         ul += read_node(ps);
+      }
+   ps_r->d_traverse = now_seconds() - d_t0;
+   ul_sink += ul;
+   stream(l_nodes, ps_r);
+   munmap(pps_table, ui_buckets * sizeof(struct node *));
+}
+
+/*--------------------------------------------------------------------*/
+
+static void test_reuse(long l_nodes, int i_size, struct result *ps_r)
+
+/* Build a doubly linked list (ap_link[1] is the predecessor), then
+   l_nodes times read a random node, unlink and free it while it is
+   hot in the cache, and append a replacement.  An engine that hands
+   recently freed memory back first keeps the replacements in cache;
+   one that does not writes cold memory.  The churned list is then
+   walked. */
+
+{
+   struct node s_anchor, *ps, *ps_prev;
+   unsigned long ul = 0;
+   double d_t0 = now_seconds();
+   long l, l_victim;
+   int k;
+
+   /* s_anchor is the circular list's sentinel. */
+   s_anchor.ap_link[0] = s_anchor.ap_link[1] = &s_anchor;
+   for (l = 0; l < l_nodes + l_nodes; l++)
+   {
+      if (l < l_nodes)
+         l_victim = l;
+      else
+      {
+         l_victim = (long)(prng_next(&s_rng) % (unsigned long)l_nodes);
+         ps = pps_nodes[l_victim];
+         ul += read_node(ps);
+         ps->ap_link[1]->ap_link[0] = ps->ap_link[0];
+         ps->ap_link[0]->ap_link[1] = ps->ap_link[1];
+         heapmgr_free(ps);
+      }
+      ps = new_node(l_victim, i_size);
+      ps_prev = s_anchor.ap_link[1];
+      ps->ap_link[0] = &s_anchor;
+      ps->ap_link[1] = ps_prev;
+      ps_prev->ap_link[0] = ps;
+      s_anchor.ap_link[1] = ps;
+   }
+   ps_r->d_build = now_seconds() - d_t0;
+
+   counters_start();
+   d_t0 = now_seconds();
+   for (k = 0; k < PASSES; k++)
+      for (ps = s_anchor.ap_link[0]; ps != &s_anchor; ps = ps->ap_link[0])
+         ul += read_node(ps);
+   ps_r->d_traverse = now_seconds() - d_t0;
+   ul_sink += ul;
+   stream(l_nodes, ps_r);
+}
+
+/*--------------------------------------------------------------------*/
+
+static char *apc_scenario_name[] =
+{
+   "list", "tree", "hash", "reuse"
+};
+
+static scenario_function apf_scenario[] =
+{
+   test_list, test_tree, test_hash, test_reuse
+};
+
+/*--------------------------------------------------------------------*/
+
+static void print_count(double d_count, long l_nodes)
+
+/* Write d_count per node, or "-" if it was not counted. */
+
+{
+   if (d_count < 0.0)
+      printf(" %8s", "-");
+   else
+      printf(" %8.2f", d_count / ((double)l_nodes * 2 * PASSES));
+}
+
+int main(int argc, char *argv[])
+
+/* Run the scenario argv[1] ("list", "tree", "hash", "reuse" or
+   "all") with argv[2] nodes of sizeof(struct node) to argv[3] bytes.
+   For each scenario print the build time, the structure-order
+   traversal and allocation-order stream time per node visit, L1D and
+   LLC read misses per node visit over both, the median address
+   distance between consecutively allocated nodes, and the fraction
+   of them within 2 * size bytes. */
+
+{
+   long l_nodes, l;
+   int i_size, i_first, i_last, i;
+   unsigned long long ull_seed = 1;
+   int i_count = (int)(sizeof(apc_scenario_name) / sizeof(apc_scenario_name[0]));
+
+   if ((argc != 4 && !(argc == 6 && strcmp(argv[4], "-r") == 0
+          && sscanf(argv[5], "%llu", &ull_seed) == 1))
+       || sscanf(argv[2], "%ld", &l_nodes) != 1
+       || sscanf(argv[3], "%d", &i_size) != 1
+       || l_nodes <= 0 || i_size < (int)sizeof(struct node))
+   {
+      fprintf(stderr, USAGE, argv[0]);
+      fprintf(stderr, "nodes must be positive and size at least %d\n",
+         (int)sizeof(struct node));
+      return EXIT_FAILURE;
+   }
+   if (strcmp(argv[1], "all") == 0)
+   {
+      i_first = 0;
+      i_last = i_count - 1;
+   }
+   else
+   {
+      for (i = 0; i < i_count; i++)
+         if (strcmp(argv[1], apc_scenario_name[i]) == 0)
+            break;
+      if (i == i_count)
+      {
+         fprintf(stderr, USAGE, argv[0]);
+         fprintf(stderr, "Valid scenarios: all");
+         for (i = 0; i < i_count; i++)
+            fprintf(stderr, " %s", apc_scenario_name[i]);
+         fprintf(stderr, "\n");
+         return EXIT_FAILURE;
+      }
+      i_first = i_last = i;
+   }
+
+   pps_nodes = map_array((size_t)l_nodes * sizeof(struct node *));
+   pul_keys = map_array((size_t)l_nodes * sizeof(unsigned long));
+   pul_dists = map_array(2 * (size_t)l_nodes * sizeof(unsigned long));
+   i_l1d_fd = perf_counter_open(PERF_TYPE_HW_CACHE,
+      CACHE_MISS(PERF_COUNT_HW_CACHE_L1D), 0, FALSE);
+   i_llc_fd = perf_counter_open(PERF_TYPE_HW_CACHE,
+      CACHE_MISS(PERF_COUNT_HW_CACHE_LL), 0, FALSE);
+
+   printf("%17s %8s %9s %8s %8s %8s %8s %8s %10s %6s\n", "Executable",
+      "Scenario", "Nodes", "Build", "Trav ns", "Strm ns", "L1D", "LLC",
+      "MedDist", "Adj");
+   fflush(stdout);
+
+   for (i = i_first; i <= i_last; i++)
+   {
+      struct result s_r;
+
+      memset(&s_r, 0, sizeof(s_r));
+      prng_seed(&s_rng, ull_seed);
+      for (l = 0; l < l_nodes; l++)
+         pul_keys[l] = prng_next(&s_rng);
+      (*apf_scenario[i])(l_nodes, i_size, &s_r);
+      s_r.d_l1d = counter_stop(i_l1d_fd);
+      s_r.d_llc = counter_stop(i_llc_fd);
+      placement(i_size, &s_r);
+      free_all(l_nodes);
+
+      printf("%17s %8s %9ld %8.3f %8.2f %8.2f", argv[0],
+         apc_scenario_name[i], l_nodes, s_r.d_build,
+         s_r.d_traverse * 1e9 / ((double)l_nodes * PASSES),
+         s_r.d_stream * 1e9 / ((double)l_nodes * PASSES));
+      print_count(s_r.d_l1d, l_nodes);
+      print_count(s_r.d_llc, l_nodes);
+      printf(" %10.0f %6.3f\n", s_r.d_median_dist, s_r.d_adjacent);
+      fflush(stdout);
+   }
+   return 0;
+}
@@ -0,0 +1,217 @@
+/*--------------------------------------------------------------------*/
+/* memseries.c                                                        */
+/*--------------------------------------------------------------------*/
+
+#include "memseries.h"
+#include "heapmgr.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+/* Initial capacity of the per-object size table; doubled as needed. */
+enum {MEM_SERIES_MIN_SIZES = 4096};
+
+/*--------------------------------------------------------------------*/
+
+static double wall_seconds(void)
+{
+   struct timespec s_now;
+   clock_gettime(CLOCK_MONOTONIC, &s_now);
+   return (double)s_now.tv_sec + (double)s_now.tv_nsec / 1e9;
+}
+
+/*--------------------------------------------------------------------*/
+
+static size_t rss_bytes(const struct mem_series *ps_ms)
+
+/* Return the resident set size from /proc/self/statm, or 0 if it
+   cannot be read.  The file is read with pread() into a stack buffer
+   so no stdio buffer is allocated. */
+
+{
+   char ac_buf[128];
+   ssize_t l_len;
+   unsigned long ul_size, ul_resident;
+
+   if (ps_ms->i_statm_fd < 0)
+      return 0;
+   l_len = pread(ps_ms->i_statm_fd, ac_buf, sizeof(ac_buf) - 1, 0);
+   if (l_len <= 0)
+      return 0;
+   ac_buf[l_len] = '\0';
+   if (sscanf(ac_buf, "%lu %lu", &ul_size, &ul_resident) != 2)
+      return 0;
+   return (size_t)ul_resident * (size_t)sysconf(_SC_PAGESIZE);
+}
+
+/*--------------------------------------------------------------------*/
+
+static int write_all(int i_fd, const char *pc, size_t ui_len)
+{
+   while (ui_len > 0)
+   {
+      ssize_t l = write(i_fd, pc, ui_len);
+      if (l < 0)
+      {
+         if (errno == EINTR)
+            continue;
+         return -1;
+      }
+      pc += l;
+      ui_len -= (size_t)l;
+   }
+   return 0;
+}
+
+/*--------------------------------------------------------------------*/
+
+static int sample(struct mem_series *ps_ms)
+
+/* Write one CSV row and update the peaks and the fragmentation
+   integral.  The heap footprint is the engine's own heap_bytes when
+   it reports one, else the growth of the program break.
+   Fragmentation is 1 - live / footprint; external fragmentation is
+   1 - largest free block / free bytes, left empty when the engine
+   does not report the largest free block.  Return 0 or -1. */
+
+{
+   struct heapmgr_stats s_stats;
+   char ac_line[320];
+   size_t ui_break = (size_t)((char *)sbrk(0) - ps_ms->pc_break0);
+   size_t ui_heap, ui_rss;
+   double d_t = wall_seconds() - ps_ms->d_t0;
+   double d_frag, d_ext;
+   int i_len;
+
+   heapmgr_stats(&s_stats);
+   ui_heap = (s_stats.ui_heap_bytes != 0) ? s_stats.ui_heap_bytes : ui_break;
+   ui_rss = rss_bytes(ps_ms);
+   d_frag = (ui_heap > ps_ms->ui_live)
+      ? 1.0 - (double)ps_ms->ui_live / (double)ui_heap : 0.0;
+   d_ext = (s_stats.ui_bytes_free > 0)
+      ? 1.0 - (double)s_stats.ui_largest_free / (double)s_stats.ui_bytes_free
+      : 0.0;
+
+   if (ps_ms->ll_samples > 0)
+      ps_ms->d_frag_area += ps_ms->d_last_frag * (d_t - ps_ms->d_last_t);
+   ps_ms->d_last_t = d_t;
+   ps_ms->d_last_frag = d_frag;
+   ps_ms->ll_samples++;
+   if (ui_heap > ps_ms->ui_peak_heap)
+      ps_ms->ui_peak_heap = ui_heap;
+   if (ui_rss > ps_ms->ui_peak_rss)
+      ps_ms->ui_peak_rss = ui_rss;
+
+   i_len = snprintf(ac_line, sizeof(ac_line),
+      "%lld,%.6f,%zu,%zu,%zu,%zu,%zu,%zu,%zu,%.4f,",
+      ps_ms->ll_calls, d_t, ps_ms->ui_live, ui_heap, ui_break, ui_rss,
+      s_stats.ui_bytes_free, s_stats.ui_largest_free,
+      s_stats.ui_free_blocks, d_frag);
+   /* Left empty for engines that cannot report the largest free
+      block. */
+   if (s_stats.ui_largest_free > 0 || s_stats.ui_bytes_free == 0)
+      i_len += snprintf(ac_line + i_len, sizeof(ac_line) - (size_t)i_len,
+         "%.4f", d_ext);
+   ac_line[i_len++] = '\n';
+   return write_all(ps_ms->i_fd, ac_line, (size_t)i_len);
+}
+
+/*--------------------------------------------------------------------*/
+
+int mem_series_open(struct mem_series *ps_ms, const char *pc_path,
+   long long ll_interval)
+{
+   static const char ac_header[] = "calls,seconds,live_bytes,heap_bytes,"
+      "break_bytes,rss_bytes,free_bytes,largest_free,free_blocks,"
+      "fragmentation,external_fragmentation\n";
+
+   memset(ps_ms, 0, sizeof(*ps_ms));
+   ps_ms->i_fd = open(pc_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+   if (ps_ms->i_fd < 0)
+      return -1;
+   ps_ms->i_statm_fd = open("/proc/self/statm", O_RDONLY);
+   ps_ms->ll_interval = (ll_interval > 0) ? ll_interval : 1;
+   ps_ms->pc_break0 = sbrk(0);
+   ps_ms->d_t0 = wall_seconds();
+   if (write_all(ps_ms->i_fd, ac_header, sizeof(ac_header) - 1) != 0)
+      return -1;
+   return sample(ps_ms);
+}
+
+/*--------------------------------------------------------------------*/
+
+void mem_series_malloc(struct mem_series *ps_ms, unsigned long ul_id,
+   size_t ui_bytes)
+{
+   if (ul_id >= ps_ms->ui_sizes_cap)
+   {
+      /* Ids are reused, so the table only grows to the peak number
+         of live objects. */
+      size_t ui_cap = (ps_ms->ui_sizes_cap != 0)
+         ? ps_ms->ui_sizes_cap : MEM_SERIES_MIN_SIZES;
+      size_t *pui;
+      while (ui_cap <= ul_id)
+         ui_cap *= 2;
+      pui = mmap(NULL, ui_cap * sizeof(size_t), PROT_READ | PROT_WRITE,
+         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (pui == MAP_FAILED)
+         return;
+      if (ps_ms->pui_sizes != NULL)
+      {
+         memcpy(pui, ps_ms->pui_sizes, ps_ms->ui_sizes_cap * sizeof(size_t));
+         munmap(ps_ms->pui_sizes, ps_ms->ui_sizes_cap * sizeof(size_t));
+      }
+      ps_ms->pui_sizes = pui;
+      ps_ms->ui_sizes_cap = ui_cap;
+   }
+   ps_ms->pui_sizes[ul_id] = ui_bytes;
+   ps_ms->ui_live += ui_bytes;
+   if (ps_ms->ui_live > ps_ms->ui_peak_live)
+      ps_ms->ui_peak_live = ps_ms->ui_live;
+}
+
+void mem_series_free(struct mem_series *ps_ms, long l_id)
+{
+   if (l_id < 0 || (size_t)l_id >= ps_ms->ui_sizes_cap)
+      return;
+   ps_ms->ui_live -= ps_ms->pui_sizes[l_id];
+   ps_ms->pui_sizes[l_id] = 0;
+}
+
+void mem_series_call(struct mem_series *ps_ms)
+{
+   if (++ps_ms->ll_calls % ps_ms->ll_interval == 0 && sample(ps_ms) != 0)
+      ps_ms->i_error = 1;
+}
+
+/*--------------------------------------------------------------------*/
+
+int mem_series_close(struct mem_series *ps_ms)
+{
+   int i_status = ps_ms->i_error ? -1 : 0;
+   double d_mean_frag;
+
+   if (ps_ms->ll_calls % ps_ms->ll_interval != 0 && sample(ps_ms) != 0)
+      i_status = -1;
+   if (close(ps_ms->i_fd) != 0)
+      i_status = -1;
+   if (ps_ms->i_statm_fd >= 0)
+      close(ps_ms->i_statm_fd);
+   if (ps_ms->pui_sizes != NULL)
+      munmap(ps_ms->pui_sizes, ps_ms->ui_sizes_cap * sizeof(size_t));
+
+   d_mean_frag = (ps_ms->d_last_t > 0.0)
+      ? ps_ms->d_frag_area / ps_ms->d_last_t : ps_ms->d_last_frag;
+   printf("memory: peak live %zu peak heap %zu peak rss %zu "
+      "overhead %.3f mean frag %.3f samples %lld\n",
+      ps_ms->ui_peak_live, ps_ms->ui_peak_heap, ps_ms->ui_peak_rss,
+      (ps_ms->ui_peak_live > 0)
+         ? (double)ps_ms->ui_peak_heap / (double)ps_ms->ui_peak_live : 0.0,
+      d_mean_frag, ps_ms->ll_samples);
+   ps_ms->i_fd = -1;
+   return i_status;
+}
@@ -0,0 +1,56 @@
+/*--------------------------------------------------------------------*/
+/* memseries.h                                                        */
+/* Sampled memory-efficiency time series for heapmgr drivers          */
+/*--------------------------------------------------------------------*/
+
+#ifndef MEMSERIES_INCLUDED
+#define MEMSERIES_INCLUDED
+
+#include <stddef.h>
+
+/* State of one series.  Everything, including the per-object sizes,
+   lives in mmap()ed memory or on the stack, and output goes through
+   write(), so sampling never calls malloc() and does not disturb an
+   sbrk()-based heap. */
+struct mem_series {
+   int i_fd;                      /* CSV output, -1 if closed */
+   int i_statm_fd;                /* /proc/self/statm, or -1 */
+   long long ll_interval;         /* heapmgr calls between samples */
+   long long ll_calls;            /* heapmgr calls so far */
+   long long ll_samples;
+   int i_error;                   /* a write failed */
+   size_t *pui_sizes;             /* requested bytes, by object id */
+   size_t ui_sizes_cap;
+   size_t ui_live;                /* requested bytes now live */
+   size_t ui_peak_live, ui_peak_heap, ui_peak_rss;
+   char *pc_break0;               /* sbrk(0) when opened */
+   double d_t0;                   /* wall clock when opened */
+   double d_last_t, d_last_frag;  /* previous sample */
+   double d_frag_area;            /* integral of fragmentation dt */
+};
+
+int mem_series_open(struct mem_series *ps_ms, const char *pc_path,
+   long long ll_interval);
+/* Create (or truncate) the CSV file pc_path, write its header line
+   and take the first sample.  A sample is then taken every
+   ll_interval heapmgr calls.  Return 0, or -1 with errno set. */
+
+void mem_series_malloc(struct mem_series *ps_ms, unsigned long ul_id,
+   size_t ui_bytes);
+/* Account for a successful heapmgr_malloc() of ui_bytes bytes, given
+   the object id ul_id (trace_ids_assign()). */
+
+void mem_series_free(struct mem_series *ps_ms, long l_id);
+/* Account for heapmgr_free() of the object with id l_id, or of an
+   unknown object if l_id < 0. */
+
+void mem_series_call(struct mem_series *ps_ms);
+/* Count one heapmgr call and sample if an interval has passed. */
+
+int mem_series_close(struct mem_series *ps_ms);
+/* Take a last sample, close the file and write one summary line to
+   stdout: peak live bytes, peak heap footprint, peak RSS, the peak
+   overhead ratio (peak heap / peak live) and the time-weighted mean
+   fragmentation.  Return 0, or -1 if writing the file failed. */
+
+#endif
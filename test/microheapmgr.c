@@ -0,0 +1,378 @@
+/*--------------------------------------------------------------------*/
+/* microheapmgr.c                                                     */
+/* Micro-benchmarks of the chunk-layer primitives of a heapmgr        */
+/*--------------------------------------------------------------------*/
+
+/* The primitives are static, so the implementation is compiled into
+   this file.  Build with -I src; HEAPMGR_IMPL selects the source. */
+#ifndef HEAPMGR_IMPL
+#define HEAPMGR_IMPL "heapmgr1.c"
+#endif
+#include HEAPMGR_IMPL
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "latency.h"
+
+#define USAGE "Usage: %s [-n blocks] [-r repeats] [-x]\n"
+
+/* Payload units of the free blocks split and coalesced. */
+enum {BIG_UNITS = 62};
+
+/* Payload units split off the big blocks. */
+enum {SPLIT_UNITS = 8};
+
+/* Each batch of sys_grow_and_link() calls grows the heap by this many
+   minimum increments at most. */
+enum {MAX_GROW_BATCH = 1024};
+
+/*--------------------------------------------------------------------*/
+
+/* Prepared heap states.  ah_big are free blocks of BIG_UNITS payload
+   units separated by allocated blocks; ah_target are allocated blocks
+   with allocated neighbours on both sides, and ah_prev/ah_next the
+   free blocks just below and above each of them in the list. */
+static Chunk_T *ah_big;
+static Chunk_T *ah_big_next;
+static Chunk_T *ah_split;
+static Chunk_T *ah_target;
+static Chunk_T *ah_prev;
+static Chunk_T *ah_next;
+
+/* The order in which a batch visits the blocks: address order, or a
+   random permutation with -x. */
+static size_t *aui_order;
+
+static size_t ui_blocks = 4096;
+static int i_repeats = 31;
+static int i_shuffle = FALSE;
+
+/* Per-batch ns/op samples. */
+static double *ad_samples;
+
+/*--------------------------------------------------------------------*/
+
+static Chunk_T free_list_successor(Chunk_T h_c)
+
+/* The free block after h_c in the list, or the list head if h_c is
+   NULL. */
+
+{
+   return (h_c == NULL) ? s_free_head : header_chunk_get_next_free(h_c);
+}
+
+static void build_heap(void)
+
+/* Lay out ui_blocks groups, lowest address first:
+      target | allocated | big free | allocated ...
+   heapmgr_malloc() carves from the top of a free block, so each group
+   is allocated in the opposite order.  The whole layout is carved
+   from one region grown up front, so the free list stays short while
+   it is built.  Then free the big blocks, grow the heap once more so
+   that its last block is free, for bench_grow(), and record each
+   block's free-list neighbours. */
+
+{
+   size_t ui_group_bytes = (3 * 3 + 2 + BIG_UNITS) * CHUNK_UNIT;
+   Chunk_T h_c, h_tail = NULL;
+   size_t i;
+
+   heapmgr_free(heapmgr_malloc(ui_blocks * ui_group_bytes));
+   for (i = 0; i < ui_blocks; i++)
+   {
+      heapmgr_malloc(CHUNK_UNIT);
+      ah_big[i] = header_from_payload(heapmgr_malloc(BIG_UNITS * CHUNK_UNIT));
+      heapmgr_malloc(CHUNK_UNIT);
+      ah_target[i] = header_from_payload(heapmgr_malloc(CHUNK_UNIT));
+   }
+   for (i = 0; i < ui_blocks; i++)
+      heapmgr_free((char *)ah_big[i] + CHUNK_UNIT);
+   for (h_c = s_free_head; h_c != NULL; h_c = header_chunk_get_next_free(h_c))
+      h_tail = h_c;
+   sys_grow_and_link(h_tail, 1);
+   for (i = 0; i < ui_blocks; i++)
+      if (chunk_is_allocated(ah_big[i])
+          || chunk_get_span_units(ah_big[i]) != BIG_UNITS + 2)
+      {
+         fprintf(stderr, "Unexpected heap layout\n");
+         exit(EXIT_FAILURE);
+      }
+
+   /* Merge the targets, in address order, with the free list. */
+   h_c = NULL;
+   for (i = ui_blocks; i-- > 0; )
+   {
+      while (free_list_successor(h_c) != NULL
+             && free_list_successor(h_c) < ah_target[i])
+         h_c = free_list_successor(h_c);
+      ah_prev[i] = h_c;
+      ah_next[i] = free_list_successor(h_c);
+   }
+   for (i = 0; i < ui_blocks; i++)
+      ah_big_next[i] = header_chunk_get_next_free(ah_big[i]);
+
+}
+
+/*--------------------------------------------------------------------*/
+
+static void make_order(void)
+{
+   size_t i;
+
+   for (i = 0; i < ui_blocks; i++)
+      aui_order[i] = i;
+   if (i_shuffle)
+   {
+      unsigned long long ull_state = 0x9E3779B97F4A7C15ull;
+      for (i = ui_blocks - 1; i > 0; i--)
+      {
+         size_t j, ui_tmp;
+         ull_state ^= ull_state << 13;
+         ull_state ^= ull_state >> 7;
+         ull_state ^= ull_state << 17;
+         j = (size_t)(ull_state % (i + 1));
+         ui_tmp = aui_order[i];
+         aui_order[i] = aui_order[j];
+         aui_order[j] = ui_tmp;
+      }
+   }
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Each benchmark times one batch: a call of the primitive on every
+   prepared block, with any work that restores the heap state kept
+   outside the timed region. */
+
+static double bench_split(void)
+
+/* split_for_alloc() on every big free block; restored by freeing the
+   split-off blocks, which coalesce back. */
+
+{
+   double d_start, d_ns;
+   size_t i;
+
+   d_start = now_ns();
+   for (i = 0; i < ui_blocks; i++)
+   {
+      size_t k = aui_order[i];
+      ah_split[k] = split_for_alloc(ah_big[k], SPLIT_UNITS);
+   }
+   d_ns = now_ns() - d_start;
+
+   for (i = 0; i < ui_blocks; i++)
+      freelist_insert_between(ah_big[i], ah_big_next[i], ah_split[i]);
+   return d_ns;
+}
+
+static double bench_coalesce(void)
+
+/* coalesce_two() on pairs of adjacent free blocks.  The pairs are
+   prepared by splitting each big block and linking the split-off part
+   into the list by hand, which the heapmgr itself never leaves. */
+
+{
+   double d_start, d_ns;
+   size_t i;
+
+   for (i = 0; i < ui_blocks; i++)
+   {
+      Chunk_T h_b = split_for_alloc(ah_big[i], SPLIT_UNITS);
+      Chunk_T h_next = header_chunk_get_next_free(ah_big[i]);
+      header_chunk_set_status_free(h_b);
+      header_chunk_set_next_free(h_b, h_next);
+      footer_chunk_set_prev_free(footer_from_header(h_b), ah_big[i]);
+      header_chunk_set_next_free(ah_big[i], h_b);
+      if (h_next != NULL)
+         footer_chunk_set_prev_free(footer_from_header(h_next), h_b);
+      ah_split[i] = h_b;
+   }
+
+   d_start = now_ns();
+   for (i = 0; i < ui_blocks; i++)
+   {
+      size_t k = aui_order[i];
+      coalesce_two(ah_big[k], ah_split[k]);
+   }
+   d_ns = now_ns() - d_start;
+   return d_ns;
+}
+
+static double bench_insert(void)
+
+/* freelist_insert_between() of blocks with no free neighbours, so no
+   coalescing happens; restored with freelist_detach(). */
+
+{
+   double d_start, d_ns;
+   size_t i;
+
+   d_start = now_ns();
+   for (i = 0; i < ui_blocks; i++)
+   {
+      size_t k = aui_order[i];
+      freelist_insert_between(ah_prev[k], ah_next[k], ah_target[k]);
+   }
+   d_ns = now_ns() - d_start;
+
+   for (i = 0; i < ui_blocks; i++)
+      freelist_detach(ah_prev[i], ah_target[i]);
+   return d_ns;
+}
+
+static double bench_detach(void)
+
+/* freelist_detach() of the blocks bench_insert() inserts. */
+
+{
+   double d_start, d_ns;
+   size_t i;
+
+   for (i = 0; i < ui_blocks; i++)
+      freelist_insert_between(ah_prev[i], ah_next[i], ah_target[i]);
+
+   d_start = now_ns();
+   for (i = 0; i < ui_blocks; i++)
+   {
+      size_t k = aui_order[i];
+      freelist_detach(ah_prev[k], ah_target[k]);
+   }
+   d_ns = now_ns() - d_start;
+   return d_ns;
+}
+
+static size_t ui_grow_batch;
+
+static double bench_grow(void)
+
+/* sys_grow_and_link() by the minimum increment.  build_heap() left a
+   free block at the end of the heap, so every growth coalesces into
+   it (the usual case).  Each growth faults in fresh pages.  Restored by
+   shrinking the break and the tail block again. */
+
+{
+   Chunk_T h_tail = NULL, h_c;
+   void *pv_hi = s_heap_hi;
+   size_t ui_span, i;
+   double d_start, d_ns;
+
+   for (h_c = s_free_head; h_c != NULL; h_c = header_chunk_get_next_free(h_c))
+      h_tail = h_c;
+   ui_span = chunk_get_span_units(h_tail);
+
+   d_start = now_ns();
+   for (i = 0; i < ui_grow_batch; i++)
+      sys_grow_and_link(h_tail, 1);
+   d_ns = now_ns() - d_start;
+
+   h_c = footer_chunk_get_prev_free(footer_from_header(h_tail));
+   header_chunk_set_span_units(h_tail, ui_span);
+   footer_chunk_set_prev_free(footer_from_header(h_tail), h_c);
+   sbrk(-((char *)s_heap_hi - (char *)pv_hi));
+   s_heap_hi = pv_hi;
+   return d_ns;
+}
+
+/*--------------------------------------------------------------------*/
+
+static int compare_doubles(const void *pv_a, const void *pv_b)
+{
+   double d_a = *(const double *)pv_a, d_b = *(const double *)pv_b;
+   return (d_a > d_b) - (d_a < d_b);
+}
+
+/*--------------------------------------------------------------------*/
+
+static void run(const char *pc_name, double (*pf_batch)(void), size_t ui_ops)
+
+/* Run one warm-up batch and i_repeats timed batches of pf_batch, each
+   ui_ops calls, and print min, median, mean and the 95% confidence
+   half-width of the mean, in ns per call. */
+
+{
+   double d_sum = 0.0, d_sq = 0.0, d_mean, d_ci = 0.0;
+   int i;
+
+   (*pf_batch)();
+   for (i = 0; i < i_repeats; i++)
+   {
+      ad_samples[i] = (*pf_batch)() / (double)ui_ops;
+      d_sum += ad_samples[i];
+   }
+   d_mean = d_sum / i_repeats;
+   for (i = 0; i < i_repeats; i++)
+      d_sq += (ad_samples[i] - d_mean) * (ad_samples[i] - d_mean);
+   if (i_repeats > 1)
+      d_ci = t_critical_95(i_repeats - 1) * sqrt(d_sq / (i_repeats - 1))
+         / sqrt((double)i_repeats);
+   qsort(ad_samples, (size_t)i_repeats, sizeof(double), compare_doubles);
+
+   printf("%24s %8zu %8d %9.2f %9.2f %9.2f %8.2f\n", pc_name, ui_ops,
+      i_repeats, ad_samples[0], ad_samples[i_repeats / 2], d_mean, d_ci);
+   fflush(stdout);
+
+   /* The restore steps must leave the heap exactly as prepared. */
+   assert(check_heap_validity());
+}
+
+/*--------------------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+
+/* Prepare a heap with -n blocks groups (default 4096) and time
+   split_for_alloc(), coalesce_two(), freelist_insert_between(),
+   freelist_detach() and sys_grow_and_link() on it in batches of one
+   call per group (sys_grow_and_link(): at most MAX_GROW_BATCH), -r
+   batches each (default 31).  -x visits the blocks in random order
+   instead of address order, so that the cache misses of a large,
+   scattered free list show up. */
+
+{
+   int i;
+
+   for (i = 1; i < argc; i++)
+   {
+      if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+         ui_blocks = (size_t)strtoul(argv[++i], NULL, 10);
+      else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+         i_repeats = atoi(argv[++i]);
+      else if (strcmp(argv[i], "-x") == 0)
+         i_shuffle = TRUE;
+      else
+         break;
+   }
+   if (i < argc || ui_blocks == 0 || i_repeats < 1)
+   {
+      fprintf(stderr, USAGE, argv[0]);
+      return EXIT_FAILURE;
+   }
+
+   ah_big = map_array(ui_blocks * sizeof(Chunk_T));
+   ah_big_next = map_array(ui_blocks * sizeof(Chunk_T));
+   ah_split = map_array(ui_blocks * sizeof(Chunk_T));
+   ah_target = map_array(ui_blocks * sizeof(Chunk_T));
+   ah_prev = map_array(ui_blocks * sizeof(Chunk_T));
+   ah_next = map_array(ui_blocks * sizeof(Chunk_T));
+   aui_order = map_array(ui_blocks * sizeof(size_t));
+   ad_samples = map_array((size_t)i_repeats * sizeof(double));
+   ui_grow_batch = (ui_blocks < MAX_GROW_BATCH) ? ui_blocks : MAX_GROW_BATCH;
+
+   /* Print before the heap exists, so stdout's buffer is not
+      allocated in the middle of it. */
+   printf("%24s %8s %8s %9s %9s %9s %8s   (ns/call, %s order)\n",
+      "Primitive", "Calls", "Batches", "Min", "Median", "Mean", "CI95",
+      i_shuffle ? "random" : "address");
+   fflush(stdout);
+
+   build_heap();
+   make_order();
+
+   run("split_for_alloc", bench_split, ui_blocks);
+   run("coalesce_two", bench_coalesce, ui_blocks);
+   run("freelist_insert_between", bench_insert, ui_blocks);
+   run("freelist_detach", bench_detach, ui_blocks);
+   run("sys_grow_and_link", bench_grow, ui_grow_batch);
+   return 0;
+}
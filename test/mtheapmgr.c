@@ -0,0 +1,422 @@
+/*--------------------------------------------------------------------*/
+/* mtheapmgr.c                                                        */
+/* Multi-threaded scalability benchmarks for a heapmgr engine         */
+/*--------------------------------------------------------------------*/
+
+#include "heapmgr.h"
+#include "latency.h"
+#include "workload.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+enum {FALSE, TRUE};
+
+#define USAGE "Usage: %s scenario maxthreads ops size\n"
+
+enum {MAX_THREADS = 256};
+
+/* Objects each thread keeps in test_private(). */
+enum {PRIVATE_SLOTS = 1024};
+
+/* Capacity of each producer/consumer ring. */
+enum {RING_SLOTS = 1024};
+
+/* Objects shared by all threads in test_larson(). */
+enum {LARSON_SLOTS = 8192};
+
+/* Writes to each object in test_false_sharing(). */
+enum {FALSE_SHARING_WRITES = 100};
+
+enum {CACHE_LINE = 64};
+
+/*--------------------------------------------------------------------*/
+
+/* Per-thread state.  Padded so that the benchmark's own bookkeeping
+   does not false-share. */
+struct worker {
+   pthread_t s_thread;
+   int i_index;
+   int i_threads;
+   long l_ops;
+   int i_size;
+   struct prng s_rng;
+   unsigned long long ull_done;     /* heapmgr calls made */
+   struct timespec s_start, s_end;
+   char ac_pad[CACHE_LINE];
+};
+
+/* Single-producer single-consumer ring for test_prodcons(). */
+struct ring {
+   unsigned long ul_head;            /* written by the producer */
+   char ac_pad1[CACHE_LINE - sizeof(unsigned long)];
+   unsigned long ul_tail;            /* written by the consumer */
+   char ac_pad2[CACHE_LINE - sizeof(unsigned long)];
+   void *apv[RING_SLOTS];
+};
+
+typedef void (*scenario_function)(struct worker *);
+
+static struct worker as_workers[MAX_THREADS];
+static struct ring *ps_rings;        /* one per producer/consumer pair */
+static void *apv_shared[LARSON_SLOTS];
+static pthread_barrier_t s_start;
+static scenario_function pf_scenario;
+
+/* TRUE if every heapmgr call must hold s_heap_lock. */
+static int i_serialize;
+static pthread_mutex_t s_heap_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*--------------------------------------------------------------------*/
+
+static void *bench_malloc(size_t ui_bytes)
+
+/* heapmgr_malloc(), under the global lock unless the engine declares
+   itself thread-safe. */
+
+{
+   void *pv;
+
+   if (!i_serialize)
+      return heapmgr_malloc(ui_bytes);
+   pthread_mutex_lock(&s_heap_lock);
+   pv = heapmgr_malloc(ui_bytes);
+   pthread_mutex_unlock(&s_heap_lock);
+   return pv;
+}
+
+static void bench_free(void *pv)
+{
+   if (!i_serialize)
+   {
+      heapmgr_free(pv);
+      return;
+   }
+   pthread_mutex_lock(&s_heap_lock);
+   heapmgr_free(pv);
+   pthread_mutex_unlock(&s_heap_lock);
+}
+
+/*--------------------------------------------------------------------*/
+
+static size_t rand_size(struct worker *ps_w)
+{
+   return (size_t)(prng_next(&ps_w->s_rng) % (unsigned)ps_w->i_size) + 1;
+}
+
+/*--------------------------------------------------------------------*/
+
+static void test_private(struct worker *ps_w)
+
+/* Each thread randomly allocates and frees objects of random size
+   that no other thread touches. */
+
+{
+   void **ppv = map_array(PRIVATE_SLOTS * sizeof(void *));
+   long l;
+   int i;
+
+   for (l = 0; l < ps_w->l_ops; l++)
+   {
+      i = (int)(prng_next(&ps_w->s_rng) % PRIVATE_SLOTS);
+      if (ppv[i] != NULL)
+      {
+         bench_free(ppv[i]);
+         ppv[i] = NULL;
+      }
+      else
+      {
+         ppv[i] = bench_malloc(rand_size(ps_w));
+         ((char *)ppv[i])[0] = 1;
+      }
+      ps_w->ull_done++;
+   }
+   for (i = 0; i < PRIVATE_SLOTS; i++)
+      if (ppv[i] != NULL)
+      {
+         bench_free(ppv[i]);
+         ps_w->ull_done++;
+      }
+   munmap(ppv, PRIVATE_SLOTS * sizeof(void *));
+}
+
+/*--------------------------------------------------------------------*/
+
+static void test_prodcons(struct worker *ps_w)
+
+/* Threads 2k and 2k+1 form a pair: the even thread allocates l_ops
+   objects and hands them over a ring, the odd thread frees them.
+   With one thread, the same thread fills and drains the ring in
+   turn.  An unpaired last thread runs test_private(). */
+
+{
+   struct ring *ps_r = &ps_rings[ps_w->i_index / 2];
+   int i_producer = (ps_w->i_index % 2 == 0);
+   long l;
+
+   if (ps_w->i_threads == 1)
+   {
+      for (l = 0; l < ps_w->l_ops; )
+      {
+         int i, n = 0;
+         for (; n < RING_SLOTS && l < ps_w->l_ops; n++, l++)
+            ps_r->apv[n] = bench_malloc(rand_size(ps_w));
+         for (i = 0; i < n; i++)
+            bench_free(ps_r->apv[i]);
+         ps_w->ull_done += 2 * (unsigned long long)n;
+      }
+      return;
+   }
+   if (ps_w->i_threads % 2 == 1 && ps_w->i_index == ps_w->i_threads - 1)
+   {
+      test_private(ps_w);
+      return;
+   }
+
+   for (l = 0; l < ps_w->l_ops; l++)
+   {
+      if (i_producer)
+      {
+         void *pv = bench_malloc(rand_size(ps_w));
+         unsigned long ul_head = ps_r->ul_head;
+         ((char *)pv)[0] = 1;
+         while (ul_head - __atomic_load_n(&ps_r->ul_tail, __ATOMIC_ACQUIRE)
+                == RING_SLOTS)
+            sched_yield();
+         ps_r->apv[ul_head % RING_SLOTS] = pv;
+         __atomic_store_n(&ps_r->ul_head, ul_head + 1, __ATOMIC_RELEASE);
+      }
+      else
+      {
+         unsigned long ul_tail = ps_r->ul_tail;
+         while (__atomic_load_n(&ps_r->ul_head, __ATOMIC_ACQUIRE) == ul_tail)
+            sched_yield();
+         bench_free(ps_r->apv[ul_tail % RING_SLOTS]);
+         __atomic_store_n(&ps_r->ul_tail, ul_tail + 1, __ATOMIC_RELEASE);
+      }
+      ps_w->ull_done++;
+   }
+}
+
+/*--------------------------------------------------------------------*/
+
+static void test_larson(struct worker *ps_w)
+
+/* Larson-style server simulation: every thread allocates an object,
+   swaps it into a random slot of a table shared by all threads, and
+   frees whatever was there, which was usually allocated by another
+   thread. */
+
+{
+   long l;
+
+   for (l = 0; l < ps_w->l_ops; l++)
+   {
+      void *pv = bench_malloc(rand_size(ps_w));
+      void *pv_old;
+      unsigned i = (unsigned)(prng_next(&ps_w->s_rng) % LARSON_SLOTS);
+
+      ((char *)pv)[0] = 1;
+      pv_old = __atomic_exchange_n(&apv_shared[i], pv, __ATOMIC_ACQ_REL);
+      ps_w->ull_done++;
+      if (pv_old != NULL)
+      {
+         bench_free(pv_old);
+         ps_w->ull_done++;
+      }
+   }
+}
+
+/*--------------------------------------------------------------------*/
+
+static void test_false_sharing(struct worker *ps_w)
+
+/* Active false sharing: each thread repeatedly allocates a small
+   object, writes it FALSE_SHARING_WRITES times and frees it.  An
+   allocator that hands neighbouring bytes of one cache line to
+   different threads makes these writes contend, which shows up as
+   poor scaling even though no data is shared. */
+
+{
+   long l;
+   int k;
+
+   for (l = 0; l < ps_w->l_ops; l++)
+   {
+      volatile char *pc = bench_malloc(8);
+      for (k = 0; k < FALSE_SHARING_WRITES; k++)
+         pc[k % 8]++;
+      bench_free((void *)pc);
+      ps_w->ull_done += 2;
+   }
+}
+
+/*--------------------------------------------------------------------*/
+
+static char *apc_scenario_name[] =
+{
+   "private", "prodcons", "larson", "falseshare"
+};
+
+static scenario_function apf_scenario[] =
+{
+   test_private, test_prodcons, test_larson, test_false_sharing
+};
+
+/*--------------------------------------------------------------------*/
+
+static void *worker_main(void *pv)
+{
+   struct worker *ps_w = pv;
+   pthread_barrier_wait(&s_start);
+   clock_gettime(CLOCK_MONOTONIC, &ps_w->s_start);
+   (*pf_scenario)(ps_w);
+   clock_gettime(CLOCK_MONOTONIC, &ps_w->s_end);
+   return NULL;
+}
+
+/*--------------------------------------------------------------------*/
+
+static double run(int i_threads, long l_ops, int i_size,
+   unsigned long long *pull_done)
+
+/* Run pf_scenario on i_threads threads, each asked for l_ops
+   operations, and return the elapsed wall time in seconds, from the
+   first thread starting to the last one finishing.  All threads are
+   created first and released together by a barrier; each takes its
+   own timestamps, since on a loaded machine the main thread may not
+   run again until the workers are done. */
+
+{
+   double d_t0 = 0.0, d_t1 = 0.0;
+   int i;
+
+   memset(apv_shared, 0, sizeof(apv_shared));
+   memset(ps_rings, 0, (size_t)(MAX_THREADS / 2 + 1) * sizeof(struct ring));
+   pthread_barrier_init(&s_start, NULL, (unsigned)i_threads + 1);
+   for (i = 0; i < i_threads; i++)
+   {
+      struct worker *ps_w = &as_workers[i];
+      ps_w->i_index = i;
+      ps_w->i_threads = i_threads;
+      ps_w->l_ops = l_ops;
+      ps_w->i_size = i_size;
+      prng_seed(&ps_w->s_rng, (unsigned long long)i);
+      ps_w->ull_done = 0;
+      if (pthread_create(&ps_w->s_thread, NULL, worker_main, ps_w) != 0)
+      {
+         fprintf(stderr, "pthread_create failed\n");
+         exit(EXIT_FAILURE);
+      }
+   }
+   pthread_barrier_wait(&s_start);
+   *pull_done = 0;
+   for (i = 0; i < i_threads; i++)
+   {
+      struct worker *ps_w = &as_workers[i];
+      double d_start, d_end;
+      pthread_join(ps_w->s_thread, NULL);
+      *pull_done += ps_w->ull_done;
+      d_start = (double)ps_w->s_start.tv_sec + (double)ps_w->s_start.tv_nsec / 1e9;
+      d_end = (double)ps_w->s_end.tv_sec + (double)ps_w->s_end.tv_nsec / 1e9;
+      if (i == 0 || d_start < d_t0)
+         d_t0 = d_start;
+      if (i == 0 || d_end > d_t1)
+         d_t1 = d_end;
+   }
+   pthread_barrier_destroy(&s_start);
+
+   /* Objects still parked in the Larson table. */
+   for (i = 0; i < LARSON_SLOTS; i++)
+      if (apv_shared[i] != NULL)
+         bench_free(apv_shared[i]);
+
+   return d_t1 - d_t0;
+}
+
+/*--------------------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+
+/* Run the scenario argv[1] ("private", "prodcons", "larson",
+   "falseshare" or "all") with 1, 2, 4, ... threads up to argv[2]
+   (argv[2] itself always included).  Each thread performs argv[3]
+   operations on objects of at most argv[4] bytes.  For every thread
+   count print the heapmgr calls made, the wall time, calls per
+   second, and the scaling efficiency: rate / (threads * rate at one
+   thread).  Engines that do not define heapmgr_thread_safe run
+   under one global lock. */
+
+{
+   int i_max_threads, i_size, i_threads, i_first, i_last, i;
+   long l_ops;
+   int i_count = (int)(sizeof(apc_scenario_name) / sizeof(apc_scenario_name[0]));
+
+   if (argc != 5 || sscanf(argv[2], "%d", &i_max_threads) != 1
+       || sscanf(argv[3], "%ld", &l_ops) != 1
+       || sscanf(argv[4], "%d", &i_size) != 1
+       || i_max_threads < 1 || i_max_threads > MAX_THREADS
+       || l_ops <= 0 || i_size <= 0)
+   {
+      fprintf(stderr, USAGE, argv[0]);
+      fprintf(stderr, "maxthreads must be 1..%d; ops and size positive\n",
+         MAX_THREADS);
+      return EXIT_FAILURE;
+   }
+   if (strcmp(argv[1], "all") == 0)
+   {
+      i_first = 0;
+      i_last = i_count - 1;
+   }
+   else
+   {
+      for (i = 0; i < i_count; i++)
+         if (strcmp(argv[1], apc_scenario_name[i]) == 0)
+            break;
+      if (i == i_count)
+      {
+         fprintf(stderr, USAGE, argv[0]);
+         fprintf(stderr, "Valid scenarios: all");
+         for (i = 0; i < i_count; i++)
+            fprintf(stderr, " %s", apc_scenario_name[i]);
+         fprintf(stderr, "\n");
+         return EXIT_FAILURE;
+      }
+      i_first = i_last = i;
+   }
+
+   i_serialize = !(&heapmgr_thread_safe != NULL && heapmgr_thread_safe);
+   ps_rings = map_array((size_t)(MAX_THREADS / 2 + 1) * sizeof(struct ring));
+
+   printf("%17s %10s %7s %12s %8s %12s %6s%s\n", "Executable", "Scenario",
+      "Threads", "Calls", "Time", "Calls/s", "Eff",
+      i_serialize ? "  (global lock)" : "");
+   fflush(stdout);
+
+   for (i = i_first; i <= i_last; i++)
+   {
+      double d_base_rate = 0.0;
+      pf_scenario = apf_scenario[i];
+      for (i_threads = 1; ; )
+      {
+         unsigned long long ull_done;
+         double d_time = run(i_threads, l_ops, i_size, &ull_done);
+         double d_rate = d_time > 0.0 ? (double)ull_done / d_time : 0.0;
+         if (i_threads == 1)
+            d_base_rate = d_rate;
+         printf("%17s %10s %7d %12llu %8.3f %12.0f %6.2f\n", argv[0],
+            apc_scenario_name[i], i_threads, ull_done, d_time, d_rate,
+            d_base_rate > 0.0 ? d_rate / (i_threads * d_base_rate) : 0.0);
+         fflush(stdout);
+         if (i_threads == i_max_threads)
+            break;
+         i_threads = (i_threads * 2 > i_max_threads) ? i_max_threads : i_threads * 2;
+      }
+   }
+   return 0;
+}
@@ -0,0 +1,309 @@
+/*--------------------------------------------------------------------*/
+/* persistheapmgr.c                                                   */
+/* Startup time: reopening a file-backed heap versus rebuilding it    */
+/*--------------------------------------------------------------------*/
+
+#include "heapmgr.h"
+#include "heapmgrpersist.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define USAGE "Usage: %s [-n objects] [-f file] [-k]\n"
+
+/* Value lengths are 8 .. 8 + VALUE_SPREAD - 1 bytes. */
+enum {VALUE_SPREAD = 49};
+
+/*--------------------------------------------------------------------*/
+
+/* The cache: a chained hash table whose buckets and entries all live
+   in the heap and refer to each other by offset.  The root block is
+   the struct cache. */
+struct cache {
+   size_t ui_buckets;         /* a power of 2 */
+   size_t ui_entries;
+   size_t ui_table;           /* offset of size_t[ui_buckets] */
+};
+
+struct entry {
+   size_t ui_next;            /* offset of the next entry, or 0 */
+   unsigned long ul_key;
+   unsigned ui_len;
+   unsigned char auc_value[];
+};
+
+/*--------------------------------------------------------------------*/
+
+static double now_ms(void)
+{
+   struct timespec s_now;
+   clock_gettime(CLOCK_MONOTONIC, &s_now);
+   return (double)s_now.tv_sec * 1e3 + (double)s_now.tv_nsec / 1e6;
+}
+
+static unsigned long key_of(size_t ui_i)
+{
+   return (unsigned long)(ui_i + 1) * 0x9e3779b97f4a7c15ul;
+}
+
+static unsigned char value_byte(unsigned long ul_key, unsigned ui_j)
+{
+   return (unsigned char)((ul_key >> 24) + ui_j * 31);
+}
+
+/*--------------------------------------------------------------------*/
+
+static void cache_insert(struct cache *ps_cache, unsigned long ul_key)
+
+/* Allocate an entry for ul_key, with a value derived from the key so
+   that it can be checked later, and link it into its bucket. */
+
+{
+   size_t *pui_table = heapmgr_persist_pointer(ps_cache->ui_table);
+   size_t ui_b = ul_key & (ps_cache->ui_buckets - 1);
+   unsigned ui_len = 8 + (unsigned)(ul_key % VALUE_SPREAD), ui_j;
+   struct entry *ps_e = heapmgr_malloc(sizeof(*ps_e) + ui_len);
+
+   if (ps_e == NULL)
+   {
+      fprintf(stderr, "heapmgr_malloc failed\n");
+      exit(EXIT_FAILURE);
+   }
+   ps_e->ul_key = ul_key;
+   ps_e->ui_len = ui_len;
+   for (ui_j = 0; ui_j < ui_len; ui_j++)
+      ps_e->auc_value[ui_j] = value_byte(ul_key, ui_j);
+   ps_e->ui_next = pui_table[ui_b];
+   pui_table[ui_b] = heapmgr_persist_offset(ps_e);
+   ps_cache->ui_entries++;
+}
+
+static int cache_remove(struct cache *ps_cache, unsigned long ul_key)
+
+/* Unlink and free the entry for ul_key.  Return 1 if there was one. */
+
+{
+   size_t *pui_link = (size_t *)heapmgr_persist_pointer(ps_cache->ui_table)
+      + (ul_key & (ps_cache->ui_buckets - 1));
+   struct entry *ps_e;
+
+   for (; *pui_link != 0; pui_link = &ps_e->ui_next)
+   {
+      ps_e = heapmgr_persist_pointer(*pui_link);
+      if (ps_e->ul_key == ul_key)
+      {
+         *pui_link = ps_e->ui_next;
+         heapmgr_free(ps_e);
+         ps_cache->ui_entries--;
+         return 1;
+      }
+   }
+   return 0;
+}
+
+static int cache_check(const struct cache *ps_cache, unsigned long ul_key)
+
+/* Return 1 if ul_key is present with the value it was given. */
+
+{
+   const size_t *pui_table = heapmgr_persist_pointer(ps_cache->ui_table);
+   size_t ui_off = pui_table[ul_key & (ps_cache->ui_buckets - 1)];
+   unsigned ui_j;
+
+   while (ui_off != 0)
+   {
+      const struct entry *ps_e = heapmgr_persist_pointer(ui_off);
+      if (ps_e->ul_key == ul_key)
+      {
+         if (ps_e->ui_len != 8 + (unsigned)(ul_key % VALUE_SPREAD))
+            return 0;
+         for (ui_j = 0; ui_j < ps_e->ui_len; ui_j++)
+            if (ps_e->auc_value[ui_j] != value_byte(ul_key, ui_j))
+               return 0;
+         return 1;
+      }
+      ui_off = ps_e->ui_next;
+   }
+   return 0;
+}
+
+/*--------------------------------------------------------------------*/
+
+static void build(size_t ui_objects)
+
+/* Create the cache with ui_objects entries in the open, empty heap and
+   make it the root. */
+
+{
+   struct cache *ps_cache = heapmgr_malloc(sizeof(*ps_cache));
+   size_t *pui_table, ui_i;
+
+   ps_cache->ui_buckets = 1;
+   while (ps_cache->ui_buckets < ui_objects)
+      ps_cache->ui_buckets *= 2;
+   ps_cache->ui_entries = 0;
+   pui_table = heapmgr_malloc(ps_cache->ui_buckets * sizeof(size_t));
+   if (pui_table == NULL)
+   {
+      fprintf(stderr, "heapmgr_malloc failed\n");
+      exit(EXIT_FAILURE);
+   }
+   memset(pui_table, 0, ps_cache->ui_buckets * sizeof(size_t));
+   ps_cache->ui_table = heapmgr_persist_offset(pui_table);
+   heapmgr_persist_set_root(ps_cache);
+
+   for (ui_i = 0; ui_i < ui_objects; ui_i++)
+      cache_insert(ps_cache, key_of(ui_i));
+}
+
+static void verify(size_t ui_objects, const char *pc_when)
+
+/* Check that the root cache holds exactly the ui_objects original
+   entries, or exit. */
+
+{
+   struct cache *ps_cache = heapmgr_persist_get_root();
+   size_t ui_i;
+
+   if (ps_cache == NULL || ps_cache->ui_entries != ui_objects)
+   {
+      fprintf(stderr, "%s: cache root or size is wrong\n", pc_when);
+      exit(EXIT_FAILURE);
+   }
+   for (ui_i = 0; ui_i < ui_objects; ui_i++)
+      if (!cache_check(ps_cache, key_of(ui_i)))
+      {
+         fprintf(stderr, "%s: entry %zu is missing or wrong\n", pc_when, ui_i);
+         exit(EXIT_FAILURE);
+      }
+}
+
+static void open_expect(const char *pc_path, int i_expect)
+{
+   int i_result = heapmgr_persist_open(pc_path, 0);
+   if (i_result != i_expect)
+   {
+      if (i_result < 0)
+         perror(pc_path);
+      else
+         fprintf(stderr, "%s: opened with result %d, expected %d\n",
+            pc_path, i_result, i_expect);
+      exit(EXIT_FAILURE);
+   }
+}
+
+static void crash_child(const char *pc_path, size_t ui_objects)
+
+/* In a child process: reopen the heap, replace a tenth of the entries
+   with the same keys and values, and exit without closing, like a
+   process that crashed.  The heap is then not marked clean. */
+
+{
+   pid_t i_pid = fork();
+   int i_status;
+   size_t ui_i;
+
+   if (i_pid < 0)
+   {
+      perror("fork");
+      exit(EXIT_FAILURE);
+   }
+   if (i_pid == 0)
+   {
+      struct cache *ps_cache;
+      open_expect(pc_path, HEAPMGR_PERSIST_REOPENED);
+      ps_cache = heapmgr_persist_get_root();
+      for (ui_i = 0; ui_i < ui_objects; ui_i += 10)
+      {
+         if (!cache_remove(ps_cache, key_of(ui_i)))
+            _exit(EXIT_FAILURE);
+         cache_insert(ps_cache, key_of(ui_i));
+      }
+      _exit(0);
+   }
+   if (waitpid(i_pid, &i_status, 0) != i_pid
+       || !WIFEXITED(i_status) || WEXITSTATUS(i_status) != 0)
+   {
+      fprintf(stderr, "crash child failed\n");
+      exit(EXIT_FAILURE);
+   }
+}
+
+/*--------------------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+
+/* Build a cache of -n objects small entries (default 1000000) in the
+   file-backed heap -f file (default /tmp/persistheapmgr.heap), which
+   is the work a restart without persistence repeats.  Then close the
+   heap and time reopening it, and time reopening it after a child
+   process modified it and exited without closing (the recovery scan).
+   The cache is verified after each reopen, outside the timings.  The
+   file is removed at the end unless -k is given. */
+
+{
+   const char *pc_path = "/tmp/persistheapmgr.heap";
+   size_t ui_objects = 1000000;
+   int i_keep = 0, i;
+   double d_start, d_build, d_close, d_reopen, d_recover;
+   struct heapmgr_stats s_stats;
+
+   for (i = 1; i < argc; i++)
+   {
+      if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+         ui_objects = (size_t)strtoul(argv[++i], NULL, 10);
+      else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc)
+         pc_path = argv[++i];
+      else if (strcmp(argv[i], "-k") == 0)
+         i_keep = 1;
+      else
+         break;
+   }
+   if (i < argc || ui_objects == 0)
+   {
+      fprintf(stderr, USAGE, argv[0]);
+      return EXIT_FAILURE;
+   }
+
+   unlink(pc_path);
+   d_start = now_ms();
+   open_expect(pc_path, HEAPMGR_PERSIST_CREATED);
+   build(ui_objects);
+   d_build = now_ms() - d_start;
+   heapmgr_stats(&s_stats);
+
+   d_start = now_ms();
+   if (heapmgr_persist_close() != 0)
+   {
+      perror("heapmgr_persist_close");
+      return EXIT_FAILURE;
+   }
+   d_close = now_ms() - d_start;
+
+   d_start = now_ms();
+   open_expect(pc_path, HEAPMGR_PERSIST_REOPENED);
+   d_reopen = now_ms() - d_start;
+   verify(ui_objects, "reopen");
+   heapmgr_persist_close();
+
+   crash_child(pc_path, ui_objects);
+   d_start = now_ms();
+   open_expect(pc_path, HEAPMGR_PERSIST_RECOVERED);
+   d_recover = now_ms() - d_start;
+   verify(ui_objects, "recovery");
+   heapmgr_persist_close();
+
+   printf("objects %zu, heap %.1f MB\n", ui_objects,
+      (double)s_stats.ui_heap_bytes / 1e6);
+   printf("%-28s %10.2f ms\n", "rebuild (malloc + fill)", d_build);
+   printf("%-28s %10.2f ms\n", "close (msync)", d_close);
+   printf("%-28s %10.2f ms\n", "reopen, clean", d_reopen);
+   printf("%-28s %10.2f ms\n", "reopen, recovery scan", d_recover);
+
+   if (!i_keep)
+      unlink(pc_path);
+   return 0;
+}
@@ -0,0 +1,200 @@
+/*--------------------------------------------------------------------*/
+/* replayheapmgr.c                                                    */
+/* Stream a recorded allocation trace through a heapmgr engine        */
+/*--------------------------------------------------------------------*/
+
+#define _GNU_SOURCE             /* for mremap() */
+#include "heapmgr.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+
+enum {FALSE, TRUE};
+
+#define USAGE "Usage: %s tracefile [-i interval]\n"
+
+/* Default number of operations between two progress samples. */
+enum {DEFAULT_INTERVAL = 1000000};
+
+/* One live object of the trace, indexed by its id. */
+struct slot {
+   char *pc;
+   size_t ui_size;
+};
+
+/* The id table lives in mmap()ed memory, not on the heap under test,
+   and grows with mremap() as larger ids appear.  The trace reader's
+   buffer is static for the same reason. */
+static struct slot *ps_slots = NULL;
+static size_t ui_slot_cap = 0;
+static struct trace_reader s_reader;
+
+/*--------------------------------------------------------------------*/
+
+static double now_sec(void)
+{
+   struct timespec s_ts;
+   clock_gettime(CLOCK_MONOTONIC, &s_ts);
+   return (double)s_ts.tv_sec + (double)s_ts.tv_nsec / 1e9;
+}
+
+/*--------------------------------------------------------------------*/
+
+static void ensure_slot(unsigned long ul_id)
+
+/* Make ps_slots[ul_id] addressable.  Exit if memory runs out. */
+
+{
+   size_t ui_new_cap;
+   void *pv;
+
+   if (ul_id < ui_slot_cap)
+      return;
+   ui_new_cap = ui_slot_cap ? ui_slot_cap : 65536;
+   while (ui_new_cap <= ul_id)
+      ui_new_cap *= 2;
+   if (ps_slots == NULL)
+      pv = mmap(NULL, ui_new_cap * sizeof(struct slot),
+         PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+   else
+      pv = mremap(ps_slots, ui_slot_cap * sizeof(struct slot),
+         ui_new_cap * sizeof(struct slot), MREMAP_MAYMOVE);
+   if (pv == MAP_FAILED)
+   {
+      fprintf(stderr, "Out of memory for %lu trace ids\n", ul_id + 1);
+      exit(EXIT_FAILURE);
+   }
+   ps_slots = pv;
+   ui_slot_cap = ui_new_cap;
+}
+
+/*--------------------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+
+/* Replay the trace argv[1] against the linked heapmgr.  Every
+   interval operations (-i, default DEFAULT_INTERVAL), print a sample
+   line: operations so far, replay seconds, live requested bytes, heap
+   footprint from heapmgr_stats(), and fragmentation, defined as
+   1 - live / heap.  At the end print the totals, the peak heap and
+   peak live bytes, and the mean fragmentation over the samples taken
+   while anything was live.
+   The time spent taking samples is excluded from the replay time. */
+
+{
+   const char *pc_path;
+   long l_interval = DEFAULT_INTERVAL;
+   struct trace_rec s_rec;
+   struct heapmgr_stats s_stats;
+   unsigned long long ull_ops = 0, ull_mallocs = 0, ull_frees = 0;
+   unsigned long long ull_failed = 0, ull_bad_frees = 0;
+   size_t ui_live = 0, ui_peak_live = 0, ui_peak_heap = 0;
+   double d_frag_sum = 0.0;
+   unsigned long long ull_frag_samples = 0;
+   double d_start, d_sample_time = 0.0, d_elapsed;
+   int i, i_ret;
+
+   if (argc < 2)
+   {
+      fprintf(stderr, USAGE, argv[0]);
+      return EXIT_FAILURE;
+   }
+   pc_path = argv[1];
+   for (i = 2; i < argc; i++)
+   {
+      if (strcmp(argv[i], "-i") == 0 && i + 1 < argc
+          && sscanf(argv[i + 1], "%ld", &l_interval) == 1 && l_interval > 0)
+         i++;
+      else
+      {
+         fprintf(stderr, USAGE, argv[0]);
+         return EXIT_FAILURE;
+      }
+   }
+
+   if (trace_reader_open(&s_reader, pc_path) != 0)
+   {
+      perror(pc_path);
+      return EXIT_FAILURE;
+   }
+
+   /* Print before replaying so stdio allocates its buffer first. */
+   printf("%-12s %10s %14s %14s %6s\n",
+      "ops", "seconds", "live", "heap", "frag");
+   fflush(stdout);
+
+   d_start = now_sec();
+   while ((i_ret = trace_read(&s_reader, &s_rec)) == 1)
+   {
+      ensure_slot(s_rec.ul_id);
+      if (s_rec.i_op == TRACE_MALLOC)
+      {
+         struct slot *ps = &ps_slots[s_rec.ul_id];
+         ps->pc = heapmgr_malloc(s_rec.ui_size);
+         ps->ui_size = s_rec.ui_size;
+         if (ps->pc == NULL)
+            ull_failed++;
+         else
+            ui_live += s_rec.ui_size;
+         if (ui_live > ui_peak_live)
+            ui_peak_live = ui_live;
+         ull_mallocs++;
+      }
+      else
+      {
+         struct slot *ps = &ps_slots[s_rec.ul_id];
+         if (ps->pc == NULL)
+            ull_bad_frees++;
+         else
+         {
+            heapmgr_free(ps->pc);
+            ui_live -= ps->ui_size;
+            ps->pc = NULL;
+         }
+         ull_frees++;
+      }
+
+      if (++ull_ops % (unsigned long long)l_interval == 0)
+      {
+         double d_t0 = now_sec();
+         double d_frag;
+
+         heapmgr_stats(&s_stats);
+         if (s_stats.ui_heap_bytes > ui_peak_heap)
+            ui_peak_heap = s_stats.ui_heap_bytes;
+         d_frag = s_stats.ui_heap_bytes
+            ? 1.0 - (double)ui_live / (double)s_stats.ui_heap_bytes : 0.0;
+         if (ui_live != 0)
+         {
+            d_frag_sum += d_frag;
+            ull_frag_samples++;
+         }
+         printf("%-12llu %10.3f %14zu %14zu %6.3f\n", ull_ops,
+            d_t0 - d_start - d_sample_time, ui_live,
+            s_stats.ui_heap_bytes, d_frag);
+         fflush(stdout);
+         d_sample_time += now_sec() - d_t0;
+      }
+   }
+   d_elapsed = now_sec() - d_start - d_sample_time;
+   trace_reader_close(&s_reader);
+
+   if (i_ret < 0)
+      fprintf(stderr, "%s: truncated or unreadable trace after %llu ops\n",
+         pc_path, ull_ops);
+
+   heapmgr_stats(&s_stats);
+   if (s_stats.ui_heap_bytes > ui_peak_heap)
+      ui_peak_heap = s_stats.ui_heap_bytes;
+
+   printf("%17s ops %llu mallocs %llu frees %llu failed %llu bad_frees %llu\n",
+      argv[0], ull_ops, ull_mallocs, ull_frees, ull_failed, ull_bad_frees);
+   printf("%17s time %.3f peak_heap %zu peak_live %zu mean_frag %.3f\n",
+      argv[0], d_elapsed, ui_peak_heap, ui_peak_live,
+      ull_frag_samples ? d_frag_sum / (double)ull_frag_samples : 0.0);
+
+   return (i_ret < 0) ? EXIT_FAILURE : 0;
+}
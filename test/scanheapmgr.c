@@ -0,0 +1,240 @@
+/*--------------------------------------------------------------------*/
+/* scanheapmgr.c                                                      */
+/* First-fit search: free-list walk versus free-index scan            */
+/*--------------------------------------------------------------------*/
+
+/* The search functions are static, so the implementation is compiled
+   into this file, with its free-block index.  Build with -I src. */
+#define HEAPMGR_INDEX
+#include "heapmgr1.c"
+
+#include <stdio.h>
+#include <string.h>
+#include "latency.h"
+
+#define USAGE "Usage: %s [-n blocks] [-g gap] [-r repeats]\n"
+
+/* Searches timed per batch, over all lengths of one run. */
+enum {SEARCHES_PER_BATCH = 1 << 22};
+
+/*--------------------------------------------------------------------*/
+
+static size_t ui_blocks = 65536;
+static size_t ui_gap = 1;
+static int i_repeats = 15;
+
+/* Free blocks, in address order. */
+static Chunk_T *ah_free;
+
+/* Per-batch ns/search samples. */
+static double *ad_samples;
+
+/*--------------------------------------------------------------------*/
+
+static size_t ruler_units(size_t k)
+
+/* Payload units of free block k: one more than the number of trailing
+   zero bits of k + 1.  The first block with at least 1 + j units is
+   then block 2^j - 1, so a request of 1 + j units walks past exactly
+   2^j - 1 free blocks, while the average block stays small. */
+
+{
+   return 1 + (size_t)__builtin_ctzl((unsigned long)k + 1);
+}
+
+static void build_heap(void)
+
+/* Lay out ui_blocks groups, lowest address first:
+      free block k | allocated (ui_gap units) ...
+   heapmgr_malloc() carves from the top of a free block, so the groups
+   are allocated from the last one down, all from one region grown up
+   front with a few units to spare.  The rest of that region, below
+   block 0, is then allocated whole so that block 0 heads the list.
+   Blocks are freed from the highest address down, so the list walk
+   in heapmgr_free() would stay short even without the index. */
+
+{
+   size_t ui_bytes = 4 * CHUNK_UNIT, k;
+   Chunk_T h_c;
+
+   for (k = 0; k < ui_blocks; k++)
+      ui_bytes += (ruler_units(k) + 2 + ui_gap + 2) * CHUNK_UNIT;
+   heapmgr_free(heapmgr_malloc(ui_bytes));
+
+   /* The layout depends on exact splits. */
+   s_tune_split = s_tune_grow = FALSE;
+   s_split_min = 3;
+
+   for (k = ui_blocks; k-- > 0; )
+   {
+      heapmgr_malloc(ui_gap * CHUNK_UNIT);
+      ah_free[k] = header_from_payload(
+         heapmgr_malloc(ruler_units(k) * CHUNK_UNIT));
+   }
+   if (s_free_head != NULL)
+      heapmgr_malloc((chunk_get_span_units(s_free_head) - 2) * CHUNK_UNIT);
+   for (k = ui_blocks; k-- > 0; )
+      heapmgr_free((char *)ah_free[k] + CHUNK_UNIT);
+
+   for (h_c = s_free_head, k = 0; h_c != NULL;
+        h_c = header_chunk_get_next_free(h_c), k++)
+      if (k >= ui_blocks || h_c != ah_free[k]
+          || chunk_get_span_units(h_c) != ruler_units(k) + 2)
+      {
+         fprintf(stderr, "Unexpected heap layout\n");
+         exit(EXIT_FAILURE);
+      }
+   if (k != ui_blocks || s_idx.off || s_idx.n != ui_blocks)
+   {
+      fprintf(stderr, "Unexpected heap layout\n");
+      exit(EXIT_FAILURE);
+   }
+}
+
+/*--------------------------------------------------------------------*/
+
+/* The search under test: a list walk, or the index scan with the
+   kernel in s_idx_scan. */
+static find_fn pf_search;
+
+static double batch(size_t ui_need, size_t ui_searches)
+
+/* Time ui_searches first-fit searches for ui_need payload units and
+   return ns per search.  Each result is checked, so that no search
+   can be optimized away. */
+
+{
+   Chunk_T h_tail, h_found, h_expect = ah_free[(1ul << (ui_need - 1)) - 1];
+   unsigned long ul_visited;
+   double d_start;
+   size_t i;
+
+   d_start = now_ns();
+   for (i = 0; i < ui_searches; i++)
+   {
+      h_found = (*pf_search)(ui_need, &h_tail, &ul_visited);
+      if (h_found != h_expect)
+      {
+         fprintf(stderr, "Search found the wrong block\n");
+         exit(EXIT_FAILURE);
+      }
+   }
+   return (now_ns() - d_start) / (double)ui_searches;
+}
+
+static double median_ns(size_t ui_need, size_t ui_searches)
+
+/* Run one warm-up batch and i_repeats timed batches and return the
+   median ns per search. */
+
+{
+   int i, j;
+
+   batch(ui_need, ui_searches);
+   for (i = 0; i < i_repeats; i++)
+   {
+      /* Insertion sort; i_repeats is small. */
+      double d = batch(ui_need, ui_searches);
+      for (j = i; j > 0 && ad_samples[j - 1] > d; j--)
+         ad_samples[j] = ad_samples[j - 1];
+      ad_samples[j] = d;
+   }
+   return ad_samples[i_repeats / 2];
+}
+
+/*--------------------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+
+/* Build a free list of -n blocks free blocks (default 65536), -g gap
+   allocated units apart (default 1), and for each length 2^j up to
+   blocks time a first-fit search that ends at the 2^j-th free block:
+   the list walk of find_first_fit_list() and the index scan of
+   find_first_fit_index() with each scan kernel the CPU supports.
+   Print the median ns per search over -r repeats batches (default
+   15). */
+
+{
+   static const struct
+   {
+      const char *pc_name;
+      find_fn pf_search;
+      idx_scan_fn pf_scan;
+      const char *pc_cpu;
+   } as_kernels[] =
+   {
+      {"list", find_first_fit_list, NULL, NULL},
+      {"scalar", find_first_fit_index, idx_scan_scalar, NULL},
+#if defined(__x86_64__) || defined(__i386__)
+      {"sse2", find_first_fit_index, idx_scan_sse2, "sse2"},
+      {"avx2", find_first_fit_index, idx_scan_avx2, "avx2"},
+#endif
+   };
+   enum {KERNELS = sizeof(as_kernels) / sizeof(as_kernels[0])};
+   int ai_usable[KERNELS];
+   size_t ui_need, ui_len;
+   int i, k;
+
+   for (i = 1; i < argc; i++)
+   {
+      if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+         ui_blocks = (size_t)strtoul(argv[++i], NULL, 10);
+      else if (strcmp(argv[i], "-g") == 0 && i + 1 < argc)
+         ui_gap = (size_t)strtoul(argv[++i], NULL, 10);
+      else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+         i_repeats = atoi(argv[++i]);
+      else
+         break;
+   }
+   if (i < argc || ui_blocks == 0 || ui_gap == 0 || i_repeats < 1)
+   {
+      fprintf(stderr, USAGE, argv[0]);
+      return EXIT_FAILURE;
+   }
+
+   ah_free = map_array(ui_blocks * sizeof(Chunk_T));
+   ad_samples = map_array((size_t)i_repeats * sizeof(double));
+
+   __builtin_cpu_init();
+   for (k = 0; k < KERNELS; k++)
+      ai_usable[k] = (as_kernels[k].pc_cpu == NULL)
+#if defined(__x86_64__) || defined(__i386__)
+         || (strcmp(as_kernels[k].pc_cpu, "sse2") == 0
+             && __builtin_cpu_supports("sse2"))
+         || (strcmp(as_kernels[k].pc_cpu, "avx2") == 0
+             && __builtin_cpu_supports("avx2"))
+#endif
+         ;
+
+   /* The header goes out first: the first printf() takes stdout's
+      buffer from glibc, which must not happen inside the list that
+      build_heap() lays out. */
+   printf("%8s", "Length");
+   for (k = 0; k < KERNELS; k++)
+      if (ai_usable[k])
+         printf(" %9s", as_kernels[k].pc_name);
+   printf("   (median ns/search, gap %zu units)\n", ui_gap);
+   fflush(stdout);
+
+   build_heap();
+
+   for (ui_need = 1, ui_len = 1; ui_len <= ui_blocks; ui_need++, ui_len *= 2)
+   {
+      size_t ui_searches = SEARCHES_PER_BATCH / ui_len / 16 + 1;
+      printf("%8zu", ui_len);
+      for (k = 0; k < KERNELS; k++)
+      {
+         if (!ai_usable[k])
+            continue;
+         pf_search = as_kernels[k].pf_search;
+         if (as_kernels[k].pf_scan != NULL)
+            s_idx_scan = as_kernels[k].pf_scan;
+         printf(" %9.1f", median_ns(ui_need, ui_searches));
+         fflush(stdout);
+      }
+      printf("\n");
+   }
+
+   assert(check_heap_validity());
+   return 0;
+}
@@ -0,0 +1,279 @@
+/*--------------------------------------------------------------------*/
+/* shmheapmgr.c                                                       */
+/* Message passing: copying through a pipe versus a shared heap       */
+/*--------------------------------------------------------------------*/
+
+#include "heapmgr.h"
+#include "heapmgrpersist.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#define USAGE "Usage: %s [-n messages] [-p pairs]\n"
+
+/* Messages a producer may have in the shared heap before the
+   consumer hands back credit; credit comes back WINDOW / 2 at a time,
+   so a pipe write is not needed per message. */
+enum {WINDOW = 64};
+
+/*--------------------------------------------------------------------*/
+
+static long l_messages = 20000;
+static int i_pairs = 1;
+static char ac_shm_name[64];
+
+/*--------------------------------------------------------------------*/
+
+static double now_s(void)
+{
+   struct timespec s_now;
+   clock_gettime(CLOCK_MONOTONIC, &s_now);
+   return (double)s_now.tv_sec + (double)s_now.tv_nsec / 1e9;
+}
+
+static void io_all(int i_fd, void *pv, size_t ui_len, int i_write)
+
+/* Read or write exactly ui_len bytes, or exit the process. */
+
+{
+   char *pc = pv;
+   while (ui_len > 0)
+   {
+      ssize_t l = i_write ? write(i_fd, pc, ui_len) : read(i_fd, pc, ui_len);
+      if (l < 0 && errno == EINTR)
+         continue;
+      if (l <= 0)
+         _exit(EXIT_FAILURE);
+      pc += l;
+      ui_len -= (size_t)l;
+   }
+}
+
+/*--------------------------------------------------------------------*/
+
+static void fill(void *pv, size_t ui_size, long l_i)
+
+/* Write message l_i: every 8-byte word holds l_i. */
+
+{
+   unsigned long *pul = pv;
+   size_t ui_j;
+   for (ui_j = 0; ui_j < ui_size / sizeof(unsigned long); ui_j++)
+      pul[ui_j] = (unsigned long)l_i;
+}
+
+static void check(const void *pv, size_t ui_size, long l_i)
+
+/* Read all of message l_i, as a consumer would, and exit the process
+   if it is not what fill() wrote. */
+
+{
+   const unsigned long *pul = pv;
+   unsigned long ul_sum = 0;
+   size_t ui_j, ui_words = ui_size / sizeof(unsigned long);
+   for (ui_j = 0; ui_j < ui_words; ui_j++)
+      ul_sum += pul[ui_j];
+   if (ul_sum != (unsigned long)l_i * ui_words)
+      _exit(EXIT_FAILURE);
+}
+
+/*--------------------------------------------------------------------*/
+
+static void pipe_producer(int i_fd, size_t ui_size)
+{
+   void *pv = malloc(ui_size);
+   long l_i;
+   for (l_i = 0; l_i < l_messages; l_i++)
+   {
+      fill(pv, ui_size, l_i);
+      io_all(i_fd, pv, ui_size, 1);
+   }
+}
+
+static void pipe_consumer(int i_fd, size_t ui_size)
+{
+   void *pv = malloc(ui_size);
+   long l_i;
+   for (l_i = 0; l_i < l_messages; l_i++)
+   {
+      io_all(i_fd, pv, ui_size, 0);
+      check(pv, ui_size, l_i);
+   }
+}
+
+static void shm_producer(int i_fd, int i_credit_fd, size_t ui_size)
+
+/* Allocate each message in the shared heap, fill it in place and
+   send only its offset. */
+
+{
+   long l_i, l_in_flight = 0;
+   char c;
+
+   if (heapmgr_persist_open_shm(ac_shm_name, 0) < 0)
+      _exit(EXIT_FAILURE);
+   for (l_i = 0; l_i < l_messages; l_i++)
+   {
+      void *pv;
+      size_t ui_off;
+      if (l_in_flight == WINDOW)
+      {
+         io_all(i_credit_fd, &c, 1, 0);
+         l_in_flight -= WINDOW / 2;
+      }
+      if ((pv = heapmgr_malloc(ui_size)) == NULL)
+         _exit(EXIT_FAILURE);
+      fill(pv, ui_size, l_i);
+      ui_off = heapmgr_persist_offset(pv);
+      io_all(i_fd, &ui_off, sizeof(ui_off), 1);
+      l_in_flight++;
+   }
+   heapmgr_persist_close();
+}
+
+static void shm_consumer(int i_fd, int i_credit_fd, size_t ui_size)
+
+/* Receive offsets, read each message where the producer wrote it and
+   free it from this process. */
+
+{
+   long l_i;
+   char c = 0;
+
+   if (heapmgr_persist_open_shm(ac_shm_name, 0) < 0)
+      _exit(EXIT_FAILURE);
+   for (l_i = 0; l_i < l_messages; l_i++)
+   {
+      size_t ui_off;
+      void *pv;
+      io_all(i_fd, &ui_off, sizeof(ui_off), 0);
+      if ((pv = heapmgr_persist_pointer(ui_off)) == NULL)
+         _exit(EXIT_FAILURE);
+      check(pv, ui_size, l_i);
+      heapmgr_free(pv);
+      /* The producer may already be done; SIGPIPE is ignored. */
+      if ((l_i + 1) % (WINDOW / 2) == 0)
+         (void)write(i_credit_fd, &c, 1);
+   }
+   heapmgr_persist_close();
+}
+
+/*--------------------------------------------------------------------*/
+
+static double run(size_t ui_size, int i_shm)
+
+/* Run i_pairs producer/consumer process pairs, each passing
+   l_messages messages of ui_size bytes, and return the wall time in
+   seconds. */
+
+{
+   double d_start = now_s();
+   int i, i_status, i_ok = 1;
+
+   for (i = 0; i < i_pairs; i++)
+   {
+      int ai_data[2], ai_credit[2];
+      pid_t i_pid;
+      if (pipe(ai_data) != 0 || pipe(ai_credit) != 0)
+      {
+         perror("pipe");
+         exit(EXIT_FAILURE);
+      }
+      if ((i_pid = fork()) == 0)
+      {
+         close(ai_data[0]);
+         close(ai_credit[1]);
+         if (i_shm)
+            shm_producer(ai_data[1], ai_credit[0], ui_size);
+         else
+            pipe_producer(ai_data[1], ui_size);
+         _exit(0);
+      }
+      if (i_pid > 0 && (i_pid = fork()) == 0)
+      {
+         close(ai_data[1]);
+         close(ai_credit[0]);
+         if (i_shm)
+            shm_consumer(ai_data[0], ai_credit[1], ui_size);
+         else
+            pipe_consumer(ai_data[0], ui_size);
+         _exit(0);
+      }
+      if (i_pid < 0)
+      {
+         perror("fork");
+         exit(EXIT_FAILURE);
+      }
+      close(ai_data[0]);
+      close(ai_data[1]);
+      close(ai_credit[0]);
+      close(ai_credit[1]);
+   }
+   while (wait(&i_status) > 0)
+      if (!WIFEXITED(i_status) || WEXITSTATUS(i_status) != 0)
+         i_ok = 0;
+   if (!i_ok)
+   {
+      fprintf(stderr, "A %s process failed\n", i_shm ? "shm" : "pipe");
+      exit(EXIT_FAILURE);
+   }
+   return now_s() - d_start;
+}
+
+/*--------------------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+
+/* For message sizes from 256 bytes to 1 MiB, run -p pairs (default
+   1) of producer and consumer processes that pass -n messages
+   (default 20000) each, first by copying every message through a
+   pipe, then by allocating it in a heap in POSIX shared memory and
+   passing its offset.  The consumer reads every byte and, in the
+   second case, frees the block.  Print the throughput of both. */
+
+{
+   static const size_t aui_sizes[] = {256, 4096, 65536, 1048576};
+   size_t ui_k;
+   int i;
+
+   for (i = 1; i < argc; i++)
+   {
+      if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+         l_messages = atol(argv[++i]);
+      else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc)
+         i_pairs = atoi(argv[++i]);
+      else
+         break;
+   }
+   if (i < argc || l_messages < 1 || i_pairs < 1)
+   {
+      fprintf(stderr, USAGE, argv[0]);
+      return EXIT_FAILURE;
+   }
+
+   signal(SIGPIPE, SIG_IGN);
+   snprintf(ac_shm_name, sizeof(ac_shm_name), "/shmheapmgr.%ld", (long)getpid());
+   shm_unlink(ac_shm_name);
+
+   printf("%8s %6s %12s %12s %8s   (%ld messages per pair)\n",
+      "Size", "Pairs", "pipe MB/s", "shm MB/s", "Speedup", l_messages);
+   for (ui_k = 0; ui_k < sizeof(aui_sizes) / sizeof(aui_sizes[0]); ui_k++)
+   {
+      double d_bytes = (double)aui_sizes[ui_k] * (double)l_messages * i_pairs;
+      double d_pipe = run(aui_sizes[ui_k], 0);
+      double d_shm = run(aui_sizes[ui_k], 1);
+      printf("%8zu %6d %12.1f %12.1f %8.2f\n", aui_sizes[ui_k], i_pairs,
+         d_bytes / d_pipe / 1e6, d_bytes / d_shm / 1e6, d_pipe / d_shm);
+      fflush(stdout);
+   }
+
+   shm_unlink(ac_shm_name);
+   return 0;
+}
@@ -0,0 +1,330 @@
+/*--------------------------------------------------------------------*/
+/* stlheapmgr.cpp                                                     */
+/* STL containers on a heapmgr engine versus std::allocator           */
+/*--------------------------------------------------------------------*/
+
+#include "heapmgrpmr.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <map>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#define USAGE "Usage: %s [-n elements]\n"
+
+/* Inner vectors of the vector test hold 1 .. MAX_INNER ints. */
+enum {MAX_INNER = 32};
+
+/*--------------------------------------------------------------------*/
+
+/* How a container gets its memory. */
+enum variant {STD, ADAPTER, PMR, POOL, REGION, NUM_VARIANTS};
+
+static const char *apc_variant_names[NUM_VARIANTS] =
+   {"std::allocator", "heapmgr_allocator", "heapmgr_resource", "heapmgr_pool",
+    "heapmgr_region"};
+
+enum container {VECTOR, MAP, UNORDERED_MAP, NUM_CONTAINERS};
+
+static const char *apc_container_names[NUM_CONTAINERS] =
+   {"vector<vector>", "map", "unordered_map"};
+
+/* What a child process sends back. */
+struct result {
+   double ad_ms[3];          /* build, mutate, destroy */
+   long l_maxrss_kb;
+};
+
+static long l_elements = 100000;
+
+/*--------------------------------------------------------------------*/
+
+static double now_ms(void)
+{
+   struct timespec s_now;
+   clock_gettime(CLOCK_MONOTONIC, &s_now);
+   return (double)s_now.tv_sec * 1e3 + (double)s_now.tv_nsec / 1e6;
+}
+
+static unsigned long key_of(long l_i)
+{
+   return (unsigned long)(l_i + 1) * 0x9e3779b97f4a7c15ul;
+}
+
+/*--------------------------------------------------------------------*/
+
+template <class V>
+static void vector_build(V &r_v)
+
+/* Append vectors of 1 .. MAX_INNER ints, one int at a time, until
+   they hold about l_elements ints. */
+
+{
+   long l_i, l_total = 0;
+   for (l_i = 0; l_total < l_elements; l_i++)
+   {
+      long l_len = 1 + (long)(key_of(l_i) >> 40) % MAX_INNER, l_j;
+      r_v.emplace_back();
+      for (l_j = 0; l_j < l_len; l_j++)
+         r_v.back().push_back((int)l_j);
+      l_total += l_len;
+   }
+}
+
+template <class V>
+static void vector_mutate(V &r_v)
+
+/* Give every inner vector a new length and shrink it to fit, so that
+   most of them are reallocated, then drop every fourth one. */
+
+{
+   std::size_t ui_i;
+   for (ui_i = 0; ui_i < r_v.size(); ui_i++)
+   {
+      r_v[ui_i].resize(1 + (key_of((long)ui_i + l_elements) >> 40) % MAX_INNER);
+      r_v[ui_i].shrink_to_fit();
+   }
+   for (ui_i = 0; ui_i < r_v.size(); ui_i += 4)
+   {
+      r_v[ui_i].clear();
+      r_v[ui_i].shrink_to_fit();
+   }
+}
+
+template <class M>
+static void map_build(M &r_m)
+
+/* Insert l_elements keys. */
+
+{
+   long l_i;
+   for (l_i = 0; l_i < l_elements; l_i++)
+      r_m.emplace(key_of(l_i), (unsigned long)l_i);
+}
+
+template <class M>
+static void map_mutate(M &r_m)
+
+/* Replace half of the keys with new ones, one erase and one insert at
+   a time. */
+
+{
+   long l_i;
+   for (l_i = 0; l_i < l_elements; l_i += 2)
+   {
+      r_m.erase(key_of(l_i));
+      r_m.emplace(key_of(l_elements + l_i), (unsigned long)l_i);
+   }
+}
+
+/*--------------------------------------------------------------------*/
+
+template <class C, class R, class... Args>
+static void measure(std::optional<R> &r_res, void (*pf_build)(C &),
+   void (*pf_mutate)(C &), struct result *ps_result, Args &&...args)
+
+/* Construct a C from args, run pf_build and pf_mutate on it, then
+   destroy it and r_res, the resource it took its memory from, and
+   store the time of each of the three phases in *ps_result. */
+
+{
+   std::optional<C> o_c;
+   double d_start = now_ms();
+
+   o_c.emplace(std::forward<Args>(args)...);
+   pf_build(*o_c);
+   ps_result->ad_ms[0] = now_ms() - d_start;
+   d_start = now_ms();
+   pf_mutate(*o_c);
+   ps_result->ad_ms[1] = now_ms() - d_start;
+   d_start = now_ms();
+   o_c.reset();
+   r_res.reset();
+   ps_result->ad_ms[2] = now_ms() - d_start;
+}
+
+/* Containers of each kind, for std::allocator and heapmgr_allocator. */
+template <template <class> class A>
+struct std_types {
+   using Inner = std::vector<int, A<int>>;
+   using Vector = std::vector<Inner, A<Inner>>;
+   using Map = std::map<unsigned long, unsigned long, std::less<unsigned long>,
+      A<std::pair<const unsigned long, unsigned long>>>;
+   using UnorderedMap = std::unordered_map<unsigned long, unsigned long,
+      std::hash<unsigned long>, std::equal_to<unsigned long>,
+      A<std::pair<const unsigned long, unsigned long>>>;
+};
+
+template <template <class> class A>
+static void run_allocator(enum container e_container, struct result *ps_result)
+{
+   using T = std_types<A>;
+   std::optional<int> o_none;
+
+   switch (e_container)
+   {
+   case VECTOR:
+      measure<typename T::Vector>(o_none, vector_build, vector_mutate, ps_result);
+      break;
+   case MAP:
+      measure<typename T::Map>(o_none, map_build, map_mutate, ps_result);
+      break;
+   default:
+      measure<typename T::UnorderedMap>(o_none, map_build, map_mutate, ps_result);
+      break;
+   }
+}
+
+template <class R>
+static void run_resource(enum container e_container, std::optional<R> &r_res,
+   std::pmr::memory_resource *ps_mr, struct result *ps_result)
+
+/* Run the test of e_container with std::pmr containers on ps_mr, which
+   is *r_res or, if r_res is empty, heapmgr_resource(). */
+
+{
+   switch (e_container)
+   {
+   case VECTOR:
+      measure<std::pmr::vector<std::pmr::vector<int>>>(r_res, vector_build,
+         vector_mutate, ps_result, ps_mr);
+      break;
+   case MAP:
+      measure<std::pmr::map<unsigned long, unsigned long>>(r_res, map_build,
+         map_mutate, ps_result, ps_mr);
+      break;
+   default:
+      measure<std::pmr::unordered_map<unsigned long, unsigned long>>(r_res,
+         map_build, map_mutate, ps_result, ps_mr);
+      break;
+   }
+}
+
+static void run(enum container e_container, enum variant e_variant,
+   struct result *ps_result)
+{
+   switch (e_variant)
+   {
+   case STD:
+      run_allocator<std::allocator>(e_container, ps_result);
+      break;
+   case ADAPTER:
+      run_allocator<heapmgr_allocator>(e_container, ps_result);
+      break;
+   case PMR:
+   {
+      std::optional<int> o_none;
+      run_resource(e_container, o_none, heapmgr_resource(), ps_result);
+      break;
+   }
+   case POOL:
+   {
+      std::optional<heapmgr_pool> o_pool;
+      o_pool.emplace();
+      run_resource(e_container, o_pool, &*o_pool, ps_result);
+      break;
+   }
+   default:
+   {
+      std::optional<heapmgr_region> o_region;
+      o_region.emplace();
+      run_resource(e_container, o_region, &*o_region, ps_result);
+      break;
+   }
+   }
+}
+
+/*--------------------------------------------------------------------*/
+
+static int run_child(enum container e_container, enum variant e_variant,
+   struct result *ps_result)
+
+/* Run one test in a child process, so that every test starts from an
+   empty heap and std::allocator (glibc malloc()) and the engine never
+   share the program break.  Return 0, or -1 if the child failed. */
+
+{
+   int ai_fd[2], i_status;
+   pid_t i_pid;
+   ssize_t l_got;
+
+   if (pipe(ai_fd) != 0 || (i_pid = fork()) < 0)
+   {
+      perror("fork");
+      exit(EXIT_FAILURE);
+   }
+   if (i_pid == 0)
+   {
+      struct rusage s_usage;
+      close(ai_fd[0]);
+      run(e_container, e_variant, ps_result);
+      getrusage(RUSAGE_SELF, &s_usage);
+      ps_result->l_maxrss_kb = s_usage.ru_maxrss;
+      _exit(write(ai_fd[1], ps_result, sizeof(*ps_result))
+         == (ssize_t)sizeof(*ps_result) ? 0 : EXIT_FAILURE);
+   }
+   close(ai_fd[1]);
+   l_got = read(ai_fd[0], ps_result, sizeof(*ps_result));
+   close(ai_fd[0]);
+   if (waitpid(i_pid, &i_status, 0) != i_pid || !WIFEXITED(i_status)
+       || WEXITSTATUS(i_status) != 0 || l_got != (ssize_t)sizeof(*ps_result))
+      return -1;
+   return 0;
+}
+
+/*--------------------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+
+/* For a vector of small vectors, a map and an unordered_map of about
+   -n elements (default 100000), build the container, mutate it
+   (reallocate the inner vectors; replace half of the map keys) and
+   destroy it, once with std::allocator and once with each way of
+   putting it on the engine this program is linked with.  Print the
+   wall time of each phase and the peak RSS of the process. */
+
+{
+   int i, i_c, i_v;
+
+   for (i = 1; i < argc; i++)
+   {
+      if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+         l_elements = atol(argv[++i]);
+      else
+         break;
+   }
+   if (i < argc || l_elements < 1)
+   {
+      fprintf(stderr, USAGE, argv[0]);
+      return EXIT_FAILURE;
+   }
+
+   printf("%-15s %-18s %9s %9s %9s %9s %8s   (%ld elements)\n", "Container",
+      "Allocator", "build ms", "mutate ms", "destr ms", "total ms", "RSS MB",
+      l_elements);
+   fflush(stdout);
+   for (i_c = 0; i_c < NUM_CONTAINERS; i_c++)
+      for (i_v = 0; i_v < NUM_VARIANTS; i_v++)
+      {
+         struct result s_result;
+         if (run_child((enum container)i_c, (enum variant)i_v, &s_result) != 0)
+         {
+            printf("%-15s %-18s failed\n", apc_container_names[i_c],
+               apc_variant_names[i_v]);
+            continue;
+         }
+         printf("%-15s %-18s %9.1f %9.1f %9.1f %9.1f %8.1f\n",
+            apc_container_names[i_c], apc_variant_names[i_v],
+            s_result.ad_ms[0], s_result.ad_ms[1], s_result.ad_ms[2],
+            s_result.ad_ms[0] + s_result.ad_ms[1] + s_result.ad_ms[2],
+            (double)s_result.l_maxrss_kb / 1024.0);
+         fflush(stdout);
+      }
+   return 0;
+}
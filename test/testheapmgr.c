@@ -3,6 +3,10 @@
 /*--------------------------------------------------------------------*/
 
 #include "heapmgr.h"
+#include "latency.h"
+#include "memseries.h"
+#include "trace.h"
+#include "workload.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
@@ -10,6 +14,7 @@
 #include <assert.h>
 #include <sys/time.h>
 #include <sys/resource.h>
+#include <sys/mman.h>
 
 #ifndef __USE_MISC
 #define __USE_MISC
@@ -18,6 +23,10 @@
 
 enum {FALSE, TRUE};
 
+#define USAGE "Usage: %s testname count size [-s] [-l] [-t tracefile]" \
+   " [-m file [-i interval]] [-L exp|phase] [-r seed]" \
+   " [-S slots [-D seconds] [-p ops]]\n"
+
 /*--------------------------------------------------------------------*/
 
 /* These arrays are too big for the stack section, so store
@@ -32,13 +41,80 @@ static char *apc_chunks[MAX_CALLS];
 /* Randomly generated chunk sizes.  */
 static int ai_sizes[MAX_CALLS];
 
+/* Size of the multi-GiB chunks allocated by test_huge_mixed().  It is
+   deliberately larger than INT_MAX, so a heapmgr that keeps sizes in
+   an int cannot satisfy it. */
+static const size_t HUGE_CHUNK_BYTES = (size_t)3 << 30;
+
+/* test_huge_mixed() replaces its huge chunk once per HUGE_PERIOD
+   calls. */
+enum {HUGE_PERIOD = 1000};
+
+/* test_tiny_huge() churns this many tiny/huge pairs per round. */
+enum {TINY_HUGE_PAIRS = 1024};
+
+/* test_sawtooth() ramps the live set up and down this many times. */
+enum {SAWTOOTH_TEETH = 8};
+
+/* Generated tests (test_generated()): size and lifetime generators,
+   the generator state, each chunk's death time, and the chunks
+   waiting to die. */
+static struct size_gen s_size_gen;
+static struct life_gen s_life_gen;
+static struct prng s_rng;
+static long al_death[MAX_CALLS];
+static long al_deaths[MAX_CALLS];
+static struct death_heap s_deaths;
+
+/* Command-line options. */
+
+/* -s: print heapmgr_stats() after each timed phase. */
+static int i_opt_stats = FALSE;
+
+/* -l: time every heapmgr_malloc() and heapmgr_free() call. */
+static int i_opt_latency = FALSE;
+
+/* Per-call latency histograms filled in -l mode. */
+static struct latency_hist s_malloc_latency, s_free_latency;
+
+/* -t tracefile: record every call into a trace for replayheapmgr. */
+static const char *pc_opt_trace = NULL;
+static struct trace_writer s_trace;
+static struct trace_ids s_trace_ids;
+
+/* -m file: sample memory use every ll_opt_interval calls into a CSV
+   time series (see memseries.h). */
+static const char *pc_opt_memseries = NULL;
+static long long ll_opt_interval = 1000;
+static struct mem_series s_memseries;
+
+/* -L: lifetime model of the generated tests. */
+static enum life_dist e_opt_life = LIFE_EXPONENTIAL;
+
+/* -r: seed of the generated tests. */
+static unsigned long long ull_opt_seed = 1;
+
+/* -S slots: streaming mode with a live set of that many chunks;
+   0 means off. */
+static long long ll_opt_stream_slots = 0;
+
+/* -D seconds: stop streaming after this much wall time; 0 means
+   run for the whole count. */
+static double d_opt_duration = 0.0;
+
+/* -p ops: print a streaming progress line this often. */
+static long long ll_opt_progress = 10000000;
+
 /*--------------------------------------------------------------------*/
 
 /* Function declarations. */
 
 static void get_args(int argc, char *argv[],
-   int *pi_test_num, int *pi_count, int *pi_size);
+   int *pi_test_num, long long *pll_count, int *pi_size);
 static void set_cpu_limit(void);
+static void run_stream(long long ll_count, int i_size);
+static void print_stats(const char *pc_when,
+   const struct heapmgr_stats *ps_stats);
 static void test_LIFO_fixed_malloc(int i_count, int i_size);
 static void test_LIFO_fixed_free(int i_count, int i_size);
 static void test_FIFO_fixed_malloc(int i_count, int i_size);
@@ -50,6 +126,12 @@ static void test_FIFO_random_free(int i_count, int i_size);
 static void test_random_fixed(int i_count, int i_size);
 static void test_random_random(int i_count, int i_size);
 static void test_worst(int i_count, int i_size);
+static void test_huge_mixed(int i_count, int i_size);
+static void test_generated(int i_count, int i_size);
+static void test_bin_straddle(int i_count, int i_size);
+static void test_tiny_huge(int i_count, int i_size);
+static void test_sawtooth(int i_count, int i_size);
+static void test_pinning(int i_count, int i_size);
 
 /*--------------------------------------------------------------------*/
 
@@ -58,20 +140,31 @@ static void test_worst(int i_count, int i_size);
 static char *apc_test_name[] =
 {
    "LIFO_fixed", "FIFO_fixed", "LIFO_random", "FIFO_random",
-   "random_fixed", "random_random", "worst"
+   "random_fixed", "random_random", "worst", "huge_mixed",
+   "uniform", "lognormal", "zipf", "bimodal",
+   "binstraddle", "tinyhuge", "sawtooth", "pinning"
 };
 
 /*--------------------------------------------------------------------*/
 
 /* apf_test_function is an array containing pointers to the test
    functions.  Each pointer corresponds, by position, to a test name
-   in apc_test_name. */
+   in apc_test_name.  The first NUM_SPLIT_TESTS tests are timed in
+   two phases; apf_free_function holds their second (free) phase. */
+
+enum {NUM_SPLIT_TESTS = 4};
 
 typedef void (*test_function)(int, int);
 static test_function apf_test_function[] =
 {
    test_LIFO_fixed_malloc, test_FIFO_fixed_malloc, test_LIFO_random_malloc, test_FIFO_random_malloc,
-   test_random_fixed, test_random_random, test_worst,
+   test_random_fixed, test_random_random, test_worst, test_huge_mixed,
+   test_generated, test_generated, test_generated, test_generated,
+   test_bin_straddle, test_tiny_huge, test_sawtooth, test_pinning
+};
+
+static test_function apf_free_function[NUM_SPLIT_TESTS] =
+{
    test_LIFO_fixed_free, test_FIFO_fixed_free, test_LIFO_random_free, test_FIFO_random_free
 };
 
@@ -88,13 +181,49 @@ int main(int argc, char *argv[])
       FIFO_random: FIFO with random size chunks,
       random_fixed: random order with fixed size chunks,
       random_random: random order with random size chunks,
-      worst: worst case for single linked list implementation.
+      worst: worst case for single linked list implementation,
+      huge_mixed: random order with random size chunks, plus one
+         multi-GiB chunk that is replaced periodically.
+      uniform, lognormal, zipf, bimodal: chunk sizes drawn from that
+         distribution (see workload.h), each chunk freed when its
+         generated lifetime runs out.
+      binstraddle, tinyhuge, sawtooth, pinning: adversarial tests for
+         segregated, tree and slab engines; see the test functions.
 
    argv[2] is the number of calls of heapmgr_malloc() and heapmgr_free()
    to execute.  argv[2] cannot be greater than MAX_CALLS.
 
    argv[3] is the (maximum) size of each memory chunk.
 
+   Options may follow the three arguments:
+      -s: print the heapmgr_stats() counters after each timed phase.
+      -l: time each heapmgr_malloc() and heapmgr_free() call with the
+         CPU's cycle counter and print p50/p90/p99/p99.9/max latency
+         for each.  The timer's own cost is subtracted from every
+         sample, but the reported Time columns include it.
+      -t tracefile: record every heapmgr_malloc() and heapmgr_free()
+         call into tracefile (see trace.h), to be replayed against
+         any engine with replayheapmgr.  Recording is included in the
+         reported times.
+      -m file: write a memory time series to the CSV file: every
+         interval calls, the requested bytes live, heap footprint,
+         program break growth, RSS, free bytes, largest free block,
+         free block count and fragmentation.  A summary line with the
+         peaks, peak overhead (peak heap / peak live) and time-weighted
+         mean fragmentation follows the usual output.  Sampling is
+         included in the reported times.
+      -i interval: calls between -m samples (default 1000).
+      -L exp|phase: lifetime model of the generated tests, exponential
+         (the default) or phase-based.
+      -r seed: seed of the generated tests (default 1).
+      -S slots: streaming mode, for the generated tests only.  Keep
+         a live set of slots chunks and replace a random one argv[2]
+         times, without the MAX_CALLS and CPU time limits; see
+         run_stream().  argv[2] may be 0 if -D is given.
+      -D seconds: in streaming mode, stop after this much wall time.
+      -p ops: in streaming mode, print a progress line every ops
+         replacements (default 10000000).
+
    If the NDEBUG macro is not defined, then initialize and check
    the contents of each memory chunk.
 
@@ -104,21 +233,70 @@ int main(int argc, char *argv[])
 {
    int i_test_num = 0;
    int i_count = 0;
+   long long ll_count = 0;
    int i_size = 0;
    clock_t i_initial_clock, i_malloc_clock, i_final_clock;
    char *pc_initial_break, *pc_final_break;
    long long i_memory_consumed;
    double d_malloc_time, d_free_time, d_total_time;
+   struct heapmgr_stats s_malloc_stats, s_final_stats;
+   enum size_dist e_size_dist;
 
    //srand((unsigned int)time(NULL));
 
    /* Get the command-line arguments. */
-   get_args(argc, argv, &i_test_num, &i_count, &i_size);
+   get_args(argc, argv, &i_test_num, &ll_count, &i_size);
+   i_count = (ll_opt_stream_slots == 0) ? (int)ll_count : 0;
 
    /* Start printing the results. */
-   printf("%17s %13s %7d %6d ", argv[0], argv[1], i_count, i_size);
+   if (ll_opt_stream_slots == 0)
+      printf("%17s %13s %7d %6d ", argv[0], argv[1], i_count, i_size);
+   else
+      printf("%17s %13s %7s %6d stream %lld slots\n", argv[0], argv[1],
+         argv[2], i_size, ll_opt_stream_slots);
    fflush(stdout);
 
+   if (i_opt_latency)
+      latency_calibrate();
+   if (size_dist_from_name(argv[1], &e_size_dist) == 0)
+   {
+      /* Build the generators' tables before the clock starts.  The
+         mean lifetime keeps about as many chunks live as
+         random_random does. */
+      size_gen_init(&s_size_gen, e_size_dist, (size_t)i_size);
+      life_gen_init(&s_life_gen, e_opt_life, i_count / 6.0, (size_t)i_size);
+      prng_seed(&s_rng, ull_opt_seed);
+   }
+   if (pc_opt_trace != NULL && trace_writer_open(&s_trace, pc_opt_trace) != 0)
+   {
+      perror(pc_opt_trace);
+      exit(EXIT_FAILURE);
+   }
+   if (pc_opt_memseries != NULL
+       && mem_series_open(&s_memseries, pc_opt_memseries, ll_opt_interval) != 0)
+   {
+      perror(pc_opt_memseries);
+      exit(EXIT_FAILURE);
+   }
+
+   if (ll_opt_stream_slots != 0)
+   {
+      run_stream(ll_count, i_size);
+      if (pc_opt_memseries != NULL && mem_series_close(&s_memseries) != 0)
+      {
+         perror(pc_opt_memseries);
+         return EXIT_FAILURE;
+      }
+      if (heapmgr_profile_dump != NULL)
+         heapmgr_profile_dump();
+      if (pc_opt_trace != NULL && trace_writer_close(&s_trace) != 0)
+      {
+         perror(pc_opt_trace);
+         return EXIT_FAILURE;
+      }
+      return 0;
+   }
+
    /* Save the initial clock and program break. */
    i_initial_clock = clock();
    pc_initial_break = sbrk(0);
@@ -126,10 +304,18 @@ int main(int argc, char *argv[])
    /* Set the process's CPU time limit. */
    set_cpu_limit();
 
-   if (i_test_num < 4) {
+   if (i_test_num < NUM_SPLIT_TESTS) {
       (*(apf_test_function[i_test_num]))(i_count, i_size);
       i_malloc_clock = clock();
-      (*(apf_test_function[i_test_num + 7]))(i_count, i_size);
+      if (i_opt_stats)
+      {
+         /* Snapshot now, print after the result line, and keep the
+            snapshot's cost out of both phases. */
+         heapmgr_stats(&s_malloc_stats);
+         i_initial_clock += clock() - i_malloc_clock;
+         i_malloc_clock = clock();
+      }
+      (*(apf_free_function[i_test_num]))(i_count, i_size);
       i_final_clock = clock();
       pc_final_break = sbrk(0);
 
@@ -140,6 +326,17 @@ int main(int argc, char *argv[])
       i_memory_consumed = (long long)(pc_final_break - pc_initial_break);
 
       printf("%6.2f %6.2f %6.2f %10lld\n", d_malloc_time, d_free_time, d_total_time, i_memory_consumed);
+      if (i_opt_latency)
+      {
+         latency_print("malloc", &s_malloc_latency);
+         latency_print("free", &s_free_latency);
+      }
+      if (i_opt_stats)
+      {
+         print_stats("after malloc phase", &s_malloc_stats);
+         heapmgr_stats(&s_final_stats);
+         print_stats("after free phase", &s_final_stats);
+      }
    }
    else {
       (*(apf_test_function[i_test_num]))(i_count, i_size);
@@ -151,6 +348,32 @@ int main(int argc, char *argv[])
       i_memory_consumed = (long long)(pc_final_break - pc_initial_break);
 
       printf("     -      - %6.2f %10lld\n", d_total_time, i_memory_consumed);
+      if (i_opt_latency)
+      {
+         latency_print("malloc", &s_malloc_latency);
+         latency_print("free", &s_free_latency);
+      }
+      if (i_opt_stats)
+      {
+         heapmgr_stats(&s_final_stats);
+         print_stats("at exit", &s_final_stats);
+      }
+   }
+
+   if (pc_opt_memseries != NULL && mem_series_close(&s_memseries) != 0)
+   {
+      perror(pc_opt_memseries);
+      return EXIT_FAILURE;
+   }
+
+   /* Only present in profiling builds of an implementation. */
+   if (heapmgr_profile_dump != NULL)
+      heapmgr_profile_dump();
+
+   if (pc_opt_trace != NULL && trace_writer_close(&s_trace) != 0)
+   {
+      perror(pc_opt_trace);
+      return EXIT_FAILURE;
    }
 
    return 0;
@@ -159,19 +382,20 @@ int main(int argc, char *argv[])
 /*--------------------------------------------------------------------*/
 
 static void get_args(int argc, char *argv[],
-   int *pi_test_num, int *pi_count, int *pi_size)
+   int *pi_test_num, long long *pll_count, int *pi_size)
 
-/* Get command-line arguments *pi_test_num, *pi_count, and *pi_size,
-   from argument vector argv.  argc is the number of used elements
-   in argv.  Exit if any of the arguments is invalid.  */
+/* Get command-line arguments *pi_test_num, *pll_count, and *pi_size,
+   and the options, from argument vector argv.  argc is the number of
+   used elements in argv.  Exit if any of the arguments is invalid.
+   *pll_count fits in an int unless streaming mode is on. */
 
 {
    int i;
    int i_test_count;
 
-   if (argc != 4)
+   if (argc < 4)
    {
-      fprintf(stderr, "Usage: %s testname count size\n", argv[0]);
+      fprintf(stderr, USAGE, argv[0]);
       exit(EXIT_FAILURE);
    }
 
@@ -185,7 +409,7 @@ static void get_args(int argc, char *argv[],
       }
    if (i == i_test_count)
    {
-      fprintf(stderr, "Usage: %s testname count size\n", argv[0]);
+      fprintf(stderr, USAGE, argv[0]);
       fprintf(stderr, "Valid testnames:\n");
       for (i = 0; i < i_test_count; i++)
          fprintf(stderr, " %s", apc_test_name[i]);
@@ -193,37 +417,96 @@ static void get_args(int argc, char *argv[],
       exit(EXIT_FAILURE);
    }
 
-   /* Get the count. */
-   if (sscanf(argv[2], "%d", pi_count) != 1)
+   /* Get the size. */
+   if (sscanf(argv[3], "%d", pi_size) != 1)
    {
-      fprintf(stderr, "Usage: %s testname count size\n", argv[0]);
-      fprintf(stderr, "Count must be numeric\n");
+      fprintf(stderr, USAGE, argv[0]);
+      fprintf(stderr, "Size must be numeric\n");
       exit(EXIT_FAILURE);
    }
-   if (*pi_count <= 0)
+   if (*pi_size <= 0)
    {
-      fprintf(stderr, "Usage: %s testname count size\n", argv[0]);
-      fprintf(stderr, "Count must be positive\n");
+      fprintf(stderr, USAGE, argv[0]);
+      fprintf(stderr, "Size must be positive\n");
       exit(EXIT_FAILURE);
    }
-   if (*pi_count > MAX_CALLS)
+
+   /* Get the options. */
+   for (i = 4; i < argc; i++)
    {
-      fprintf(stderr, "Usage: %s testname count size\n", argv[0]);
-      fprintf(stderr, "Count cannot be greater than %d\n", MAX_CALLS);
-      exit(EXIT_FAILURE);
+      if (strcmp(argv[i], "-s") == 0)
+         i_opt_stats = TRUE;
+      else if (strcmp(argv[i], "-l") == 0)
+         i_opt_latency = TRUE;
+      else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+         pc_opt_trace = argv[++i];
+      else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc)
+         pc_opt_memseries = argv[++i];
+      else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc
+               && sscanf(argv[i + 1], "%lld", &ll_opt_interval) == 1
+               && ll_opt_interval > 0)
+         i++;
+      else if (strcmp(argv[i], "-L") == 0 && i + 1 < argc
+               && life_dist_from_name(argv[i + 1], &e_opt_life) == 0)
+         i++;
+      else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc
+               && sscanf(argv[i + 1], "%llu", &ull_opt_seed) == 1)
+         i++;
+      else if (strcmp(argv[i], "-S") == 0 && i + 1 < argc
+               && sscanf(argv[i + 1], "%lld", &ll_opt_stream_slots) == 1
+               && ll_opt_stream_slots > 0)
+         i++;
+      else if (strcmp(argv[i], "-D") == 0 && i + 1 < argc
+               && sscanf(argv[i + 1], "%lf", &d_opt_duration) == 1
+               && d_opt_duration > 0.0)
+         i++;
+      else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc
+               && sscanf(argv[i + 1], "%lld", &ll_opt_progress) == 1
+               && ll_opt_progress > 0)
+         i++;
+      else
+      {
+         fprintf(stderr, USAGE, argv[0]);
+         fprintf(stderr, "Unknown option %s\n", argv[i]);
+         exit(EXIT_FAILURE);
+      }
    }
 
-   /* Get the size. */
-   if (sscanf(argv[3], "%d", pi_size) != 1)
+   /* Get the count.  Streaming mode is bounded by the slot table,
+      not by MAX_CALLS. */
+   if (sscanf(argv[2], "%lld", pll_count) != 1)
    {
-      fprintf(stderr, "Usage: %s testname count size\n", argv[0]);
-      fprintf(stderr, "Size must be numeric\n");
+      fprintf(stderr, USAGE, argv[0]);
+      fprintf(stderr, "Count must be numeric\n");
       exit(EXIT_FAILURE);
    }
-   if (*pi_size <= 0)
+   if (ll_opt_stream_slots != 0)
    {
-      fprintf(stderr, "Usage: %s testname count size\n", argv[0]);
-      fprintf(stderr, "Size must be positive\n");
+      enum size_dist e_dist;
+      if (size_dist_from_name(argv[1], &e_dist) != 0)
+      {
+         fprintf(stderr, USAGE, argv[0]);
+         fprintf(stderr, "-S needs uniform, lognormal, zipf or bimodal\n");
+         exit(EXIT_FAILURE);
+      }
+      if (*pll_count < 0 || (*pll_count == 0 && d_opt_duration <= 0.0))
+      {
+         fprintf(stderr, USAGE, argv[0]);
+         fprintf(stderr, "Count must be positive, or 0 with -D\n");
+         exit(EXIT_FAILURE);
+      }
+      return;
+   }
+   if (*pll_count <= 0)
+   {
+      fprintf(stderr, USAGE, argv[0]);
+      fprintf(stderr, "Count must be positive\n");
+      exit(EXIT_FAILURE);
+   }
+   if (*pll_count > MAX_CALLS)
+   {
+      fprintf(stderr, USAGE, argv[0]);
+      fprintf(stderr, "Count cannot be greater than %d\n", MAX_CALLS);
       exit(EXIT_FAILURE);
    }
 }
@@ -245,6 +528,108 @@ static void set_cpu_limit(void)
 
 /*--------------------------------------------------------------------*/
 
+static void print_stats(const char *pc_when,
+   const struct heapmgr_stats *ps_stats)
+
+/* Write the heapmgr_stats() snapshot *ps_stats to stdout, labelled
+   with pc_when.  The search histogram is printed as "bucket:count"
+   for non-empty buckets only. */
+
+{
+   const struct heapmgr_stats s_stats = *ps_stats;
+   int i;
+
+   printf("   stats %s: heap %zu in_use %zu free %zu free_blocks %zu "
+          "largest_free %zu\n",
+          pc_when, s_stats.ui_heap_bytes, s_stats.ui_bytes_in_use,
+          s_stats.ui_bytes_free, s_stats.ui_free_blocks,
+          s_stats.ui_largest_free);
+   printf("   stats %s: mallocs %lu frees %lu growths %lu splits %lu "
+          "coalesces %lu\n",
+          pc_when, s_stats.ul_mallocs, s_stats.ul_frees,
+          s_stats.ul_growths, s_stats.ul_splits, s_stats.ul_coalesces);
+   printf("   stats %s: search", pc_when);
+   for (i = 0; i < HEAPMGR_SEARCH_BUCKETS; i++)
+      if (s_stats.aul_search_hist[i] != 0)
+         printf(" %d:%lu", i, s_stats.aul_search_hist[i]);
+   printf("\n");
+}
+
+/*--------------------------------------------------------------------*/
+
+static void *timed_malloc(size_t ui_bytes)
+
+/* Call heapmgr_malloc(ui_bytes) and return its result.  In -l mode,
+   also record how long the call took; in -t mode, record the call in
+   the trace; in -m mode, account for it in the memory series. */
+
+{
+   unsigned long long ull_start;
+   void *pv;
+
+   if (!i_opt_latency && pc_opt_trace == NULL && pc_opt_memseries == NULL)
+      return heapmgr_malloc(ui_bytes);
+
+   if (i_opt_latency)
+   {
+      ull_start = latency_ticks();
+      pv = heapmgr_malloc(ui_bytes);
+      latency_record(&s_malloc_latency,
+         latency_interval(ull_start, latency_ticks()));
+   }
+   else
+      pv = heapmgr_malloc(ui_bytes);
+
+   if ((pc_opt_trace != NULL || pc_opt_memseries != NULL) && pv != NULL)
+   {
+      unsigned long ul_id = trace_ids_assign(&s_trace_ids, pv);
+      if (pc_opt_trace != NULL)
+         trace_write(&s_trace, TRACE_MALLOC, ul_id, ui_bytes);
+      if (pc_opt_memseries != NULL)
+         mem_series_malloc(&s_memseries, ul_id, ui_bytes);
+   }
+   if (pc_opt_memseries != NULL)
+      mem_series_call(&s_memseries);
+   return pv;
+}
+
+/*--------------------------------------------------------------------*/
+
+static void timed_free(void *pv_bytes)
+
+/* Call heapmgr_free(pv_bytes).  In -l mode, also record how long the
+   call took; in -t mode, record the call in the trace; in -m mode,
+   account for it in the memory series.  The trace entry is written
+   first because the id must be looked up while pv_bytes is still
+   live. */
+
+{
+   unsigned long long ull_start;
+
+   if ((pc_opt_trace != NULL || pc_opt_memseries != NULL) && pv_bytes != NULL)
+   {
+      long l_id = trace_ids_release(&s_trace_ids, pv_bytes);
+      if (pc_opt_trace != NULL && l_id >= 0)
+         trace_write(&s_trace, TRACE_FREE, (unsigned long)l_id, 0);
+      if (pc_opt_memseries != NULL)
+         mem_series_free(&s_memseries, l_id);
+   }
+
+   if (!i_opt_latency)
+      heapmgr_free(pv_bytes);
+   else
+   {
+      ull_start = latency_ticks();
+      heapmgr_free(pv_bytes);
+      latency_record(&s_free_latency,
+         latency_interval(ull_start, latency_ticks()));
+   }
+   if (pc_opt_memseries != NULL)
+      mem_series_call(&s_memseries);
+}
+
+/*--------------------------------------------------------------------*/
+
 #define ASSURE(i) assure(i, __LINE__)
 
 static void assure(int i_successful, int i_lineNum)
@@ -270,7 +655,7 @@ static void test_LIFO_fixed_malloc(int i_count, int i_size)
    /* Call heapmgr_malloc() repeatedly to fill apc_chunks. */
    for (i = 0; i < i_count; i++)
    {
-      apc_chunks[i] = (char*)heapmgr_malloc((size_t)i_size);
+      apc_chunks[i] = (char*)timed_malloc((size_t)i_size);
       ASSURE(apc_chunks[i] != NULL);
 
       #ifndef NDEBUG
@@ -308,7 +693,7 @@ static void test_LIFO_fixed_free(int i_count, int i_size)
       }
       #endif
 
-      heapmgr_free(apc_chunks[i]);
+      timed_free(apc_chunks[i]);
    }
 }
 
@@ -326,7 +711,7 @@ static void test_FIFO_fixed_malloc(int i_count, int i_size)
    /* Call heapmgr_malloc() repeatedly to fill apc_chunks. */
    for (i = 0; i < i_count; i++)
    {
-      apc_chunks[i] = (char*)heapmgr_malloc((size_t)i_size);
+      apc_chunks[i] = (char*)timed_malloc((size_t)i_size);
       ASSURE(apc_chunks[i] != NULL);
 
       #ifndef NDEBUG
@@ -364,7 +749,7 @@ static void test_FIFO_fixed_free(int i_count, int i_size)
       }
       #endif
 
-      heapmgr_free(apc_chunks[i]);
+      timed_free(apc_chunks[i]);
    }
 }
 
@@ -386,7 +771,7 @@ static void test_LIFO_random_malloc(int i_count, int i_size)
    /* Call heapmgr_malloc() repeatedly to fill apc_chunks. */
    for (i = 0; i < i_count; i++)
    {
-      apc_chunks[i] = (char*)heapmgr_malloc((size_t)ai_sizes[i]);
+      apc_chunks[i] = (char*)timed_malloc((size_t)ai_sizes[i]);
       ASSURE(apc_chunks[i] != NULL);
 
       #ifndef NDEBUG
@@ -424,7 +809,7 @@ static void test_LIFO_random_free(int i_count, int i_size)
       }
       #endif
 
-      heapmgr_free(apc_chunks[i]);
+      timed_free(apc_chunks[i]);
    }
 }
 
@@ -446,7 +831,7 @@ static void test_FIFO_random_malloc(int i_count, int i_size)
    /* Call heapmgr_malloc() repeatedly to fill apc_chunks. */
    for (i = 0; i < i_count; i++)
    {
-      apc_chunks[i] = (char*)heapmgr_malloc((size_t)ai_sizes[i]);
+      apc_chunks[i] = (char*)timed_malloc((size_t)ai_sizes[i]);
       ASSURE(apc_chunks[i] != NULL);
 
       #ifndef NDEBUG
@@ -484,7 +869,7 @@ static void test_FIFO_random_free(int i_count, int i_size)
       }
       #endif
 
-      heapmgr_free(apc_chunks[i]);
+      timed_free(apc_chunks[i]);
    }
 }
 
@@ -507,7 +892,7 @@ static void test_random_fixed(int i_count, int i_size)
    i_rand = 0;
    for (i = 0; i < i_count; i++)
    {
-      apc_chunks[i_rand] = (char*)heapmgr_malloc((size_t)i_size);
+      apc_chunks[i_rand] = (char*)timed_malloc((size_t)i_size);
       ASSURE(apc_chunks[i_rand] != NULL);
       
       #ifndef NDEBUG
@@ -541,7 +926,7 @@ static void test_random_fixed(int i_count, int i_size)
          }
          #endif
 
-         heapmgr_free(apc_chunks[i_rand]);
+         timed_free(apc_chunks[i_rand]);
          apc_chunks[i_rand] = NULL;
       }
    }
@@ -562,7 +947,7 @@ static void test_random_fixed(int i_count, int i_size)
          }
          #endif
 
-         heapmgr_free(apc_chunks[i]);
+         timed_free(apc_chunks[i]);
          apc_chunks[i] = NULL;
       }
    }
@@ -592,7 +977,7 @@ static void test_random_random(int i_count, int i_size)
    i_rand = 0;
    for (i = 0; i < i_count; i++)
    {
-      apc_chunks[i_rand] = (char*)heapmgr_malloc((size_t)ai_sizes[i_rand]);
+      apc_chunks[i_rand] = (char*)timed_malloc((size_t)ai_sizes[i_rand]);
       ASSURE(apc_chunks[i_rand] != NULL);
 
       #ifndef NDEBUG
@@ -626,7 +1011,7 @@ static void test_random_random(int i_count, int i_size)
          }
          #endif
 
-         heapmgr_free(apc_chunks[i_rand]);
+         timed_free(apc_chunks[i_rand]);
          apc_chunks[i_rand] = NULL;
       }
    }
@@ -647,7 +1032,7 @@ static void test_random_random(int i_count, int i_size)
          }
          #endif
 
-         heapmgr_free(apc_chunks[i]);
+         timed_free(apc_chunks[i]);
          apc_chunks[i] = NULL;
       }
    }
@@ -669,7 +1054,7 @@ static void test_worst(int i_count, int i_size)
    i = 0;
    while (i < i_count)
    {
-      apc_chunks[i] = heapmgr_malloc((size_t)(((size_t)i * i_size / i_count) + 1));
+      apc_chunks[i] = timed_malloc((size_t)(((size_t)i * i_size / i_count) + 1));
       ASSURE((i == 0) || (apc_chunks[i] != NULL));
 
       #ifndef NDEBUG
@@ -687,7 +1072,7 @@ static void test_worst(int i_count, int i_size)
       #endif
       i++;
       if (i >= i_count) break;
-      apc_chunks[i] = heapmgr_malloc((size_t)1);
+      apc_chunks[i] = timed_malloc((size_t)1);
       i++;
    }
 
@@ -708,18 +1093,504 @@ static void test_worst(int i_count, int i_size)
                ASSURE(apc_chunks[i][i_col] == c);
          }
          #endif
-         heapmgr_free(apc_chunks[i]);
+         timed_free(apc_chunks[i]);
       }
 
    /* Allocate chunks in decreasing order by size, thus maximizing the
       amount of list traversal required. */
    i = (i_count % 2 == 0 ? i_count - 2 : i_count - 1);
    for (; i >= 0; i -= 2) {
-      apc_chunks[i] = heapmgr_malloc((size_t)(((size_t)i * i_size / i_count) + 1));
+      apc_chunks[i] = timed_malloc((size_t)(((size_t)i * i_size / i_count) + 1));
       ASSURE(apc_chunks[i] != NULL);
    }
 
    /* Free all chunks. */
    for (i = 0; i < i_count; i++)
-      heapmgr_free(apc_chunks[i]);
+      timed_free(apc_chunks[i]);
+}
+/*--------------------------------------------------------------------*/
+
+static void test_huge_mixed(int i_count, int i_size)
+
+/* Allocate and free i_count memory chunks, each of some random size
+   less than i_size, in a random order.  Every HUGE_PERIOD calls,
+   also free the current huge chunk and allocate a new one of
+   HUGE_CHUNK_BYTES or HUGE_CHUNK_BYTES / 2 bytes, so multi-GiB blocks
+   are split and coalesced next to the small ones.  Only the first
+   and last byte of a huge chunk are checked, so the test does not
+   touch gigabytes of memory. */
+
+{
+   int i;
+   int i_rand;
+   int i_logical_array_size;
+   char *pc_huge = NULL;
+   size_t ui_huge_size = 0;
+
+   i_logical_array_size = (i_count / 3) + 1;
+
+   /* Fill ai_sizes, an array of random integers in the range 1
+      to i_size. */
+   for (i = 0; i < i_logical_array_size; i++)
+      ai_sizes[i] = (rand() % i_size) + 1;
+
+   i_rand = 0;
+   for (i = 0; i < i_count; i++)
+   {
+      if (i % HUGE_PERIOD == 0)
+      {
+         if (pc_huge != NULL)
+         {
+            #ifndef NDEBUG
+            ASSURE(pc_huge[0] == 'H');
+            ASSURE(pc_huge[ui_huge_size - 1] == 'H');
+            #endif
+            timed_free(pc_huge);
+         }
+
+         ui_huge_size = ((i / HUGE_PERIOD) % 2 == 0) ?
+            HUGE_CHUNK_BYTES : HUGE_CHUNK_BYTES / 2;
+         pc_huge = (char*)timed_malloc(ui_huge_size);
+         ASSURE(pc_huge != NULL);
+
+         #ifndef NDEBUG
+         if (pc_huge != NULL)
+         {
+            pc_huge[0] = 'H';
+            pc_huge[ui_huge_size - 1] = 'H';
+         }
+         #endif
+      }
+
+      apc_chunks[i_rand] = (char*)timed_malloc((size_t)ai_sizes[i_rand]);
+      ASSURE(apc_chunks[i_rand] != NULL);
+
+      #ifndef NDEBUG
+      {
+         int i_col;
+         char c = (char)((i_rand % 10) + '0');
+         for (i_col = 0; i_col < ai_sizes[i_rand]; i_col++)
+            apc_chunks[i_rand][i_col] = c;
+      }
+      #endif
+
+      /* Assign some random integer to i_rand. */
+      i_rand = rand() % i_logical_array_size;
+
+      /* If apc_chunks[i_rand] contains a chunk, free it and set
+         apc_chunks[i_rand] to NULL. */
+      if (apc_chunks[i_rand] != NULL)
+      {
+         #ifndef NDEBUG
+         {
+            int i_col;
+            char c = (char)((i_rand % 10) + '0');
+            for (i_col = 0; i_col < ai_sizes[i_rand]; i_col++)
+               ASSURE(apc_chunks[i_rand][i_col] == c);
+         }
+         #endif
+
+         timed_free(apc_chunks[i_rand]);
+         apc_chunks[i_rand] = NULL;
+      }
+   }
+
+   /* Free the rest of the chunks. */
+   for (i = 0; i < i_logical_array_size; i++)
+   {
+      if (apc_chunks[i] != NULL)
+      {
+         timed_free(apc_chunks[i]);
+         apc_chunks[i] = NULL;
+      }
+   }
+   timed_free(pc_huge);
+}
+
+/*--------------------------------------------------------------------*/
+
+static void malloc_indexed(int i, int i_bytes)
+
+/* Allocate chunk i of i_bytes bytes and, in debug builds, fill it so
+   that free_indexed() can check it. */
+
+{
+   ai_sizes[i] = i_bytes;
+   apc_chunks[i] = (char*)timed_malloc((size_t)i_bytes);
+   ASSURE(apc_chunks[i] != NULL);
+
+   #ifndef NDEBUG
+   {
+      int i_col;
+      char c = (char)((i % 10) + '0');
+      for (i_col = 0; i_col < i_bytes; i_col++)
+         apc_chunks[i][i_col] = c;
+   }
+   #endif
+}
+
+static void free_indexed(int i)
+
+/* Check and free chunk i of test_generated() or of the adversarial
+   tests. */
+
+{
+   #ifndef NDEBUG
+   {
+      int i_col;
+      char c = (char)((i % 10) + '0');
+      for (i_col = 0; i_col < ai_sizes[i]; i_col++)
+         ASSURE(apc_chunks[i][i_col] == c);
+   }
+   #endif
+
+   timed_free(apc_chunks[i]);
+   apc_chunks[i] = NULL;
+}
+
+/*--------------------------------------------------------------------*/
+
+static void test_generated(int i_count, int i_size)
+
+/* Allocate i_count memory chunks with sizes drawn from s_size_gen.
+   When chunk i is allocated, s_life_gen gives it a death time; it is
+   freed once that many chunks have been allocated.  Chunks still
+   live at the end are freed in order of death.  i_size has already
+   been given to the generators. */
+
+{
+   int i;
+
+   (void)i_size;
+   death_heap_init(&s_deaths, al_death, al_deaths);
+
+   for (i = 0; i < i_count; i++)
+   {
+      malloc_indexed(i, (int)size_gen_next(&s_size_gen, &s_rng));
+      al_death[i] = life_gen_death(&s_life_gen, &s_rng, i,
+         (size_t)ai_sizes[i]);
+      death_heap_push(&s_deaths, i);
+
+      while (s_deaths.l_count > 0 && death_heap_first(&s_deaths) <= i)
+         free_indexed((int)death_heap_pop(&s_deaths));
+   }
+
+   while (s_deaths.l_count > 0)
+      free_indexed((int)death_heap_pop(&s_deaths));
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Adversarial tests.  test_worst() only targets a single first-fit
+   list; each of these aims at a weakness of some other design and is
+   judged on both time and memory. */
+
+static void test_bin_straddle(int i_count, int i_size)
+
+/* Allocate and free i_count chunks in random order, like
+   random_random, but draw every size from just below and just above
+   a power of two (2^k and 2^k + 1, 2^k + 1 <= i_size) and a 16-byte
+   multiple.  A size-class engine rounds half of the requests up to
+   the next class, wasting up to half of each chunk, and its free
+   chunks of one class never satisfy requests of the class right
+   above, so it splits or grows instead of reusing them. */
+
+{
+   int ai_bounds[2 * 64];
+   int i_bounds = 0;
+   int i, i_rand, i_logical_array_size;
+   long l;
+
+   for (l = 16; l + 1 <= i_size && i_bounds < 2 * 64 - 1; l *= 2)
+   {
+      ai_bounds[i_bounds++] = (int)l;
+      ai_bounds[i_bounds++] = (int)l + 1;
+   }
+   if (i_bounds == 0)
+      ai_bounds[i_bounds++] = i_size;
+
+   i_logical_array_size = (i_count / 3) + 1;
+   i_rand = 0;
+   for (i = 0; i < i_count; i++)
+   {
+      malloc_indexed(i_rand, ai_bounds[rand() % i_bounds]);
+      i_rand = rand() % i_logical_array_size;
+      if (apc_chunks[i_rand] != NULL)
+         free_indexed(i_rand);
+   }
+   for (i = 0; i < i_logical_array_size; i++)
+      if (apc_chunks[i] != NULL)
+         free_indexed(i);
+}
+
+/*--------------------------------------------------------------------*/
+
+static void test_tiny_huge(int i_count, int i_size)
+
+/* In rounds of TINY_HUGE_PAIRS: allocate alternating 1-byte and
+   i_size/2-byte chunks, free every half-size chunk (each hole is
+   fenced by live tiny chunks, so nothing coalesces), allocate as many
+   i_size chunks (none fits a hole), then free the tiny chunks and
+   the i_size chunks.  An engine that coalesces immediately merges
+   the holes once the tiny chunks go; one that defers or never
+   coalesces, or keeps tiny and huge chunks in separate regions that
+   it cannot give back, keeps growing.  i_count calls in all. */
+
+{
+   int i_half = (i_size / 2 > 0) ? i_size / 2 : 1;
+   int i_rounds = i_count / (6 * TINY_HUGE_PAIRS);
+   int i_round, i;
+
+   if (i_rounds < 1)
+      i_rounds = 1;
+   for (i_round = 0; i_round < i_rounds; i_round++)
+   {
+      for (i = 0; i < TINY_HUGE_PAIRS; i++)
+      {
+         malloc_indexed(2 * i, 1);
+         malloc_indexed(2 * i + 1, i_half);
+      }
+      for (i = 0; i < TINY_HUGE_PAIRS; i++)
+         free_indexed(2 * i + 1);
+      for (i = 0; i < TINY_HUGE_PAIRS; i++)
+         malloc_indexed(2 * TINY_HUGE_PAIRS + i, i_size);
+      for (i = 0; i < TINY_HUGE_PAIRS; i++)
+         free_indexed(2 * i);
+      for (i = 0; i < TINY_HUGE_PAIRS; i++)
+         free_indexed(2 * TINY_HUGE_PAIRS + i);
+   }
+}
+
+/*--------------------------------------------------------------------*/
+
+static void test_sawtooth(int i_count, int i_size)
+
+/* SAWTOOTH_TEETH times, allocate i_count / (2 * SAWTOOTH_TEETH)
+   chunks of random size and then free all of them, alternately in
+   LIFO and FIFO order.  The live set climbs from nothing to its peak
+   and back, so an engine that returns memory to the system at the
+   bottom of each tooth pays for growing the heap again at every
+   tooth, and one that caches per-size memory must show that it can
+   reuse the previous tooth's memory for the next. */
+
+{
+   int i_chunks = i_count / (2 * SAWTOOTH_TEETH);
+   int i_tooth, i;
+
+   if (i_chunks < 1)
+      i_chunks = 1;
+   for (i_tooth = 0; i_tooth < SAWTOOTH_TEETH; i_tooth++)
+   {
+      for (i = 0; i < i_chunks; i++)
+         malloc_indexed(i, (rand() % i_size) + 1);
+      if (i_tooth % 2 == 0)
+         for (i = i_chunks - 1; i >= 0; i--)
+            free_indexed(i);
+      else
+         for (i = 0; i < i_chunks; i++)
+            free_indexed(i);
+   }
+}
+
+/*--------------------------------------------------------------------*/
+
+static void test_pinning(int i_count, int i_size)
+
+/* Keep two chunks of i_size/2 to i_size bytes live.  Each round
+   allocates the next large chunk, then a small long-lived "pin" of
+   1 to 16 bytes, and only then frees the oldest large chunk.  A
+   first-fit or best-fit engine carves each pin out of the hole the
+   previous free left, so no hole is ever large enough again and the
+   heap grows by about one large chunk per round although the live
+   data stays small.  Engines that keep small chunks apart from large
+   ones are unaffected.  Memory use is the measure.  i_count calls in
+   all. */
+
+{
+   int i_rounds = i_count / 3;
+   int i_half = i_size / 2;
+   int i;
+
+   malloc_indexed(0, i_size - rand() % (i_half + 1));
+   for (i = 0; i < i_rounds; i++)
+   {
+      malloc_indexed(2 * i + 2, i_size - rand() % (i_half + 1));
+      malloc_indexed(2 * i + 1, (rand() % 16) + 1);
+      free_indexed(2 * i);
+   }
+   free_indexed(2 * i_rounds);
+   for (i = 0; i < i_rounds; i++)
+      free_indexed(2 * i + 1);
+}
+
+/*--------------------------------------------------------------------*/
+
+/* One entry of run_stream()'s live set. */
+struct stream_slot {
+   char *pc_chunk;
+   size_t ui_size;
+};
+
+static double wall_seconds(void)
+{
+   struct timespec s_now;
+   clock_gettime(CLOCK_MONOTONIC, &s_now);
+   return (double)s_now.tv_sec + (double)s_now.tv_nsec / 1e9;
+}
+
+/*--------------------------------------------------------------------*/
+
+static void check_stream_slot(const struct stream_slot *ps_slot,
+   long long ll_slot)
+
+/* Make sure that the contents of a streaming chunk haven't been
+   corrupted. */
+
+{
+   #ifndef NDEBUG
+   size_t ui_col;
+   char c = (char)((ll_slot % 10) + '0');
+   for (ui_col = 0; ui_col < ps_slot->ui_size; ui_col++)
+      ASSURE(ps_slot->pc_chunk[ui_col] == c);
+   #else
+   (void)ps_slot;
+   (void)ll_slot;
+   #endif
+}
+
+static void fill_stream_slot(struct stream_slot *ps_slot, long long ll_slot)
+{
+   #ifndef NDEBUG
+   memset(ps_slot->pc_chunk, (ll_slot % 10) + '0', ps_slot->ui_size);
+   #else
+   (void)ps_slot;
+   (void)ll_slot;
+   #endif
+}
+
+/*--------------------------------------------------------------------*/
+
+static void print_stream_line(const char *pc_label, double d_elapsed,
+   long long ll_ops, long long ll_interval_ops, double d_interval,
+   size_t ui_live, const struct heapmgr_stats *ps_stats)
+
+/* Write one streaming progress or summary line.  ops/s is over the
+   last interval, so throughput decay is not averaged away. */
+
+{
+   const struct heapmgr_stats s_stats = *ps_stats;
+   printf("   %s %9.1f s ops %lld ops/s %.0f live %zu heap %zu "
+          "free_blocks %zu frag %.3f\n",
+          pc_label, d_elapsed, ll_ops,
+          d_interval > 0.0 ? (double)ll_interval_ops / d_interval : 0.0,
+          ui_live, s_stats.ui_heap_bytes, s_stats.ui_free_blocks,
+          s_stats.ui_heap_bytes > 0 ?
+             1.0 - (double)ui_live / (double)s_stats.ui_heap_bytes : 0.0);
+   fflush(stdout);
+}
+
+/*--------------------------------------------------------------------*/
+
+static void run_stream(long long ll_count, int i_size)
+
+/* Streaming mode.  Fill a table of ll_opt_stream_slots chunks with
+   sizes from s_size_gen, then ll_count times (or until -D seconds
+   have passed, if ll_count is 0) free the chunk in a random slot and
+   allocate a new one in its place.  The live set therefore stays at
+   the slot count and lifetimes are geometric with that mean.  The
+   slot table is mmap()ed, so neither the live set nor the number of
+   operations is limited by MAX_CALLS, and no CPU time limit is set.
+   Every ll_opt_progress replacements print wall time, replacements
+   per second over the interval, live requested bytes, heap size and
+   fragmentation; at the end print the same for the whole run plus
+   the peak heap size. */
+
+{
+   size_t ui_table_bytes = (size_t)ll_opt_stream_slots * sizeof(struct stream_slot);
+   struct stream_slot *ps_slots;
+   size_t ui_live = 0, ui_peak_heap = 0;
+   long long ll_ops, ll_slot, ll_last_ops = 0;
+   double d_start, d_last, d_now;
+   struct heapmgr_stats s_stats;
+
+   (void)i_size;
+
+   ps_slots = mmap(NULL, ui_table_bytes, PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+   if (ps_slots == MAP_FAILED)
+   {
+      perror("mmap");
+      exit(EXIT_FAILURE);
+   }
+
+   d_start = d_last = wall_seconds();
+   for (ll_slot = 0; ll_slot < ll_opt_stream_slots; ll_slot++)
+   {
+      struct stream_slot *ps_slot = &ps_slots[ll_slot];
+      ps_slot->ui_size = size_gen_next(&s_size_gen, &s_rng);
+      ps_slot->pc_chunk = (char*)timed_malloc(ps_slot->ui_size);
+      ASSURE(ps_slot->pc_chunk != NULL);
+      fill_stream_slot(ps_slot, ll_slot);
+      ui_live += ps_slot->ui_size;
+   }
+   d_now = wall_seconds();
+   heapmgr_stats(&s_stats);
+   ui_peak_heap = s_stats.ui_heap_bytes;
+   print_stream_line("filled  ", d_now - d_start, 0, 0, 0.0, ui_live,
+      &s_stats);
+   d_last = d_now;
+
+   for (ll_ops = 0; ll_count == 0 || ll_ops < ll_count; )
+   {
+      struct stream_slot *ps_slot;
+
+      ll_slot = (long long)(prng_next(&s_rng) % (unsigned long long)ll_opt_stream_slots);
+      ps_slot = &ps_slots[ll_slot];
+      check_stream_slot(ps_slot, ll_slot);
+      timed_free(ps_slot->pc_chunk);
+      ui_live -= ps_slot->ui_size;
+
+      ps_slot->ui_size = size_gen_next(&s_size_gen, &s_rng);
+      ps_slot->pc_chunk = (char*)timed_malloc(ps_slot->ui_size);
+      ASSURE(ps_slot->pc_chunk != NULL);
+      fill_stream_slot(ps_slot, ll_slot);
+      ui_live += ps_slot->ui_size;
+      ll_ops++;
+
+      if (ll_ops % ll_opt_progress == 0)
+      {
+         d_now = wall_seconds();
+         heapmgr_stats(&s_stats);
+         if (s_stats.ui_heap_bytes > ui_peak_heap)
+            ui_peak_heap = s_stats.ui_heap_bytes;
+         print_stream_line("progress", d_now - d_start, ll_ops,
+            ll_ops - ll_last_ops, d_now - d_last, ui_live, &s_stats);
+         d_last = d_now;
+         ll_last_ops = ll_ops;
+      }
+      if (d_opt_duration > 0.0 && (ll_ops & 4095) == 0
+          && wall_seconds() - d_start >= d_opt_duration)
+         break;
+   }
+
+   d_now = wall_seconds();
+   heapmgr_stats(&s_stats);
+   if (s_stats.ui_heap_bytes > ui_peak_heap)
+      ui_peak_heap = s_stats.ui_heap_bytes;
+   print_stream_line("total   ", d_now - d_start, ll_ops, ll_ops,
+      d_now - d_start, ui_live, &s_stats);
+   printf("   peak heap %zu\n", ui_peak_heap);
+
+   for (ll_slot = 0; ll_slot < ll_opt_stream_slots; ll_slot++)
+   {
+      check_stream_slot(&ps_slots[ll_slot], ll_slot);
+      timed_free(ps_slots[ll_slot].pc_chunk);
+   }
+   munmap(ps_slots, ui_table_bytes);
+
+   if (i_opt_latency)
+   {
+      latency_print("malloc", &s_malloc_latency);
+      latency_print("free", &s_free_latency);
+   }
 }
\ No newline at end of file
@@ -0,0 +1,345 @@
+/*--------------------------------------------------------------------*/
+/* topheapmgr.c                                                       */
+/* Live view of a running heapmgr1 process through its stats page     */
+/*--------------------------------------------------------------------*/
+
+#include "heapmgr1.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define USAGE "Usage: %s pid [-i seconds] [-n samples] [-o file]\n"
+
+/* Header line repeated every HEADER_EVERY samples. */
+enum {HEADER_EVERY = 20};
+
+/*--------------------------------------------------------------------*/
+
+static double now_s(void)
+{
+   struct timespec s_now;
+   clock_gettime(CLOCK_MONOTONIC, &s_now);
+   return (double)s_now.tv_sec + (double)s_now.tv_nsec / 1e9;
+}
+
+static void snapshot(const struct heapmgr_stats_page *ps_live,
+   struct heapmgr_stats_page *ps_copy)
+
+/* Copy the counters of *ps_live, which the other process keeps
+   changing, into *ps_copy one whole field at a time. */
+
+{
+   const struct heapmgr_stats *ps_page = &ps_live->s_stats;
+   struct heapmgr_stats *ps_stats = &ps_copy->s_stats;
+   int i;
+   ps_stats->ui_heap_bytes = __atomic_load_n(&ps_page->ui_heap_bytes, __ATOMIC_RELAXED);
+   ps_stats->ui_bytes_free = __atomic_load_n(&ps_page->ui_bytes_free, __ATOMIC_RELAXED);
+   ps_stats->ui_free_blocks = __atomic_load_n(&ps_page->ui_free_blocks, __ATOMIC_RELAXED);
+   ps_stats->ul_mallocs = __atomic_load_n(&ps_page->ul_mallocs, __ATOMIC_RELAXED);
+   ps_stats->ul_frees = __atomic_load_n(&ps_page->ul_frees, __ATOMIC_RELAXED);
+   ps_stats->ul_growths = __atomic_load_n(&ps_page->ul_growths, __ATOMIC_RELAXED);
+   ps_stats->ul_splits = __atomic_load_n(&ps_page->ul_splits, __ATOMIC_RELAXED);
+   ps_stats->ul_coalesces = __atomic_load_n(&ps_page->ul_coalesces, __ATOMIC_RELAXED);
+   for (i = 0; i < HEAPMGR_SEARCH_BUCKETS; i++)
+      ps_stats->aul_search_hist[i] =
+         __atomic_load_n(&ps_page->aul_search_hist[i], __ATOMIC_RELAXED);
+   for (i = 0; i < HEAPMGR_SEARCH_BUCKETS; i++)
+      ps_copy->aul_length_hist[i] =
+         __atomic_load_n(&ps_live->aul_length_hist[i], __ATOMIC_RELAXED);
+   /* The two loads are not simultaneous; never report less than 0. */
+   ps_stats->ui_bytes_in_use = ps_stats->ui_heap_bytes > ps_stats->ui_bytes_free
+      ? ps_stats->ui_heap_bytes - ps_stats->ui_bytes_free : 0;
+}
+
+static unsigned long bucket_max(int i_bucket)
+
+/* The largest value counted in histogram bucket i_bucket (see
+   heapmgr.h); the last bucket has no bound. */
+
+{
+   return i_bucket == 0 ? 0 : (1ul << i_bucket) - 1;
+}
+
+static long percentile(const unsigned long *pul_old,
+   const unsigned long *pul_new, double d_p)
+
+/* Return the upper bound of the bucket holding the d_p percentile of
+   the mallocs counted in histogram pul_new but not yet in pul_old,
+   -1 if it is the unbounded last bucket, or -2 if there were none. */
+
+{
+   unsigned long ul_total = 0, ul_seen = 0, aul_d[HEAPMGR_SEARCH_BUCKETS];
+   int i;
+
+   for (i = 0; i < HEAPMGR_SEARCH_BUCKETS; i++)
+   {
+      aul_d[i] = pul_new[i] - pul_old[i];
+      ul_total += aul_d[i];
+   }
+   if (ul_total == 0)
+      return -2;
+   for (i = 0; i < HEAPMGR_SEARCH_BUCKETS - 1; i++)
+   {
+      ul_seen += aul_d[i];
+      if ((double)ul_seen >= d_p / 100.0 * (double)ul_total)
+         return (long)bucket_max(i);
+   }
+   return -1;
+}
+
+/*--------------------------------------------------------------------*/
+
+static int gone(int i_pid, const char *pc_name)
+
+/* Return 1 if process i_pid has ended: it no longer exists, or it
+   removed its stats page pc_name at exit() (it may still be a
+   zombie). */
+
+{
+   int i_fd;
+   if (kill(i_pid, 0) != 0 && errno == ESRCH)
+      return 1;
+   if ((i_fd = shm_open(pc_name, O_RDONLY, 0)) < 0)
+      return errno == ENOENT;
+   close(i_fd);
+   return 0;
+}
+
+/*--------------------------------------------------------------------*/
+
+static void print_header(void)
+{
+   printf("%8s %10s %10s %10s %9s %11s %11s %8s %6s %6s %6s %6s\n", "time s",
+      "heap MB", "in use MB", "free MB", "free blks", "malloc/s", "free/s",
+      "grow/s", "srch50", "srch99", "len50", "len99");
+}
+
+static void print_bound(long l_bound)
+{
+   if (l_bound == -2)
+      printf(" %6s", "-");
+   else if (l_bound == -1)
+      printf(" %6s", "more");
+   else
+      printf(" %6ld", l_bound);
+}
+
+static void print_line(double d_t, double d_dt,
+   const struct heapmgr_stats_page *ps_old_page,
+   const struct heapmgr_stats_page *ps_new_page)
+
+/* Print the state at *ps_new_page and the rates since *ps_old_page,
+   d_dt seconds earlier. */
+
+{
+   const struct heapmgr_stats *ps_old = &ps_old_page->s_stats;
+   const struct heapmgr_stats *ps_new = &ps_new_page->s_stats;
+   printf("%8.1f %10.1f %10.1f %10.1f %9zu %11.0f %11.0f %8.1f", d_t,
+      (double)ps_new->ui_heap_bytes / 1e6, (double)ps_new->ui_bytes_in_use / 1e6,
+      (double)ps_new->ui_bytes_free / 1e6, ps_new->ui_free_blocks,
+      (double)(ps_new->ul_mallocs - ps_old->ul_mallocs) / d_dt,
+      (double)(ps_new->ul_frees - ps_old->ul_frees) / d_dt,
+      (double)(ps_new->ul_growths - ps_old->ul_growths) / d_dt);
+   print_bound(percentile(ps_old->aul_search_hist, ps_new->aul_search_hist, 50.0));
+   print_bound(percentile(ps_old->aul_search_hist, ps_new->aul_search_hist, 99.0));
+   print_bound(percentile(ps_old_page->aul_length_hist,
+      ps_new_page->aul_length_hist, 50.0));
+   print_bound(percentile(ps_old_page->aul_length_hist,
+      ps_new_page->aul_length_hist, 99.0));
+   printf("\n");
+   fflush(stdout);
+}
+
+/*--------------------------------------------------------------------*/
+
+static void write_hist(FILE *ps_file, const char *pc_name,
+   const char *pc_help, int i_pid, const unsigned long *pul_hist)
+
+/* Write histogram pul_hist to ps_file as the Prometheus counter
+   heapmgr_<pc_name>, one sample per bucket (not cumulative), since
+   the page has no sum to make it a Prometheus histogram. */
+
+{
+   int i;
+   fprintf(ps_file, "# HELP heapmgr_%s %s\n# TYPE heapmgr_%s counter\n",
+      pc_name, pc_help, pc_name);
+   for (i = 0; i < HEAPMGR_SEARCH_BUCKETS; i++)
+   {
+      if (i == HEAPMGR_SEARCH_BUCKETS - 1)
+         fprintf(ps_file, "heapmgr_%s{pid=\"%d\",max=\"+Inf\"} %lu\n",
+            pc_name, i_pid, pul_hist[i]);
+      else
+         fprintf(ps_file, "heapmgr_%s{pid=\"%d\",max=\"%lu\"} %lu\n",
+            pc_name, i_pid, bucket_max(i), pul_hist[i]);
+   }
+}
+
+static int write_prometheus(const char *pc_path, int i_pid,
+   const struct heapmgr_stats_page *ps_page)
+
+/* Replace pc_path with the counters of *ps_page in the Prometheus
+   text exposition format.  The file is written under a temporary
+   name and renamed, so a collector never reads half of it.  Return
+   0, or -1 with errno set. */
+
+{
+   static const char *apc_gauges[][2] = {
+      {"heap_bytes", "Bytes obtained from the system."},
+      {"in_use_bytes", "Bytes in allocated blocks, overhead included."},
+      {"free_bytes", "Bytes in free blocks."},
+      {"free_blocks", "Number of free blocks."}};
+   static const char *apc_counters[][2] = {
+      {"mallocs_total", "Successful heapmgr_malloc() calls."},
+      {"frees_total", "heapmgr_free() calls with a block."},
+      {"growths_total", "Times the heap was grown."},
+      {"splits_total", "Free blocks split by an allocation."},
+      {"coalesces_total", "Pairs of free blocks merged."}};
+   const struct heapmgr_stats *ps_stats = &ps_page->s_stats;
+   unsigned long aul_values[] = {ps_stats->ui_heap_bytes,
+      ps_stats->ui_bytes_in_use, ps_stats->ui_bytes_free,
+      ps_stats->ui_free_blocks, ps_stats->ul_mallocs, ps_stats->ul_frees,
+      ps_stats->ul_growths, ps_stats->ul_splits, ps_stats->ul_coalesces};
+   char ac_tmp[4096];
+   FILE *ps_file;
+   size_t ui_k;
+
+   if (snprintf(ac_tmp, sizeof(ac_tmp), "%s.tmp", pc_path) >= (int)sizeof(ac_tmp))
+   {
+      errno = ENAMETOOLONG;
+      return -1;
+   }
+   if ((ps_file = fopen(ac_tmp, "w")) == NULL)
+      return -1;
+   for (ui_k = 0; ui_k < 4; ui_k++)
+      fprintf(ps_file, "# HELP heapmgr_%s %s\n# TYPE heapmgr_%s gauge\n"
+         "heapmgr_%s{pid=\"%d\"} %lu\n", apc_gauges[ui_k][0], apc_gauges[ui_k][1],
+         apc_gauges[ui_k][0], apc_gauges[ui_k][0], i_pid, aul_values[ui_k]);
+   for (ui_k = 0; ui_k < 5; ui_k++)
+      fprintf(ps_file, "# HELP heapmgr_%s %s\n# TYPE heapmgr_%s counter\n"
+         "heapmgr_%s{pid=\"%d\"} %lu\n", apc_counters[ui_k][0],
+         apc_counters[ui_k][1], apc_counters[ui_k][0], apc_counters[ui_k][0],
+         i_pid, aul_values[4 + ui_k]);
+
+   write_hist(ps_file, "malloc_search_total", "heapmgr_malloc() calls by"
+      " free-list nodes visited, at most max.", i_pid, ps_stats->aul_search_hist);
+   write_hist(ps_file, "malloc_free_list_length_total", "heapmgr_malloc() calls"
+      " by free-list length after the call, at most max.", i_pid,
+      ps_page->aul_length_hist);
+   if (fclose(ps_file) != 0)
+      return -1;
+   return rename(ac_tmp, pc_path);
+}
+
+/*--------------------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+
+/* Map the stats page of process pid (see heapmgr1.h) read-only and,
+   every -i seconds (default 1), print its heap size, bytes in use and
+   free, free block count, malloc, free and growth rates since the
+   last sample, and the median and 99th percentile of the free-list
+   search length and of the free-list length of the mallocs in
+   between, as the bound of the histogram bucket.  With -o, also write all counters to file in the
+   Prometheus text format after each sample (e.g. for the node
+   exporter's textfile collector).  Stop after -n samples, or when the
+   process exits.  Return 0, or EXIT_FAILURE if the page cannot be
+   mapped. */
+
+{
+   const char *pc_out = NULL;
+   double d_interval = 1.0, d_start, d_last;
+   long l_samples = -1, l_i;
+   int i_pid, i_fd, i;
+   char ac_name[64];
+   struct heapmgr_stats_page *ps_page;
+   struct heapmgr_stats_page s_old, s_new;
+
+   if (argc < 2 || (i_pid = atoi(argv[1])) <= 0)
+   {
+      fprintf(stderr, USAGE, argv[0]);
+      return EXIT_FAILURE;
+   }
+   for (i = 2; i < argc; i++)
+   {
+      if (strcmp(argv[i], "-i") == 0 && i + 1 < argc)
+         d_interval = atof(argv[++i]);
+      else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+         l_samples = atol(argv[++i]);
+      else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+         pc_out = argv[++i];
+      else
+         break;
+   }
+   if (i < argc || d_interval <= 0.0 || l_samples == 0)
+   {
+      fprintf(stderr, USAGE, argv[0]);
+      return EXIT_FAILURE;
+   }
+
+   snprintf(ac_name, sizeof(ac_name), HEAPMGR_STATS_PAGE_FMT, i_pid);
+   if ((i_fd = shm_open(ac_name, O_RDONLY, 0)) < 0)
+   {
+      fprintf(stderr, "%s: %s (was the process started with"
+         " HEAPMGR_STATS_PAGE=1?)\n", ac_name, strerror(errno));
+      return EXIT_FAILURE;
+   }
+   ps_page = mmap(NULL, sizeof(*ps_page), PROT_READ, MAP_SHARED, i_fd, 0);
+   close(i_fd);
+   if (ps_page == MAP_FAILED)
+   {
+      perror(ac_name);
+      return EXIT_FAILURE;
+   }
+   if (memcmp(ps_page->ac_magic, HEAPMGR_STATS_PAGE_MAGIC, sizeof(ps_page->ac_magic)) != 0
+       || ps_page->ui_version != HEAPMGR_STATS_PAGE_VERSION)
+   {
+      fprintf(stderr, "%s: not a heapmgr stats page of this version\n", ac_name);
+      return EXIT_FAILURE;
+   }
+   __atomic_thread_fence(__ATOMIC_ACQUIRE);
+   if (gone(i_pid, ac_name))
+   {
+      fprintf(stderr, "%s: process %d is gone; the page is stale\n", ac_name, i_pid);
+      return EXIT_FAILURE;
+   }
+
+   d_start = d_last = now_s();
+   snapshot(ps_page, &s_old);
+   for (l_i = 0; l_samples < 0 || l_i < l_samples; l_i++)
+   {
+      struct timespec s_sleep;
+      double d_now;
+      int i_gone;
+
+      s_sleep.tv_sec = (time_t)d_interval;
+      s_sleep.tv_nsec = (long)((d_interval - (double)s_sleep.tv_sec) * 1e9);
+      while (nanosleep(&s_sleep, &s_sleep) != 0 && errno == EINTR)
+         ;
+      /* Check first, so that the last sample is taken after exit. */
+      i_gone = gone(i_pid, ac_name);
+      snapshot(ps_page, &s_new);
+      d_now = now_s();
+      if (l_i % HEADER_EVERY == 0)
+         print_header();
+      print_line(d_now - d_start, d_now - d_last, &s_old, &s_new);
+      if (pc_out != NULL && write_prometheus(pc_out, i_pid, &s_new) != 0)
+      {
+         perror(pc_out);
+         return EXIT_FAILURE;
+      }
+      if (i_gone)
+      {
+         printf("process %d exited\n", i_pid);
+         break;
+      }
+      s_old = s_new;
+      d_last = d_now;
+   }
+   return 0;
+}
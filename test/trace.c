@@ -0,0 +1,381 @@
+/*--------------------------------------------------------------------*/
+/* trace.c                                                            */
+/*--------------------------------------------------------------------*/
+
+#include "trace.h"
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+/*--------------------------------------------------------------------*/
+
+static unsigned long long now_ns(void)
+{
+   struct timespec s_ts;
+   clock_gettime(CLOCK_MONOTONIC, &s_ts);
+   return (unsigned long long)s_ts.tv_sec * 1000000000ull
+      + (unsigned long long)s_ts.tv_nsec;
+}
+
+/*--------------------------------------------------------------------*/
+
+static int write_all(int i_fd, const unsigned char *puc, size_t ui_len)
+
+/* Write ui_len bytes at puc to i_fd, retrying short writes. */
+
+{
+   while (ui_len > 0)
+   {
+      ssize_t l = write(i_fd, puc, ui_len);
+      if (l < 0)
+      {
+         if (errno == EINTR)
+            continue;
+         return -1;
+      }
+      puc += l;
+      ui_len -= (size_t)l;
+   }
+   return 0;
+}
+
+/*--------------------------------------------------------------------*/
+
+static int flush_writer(struct trace_writer *ps_w)
+{
+   int i_ret = write_all(ps_w->i_fd, ps_w->auc_buf, ps_w->ui_len);
+   ps_w->ui_len = 0;
+   return i_ret;
+}
+
+/*--------------------------------------------------------------------*/
+
+static void put_varint(struct trace_writer *ps_w, unsigned long long ull_v)
+{
+   do
+   {
+      unsigned char uc = (unsigned char)(ull_v & 0x7f);
+      ull_v >>= 7;
+      ps_w->auc_buf[ps_w->ui_len++] = (unsigned char)(uc | (ull_v ? 0x80 : 0));
+   } while (ull_v != 0);
+}
+
+/*--------------------------------------------------------------------*/
+
+int trace_writer_open(struct trace_writer *ps_w, const char *pc_path)
+{
+   assert(ps_w != NULL);
+   assert(pc_path != NULL);
+
+   ps_w->i_fd = open(pc_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+   if (ps_w->i_fd < 0)
+      return -1;
+   ps_w->ui_len = 0;
+   ps_w->ull_last_ns = now_ns();
+   memcpy(ps_w->auc_buf, TRACE_MAGIC, 8);
+   ps_w->ui_len = 8;
+   return 0;
+}
+
+/*--------------------------------------------------------------------*/
+
+int trace_write(struct trace_writer *ps_w, int i_op, unsigned long ul_id,
+   size_t ui_size)
+
+/* A record is at most three 10-byte varints, so flush when fewer than
+   30 bytes are left. */
+
+{
+   unsigned long long ull_now = now_ns();
+
+   assert(i_op == TRACE_MALLOC || i_op == TRACE_FREE);
+
+   if (TRACE_BUF_BYTES - ps_w->ui_len < 30 && flush_writer(ps_w) != 0)
+      return -1;
+   put_varint(ps_w, ((unsigned long long)ul_id << 1) | (unsigned)i_op);
+   put_varint(ps_w, ull_now - ps_w->ull_last_ns);
+   if (i_op == TRACE_MALLOC)
+      put_varint(ps_w, ui_size);
+   ps_w->ull_last_ns = ull_now;
+   return 0;
+}
+
+/*--------------------------------------------------------------------*/
+
+int trace_writer_close(struct trace_writer *ps_w)
+{
+   int i_ret = flush_writer(ps_w);
+   if (close(ps_w->i_fd) != 0)
+      i_ret = -1;
+   ps_w->i_fd = -1;
+   return i_ret;
+}
+
+/*--------------------------------------------------------------------*/
+
+static int fill_reader(struct trace_reader *ps_r)
+
+/* Refill the buffer.  Return the number of bytes now available, 0 at
+   end of file, -1 on error. */
+
+{
+   ssize_t l;
+
+   if (ps_r->ui_pos < ps_r->ui_len)
+      return (int)(ps_r->ui_len - ps_r->ui_pos);
+   do
+      l = read(ps_r->i_fd, ps_r->auc_buf, TRACE_BUF_BYTES);
+   while (l < 0 && errno == EINTR);
+   if (l < 0)
+      return -1;
+   ps_r->ui_pos = 0;
+   ps_r->ui_len = (size_t)l;
+   return (int)l;
+}
+
+/*--------------------------------------------------------------------*/
+
+static int get_varint(struct trace_reader *ps_r, unsigned long long *pull_v)
+
+/* Decode one varint.  Return 1 on success, 0 if the file ended before
+   its first byte, -1 on error or a varint cut short. */
+
+{
+   unsigned long long ull_v = 0;
+   int i_shift = 0;
+   int i_first = 1;
+
+   for (;;)
+   {
+      unsigned char uc;
+      int i_avail = fill_reader(ps_r);
+      if (i_avail <= 0)
+         return (i_avail == 0 && i_first) ? 0 : -1;
+      uc = ps_r->auc_buf[ps_r->ui_pos++];
+      i_first = 0;
+      if (i_shift > 63)
+         return -1;
+      ull_v |= (unsigned long long)(uc & 0x7f) << i_shift;
+      if ((uc & 0x80) == 0)
+         break;
+      i_shift += 7;
+   }
+   *pull_v = ull_v;
+   return 1;
+}
+
+/*--------------------------------------------------------------------*/
+
+int trace_reader_open(struct trace_reader *ps_r, const char *pc_path)
+{
+   char ac_magic[8];
+   size_t ui_got = 0;
+
+   assert(ps_r != NULL);
+   assert(pc_path != NULL);
+
+   ps_r->i_fd = open(pc_path, O_RDONLY);
+   if (ps_r->i_fd < 0)
+      return -1;
+   ps_r->ui_pos = ps_r->ui_len = 0;
+   while (ui_got < sizeof(ac_magic))
+   {
+      if (fill_reader(ps_r) <= 0)
+         break;
+      ac_magic[ui_got++] = (char)ps_r->auc_buf[ps_r->ui_pos++];
+   }
+   if (ui_got != sizeof(ac_magic) || memcmp(ac_magic, TRACE_MAGIC, 8) != 0)
+   {
+      close(ps_r->i_fd);
+      errno = EINVAL;
+      return -1;
+   }
+   return 0;
+}
+
+/*--------------------------------------------------------------------*/
+
+int trace_read(struct trace_reader *ps_r, struct trace_rec *ps_rec)
+{
+   unsigned long long ull_tag, ull_v;
+   int i_ret;
+
+   i_ret = get_varint(ps_r, &ull_tag);
+   if (i_ret <= 0)
+      return i_ret;
+   if (get_varint(ps_r, &ull_v) != 1)
+      return -1;
+   ps_rec->i_op = (int)(ull_tag & 1);
+   ps_rec->ul_id = (unsigned long)(ull_tag >> 1);
+   ps_rec->ull_delta_ns = ull_v;
+   ps_rec->ui_size = 0;
+   if (ps_rec->i_op == TRACE_MALLOC)
+   {
+      if (get_varint(ps_r, &ull_v) != 1)
+         return -1;
+      ps_rec->ui_size = (size_t)ull_v;
+   }
+   return 1;
+}
+
+/*--------------------------------------------------------------------*/
+
+void trace_reader_close(struct trace_reader *ps_r)
+{
+   close(ps_r->i_fd);
+   ps_r->i_fd = -1;
+}
+
+/*--------------------------------------------------------------------*/
+
+static void *map_zeroed(size_t ui_bytes)
+{
+   void *pv = mmap(NULL, ui_bytes, PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+   return (pv == MAP_FAILED) ? NULL : pv;
+}
+
+/*--------------------------------------------------------------------*/
+
+static size_t hash_slot(const struct trace_ids *ps_ids, void *pv)
+{
+   uintptr_t u = (uintptr_t)pv;
+   u ^= u >> 33;
+   u *= (uintptr_t)0xff51afd7ed558ccdull;
+   u ^= u >> 33;
+   return (size_t)u & (ps_ids->ui_cap - 1);
+}
+
+/*--------------------------------------------------------------------*/
+
+static int ids_grow(struct trace_ids *ps_ids)
+
+/* Double the table (or create it) and rehash.  Return 0 or -1. */
+
+{
+   size_t ui_old_cap = ps_ids->ui_cap;
+   void **ppv_old_keys = ps_ids->ppv_keys;
+   unsigned long *pul_old_vals = ps_ids->pul_vals;
+   size_t ui_new_cap = ui_old_cap ? ui_old_cap * 2 : 4096;
+   void **ppv_new_keys = map_zeroed(ui_new_cap * sizeof(void *));
+   unsigned long *pul_new_vals = map_zeroed(ui_new_cap * sizeof(unsigned long));
+   size_t i;
+
+   /* Leave the old table in place unless both new arrays exist. */
+   if (ppv_new_keys == NULL || pul_new_vals == NULL)
+   {
+      if (ppv_new_keys != NULL)
+         munmap(ppv_new_keys, ui_new_cap * sizeof(void *));
+      if (pul_new_vals != NULL)
+         munmap(pul_new_vals, ui_new_cap * sizeof(unsigned long));
+      return -1;
+   }
+   ps_ids->ppv_keys = ppv_new_keys;
+   ps_ids->pul_vals = pul_new_vals;
+   ps_ids->ui_cap = ui_new_cap;
+
+   for (i = 0; i < ui_old_cap; i++)
+      if (ppv_old_keys[i] != NULL)
+      {
+         size_t j = hash_slot(ps_ids, ppv_old_keys[i]);
+         while (ps_ids->ppv_keys[j] != NULL)
+            j = (j + 1) & (ui_new_cap - 1);
+         ps_ids->ppv_keys[j] = ppv_old_keys[i];
+         ps_ids->pul_vals[j] = pul_old_vals[i];
+      }
+   if (ui_old_cap != 0)
+   {
+      munmap(ppv_old_keys, ui_old_cap * sizeof(void *));
+      munmap(pul_old_vals, ui_old_cap * sizeof(unsigned long));
+   }
+   return 0;
+}
+
+/*--------------------------------------------------------------------*/
+
+unsigned long trace_ids_assign(struct trace_ids *ps_ids, void *pv)
+{
+   unsigned long ul_id;
+   size_t j;
+
+   assert(pv != NULL);
+
+   if ((ps_ids->ui_used + 1) * 2 > ps_ids->ui_cap)
+      if (ids_grow(ps_ids) != 0)
+         return ps_ids->ul_next_id++;   /* untracked, but still unique */
+
+   if (ps_ids->ui_free_top > 0)
+      ul_id = ps_ids->pul_free_ids[--ps_ids->ui_free_top];
+   else
+      ul_id = ps_ids->ul_next_id++;
+
+   j = hash_slot(ps_ids, pv);
+   while (ps_ids->ppv_keys[j] != NULL)
+      j = (j + 1) & (ps_ids->ui_cap - 1);
+   ps_ids->ppv_keys[j] = pv;
+   ps_ids->pul_vals[j] = ul_id;
+   ps_ids->ui_used++;
+   return ul_id;
+}
+
+/*--------------------------------------------------------------------*/
+
+long trace_ids_release(struct trace_ids *ps_ids, void *pv)
+
+/* Deletion uses backward shifting so no tombstones are needed. */
+
+{
+   size_t j, k;
+   unsigned long ul_id;
+
+   if (ps_ids->ui_cap == 0 || pv == NULL)
+      return -1;
+   j = hash_slot(ps_ids, pv);
+   while (ps_ids->ppv_keys[j] != pv)
+   {
+      if (ps_ids->ppv_keys[j] == NULL)
+         return -1;
+      j = (j + 1) & (ps_ids->ui_cap - 1);
+   }
+   ul_id = ps_ids->pul_vals[j];
+
+   for (k = (j + 1) & (ps_ids->ui_cap - 1);
+        ps_ids->ppv_keys[k] != NULL;
+        k = (k + 1) & (ps_ids->ui_cap - 1))
+   {
+      size_t h = hash_slot(ps_ids, ps_ids->ppv_keys[k]);
+      /* Move k into the hole at j unless its home lies in (j, k]. */
+      if ((j < k) ? (h <= j || h > k) : (h <= j && h > k))
+      {
+         ps_ids->ppv_keys[j] = ps_ids->ppv_keys[k];
+         ps_ids->pul_vals[j] = ps_ids->pul_vals[k];
+         j = k;
+      }
+   }
+   ps_ids->ppv_keys[j] = NULL;
+   ps_ids->ui_used--;
+
+   if (ps_ids->ui_free_top == ps_ids->ui_free_cap)
+   {
+      size_t ui_new_cap = ps_ids->ui_free_cap ? ps_ids->ui_free_cap * 2 : 4096;
+      unsigned long *pul = map_zeroed(ui_new_cap * sizeof(unsigned long));
+      if (pul == NULL)
+         return (long)ul_id;            /* the id is simply not reused */
+      if (ps_ids->ui_free_cap != 0)
+      {
+         memcpy(pul, ps_ids->pul_free_ids,
+            ps_ids->ui_free_top * sizeof(unsigned long));
+         munmap(ps_ids->pul_free_ids,
+            ps_ids->ui_free_cap * sizeof(unsigned long));
+      }
+      ps_ids->pul_free_ids = pul;
+      ps_ids->ui_free_cap = ui_new_cap;
+   }
+   ps_ids->pul_free_ids[ps_ids->ui_free_top++] = ul_id;
+   return (long)ul_id;
+}
@@ -0,0 +1,88 @@
+/*--------------------------------------------------------------------*/
+/* trace.h                                                            */
+/* Compact binary allocation traces: recording and streaming replay   */
+/*--------------------------------------------------------------------*/
+
+#ifndef TRACE_INCLUDED
+#define TRACE_INCLUDED
+
+#include <stddef.h>
+
+/* File layout: the 8-byte magic TRACE_MAGIC followed by records.  A
+   record is a sequence of unsigned LEB128 varints:
+      (id << 1) | op,  delta_ns,  [size, for TRACE_MALLOC only]
+   id is a small object number that is reused after the object is
+   freed, so the largest id is close to the peak live object count.
+   delta_ns is the time since the previous record. */
+
+#define TRACE_MAGIC "HMTRACE1"
+
+enum {TRACE_MALLOC = 0, TRACE_FREE = 1};
+
+/* Bytes buffered between write()/read() system calls. */
+enum {TRACE_BUF_BYTES = 1 << 16};
+
+struct trace_rec {
+   int i_op;                      /* TRACE_MALLOC or TRACE_FREE */
+   unsigned long ul_id;           /* object number */
+   size_t ui_size;                /* requested bytes (TRACE_MALLOC) */
+   unsigned long long ull_delta_ns;
+};
+
+struct trace_writer {
+   int i_fd;
+   size_t ui_len;
+   unsigned long long ull_last_ns;
+   unsigned char auc_buf[TRACE_BUF_BYTES];
+};
+
+struct trace_reader {
+   int i_fd;
+   size_t ui_pos, ui_len;
+   unsigned char auc_buf[TRACE_BUF_BYTES];
+};
+
+/* Pointer -> object id map used while recording.  Its storage comes
+   from mmap(), never from malloc(), so it can be used inside a
+   malloc() replacement and does not disturb an sbrk()-based heap. */
+struct trace_ids {
+   void **ppv_keys;               /* open addressing, NULL = empty */
+   unsigned long *pul_vals;
+   size_t ui_cap, ui_used;
+   unsigned long *pul_free_ids;   /* stack of released ids */
+   size_t ui_free_top, ui_free_cap;
+   unsigned long ul_next_id;
+};
+
+/*--------------------------------------------------------------------*/
+
+int trace_writer_open(struct trace_writer *ps_w, const char *pc_path);
+/* Create (or truncate) the trace file pc_path and write its magic.
+   Return 0 on success, -1 with errno set otherwise. */
+
+int trace_write(struct trace_writer *ps_w, int i_op, unsigned long ul_id,
+   size_t ui_size);
+/* Append one record, timestamped now.  Return 0 or -1. */
+
+int trace_writer_close(struct trace_writer *ps_w);
+/* Flush and close.  Return 0 or -1. */
+
+int trace_reader_open(struct trace_reader *ps_r, const char *pc_path);
+/* Open pc_path and check its magic.  Return 0, or -1 if the file
+   cannot be read or is not a trace. */
+
+int trace_read(struct trace_reader *ps_r, struct trace_rec *ps_rec);
+/* Read the next record into *ps_rec.  Return 1 if a record was read,
+   0 at a clean end of file, -1 on an I/O error or truncated record. */
+
+void trace_reader_close(struct trace_reader *ps_r);
+
+unsigned long trace_ids_assign(struct trace_ids *ps_ids, void *pv);
+/* Give the live object at pv an unused id, reusing released ids
+   first, and return it. */
+
+long trace_ids_release(struct trace_ids *ps_ids, void *pv);
+/* Forget the object at pv and return its id, or -1 if pv is not a
+   known live object. */
+
+#endif
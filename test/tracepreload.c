@@ -0,0 +1,189 @@
+/*--------------------------------------------------------------------*/
+/* tracepreload.c                                                     */
+/* LD_PRELOAD recorder: writes a process's malloc/free calls to a     */
+/* trace (see trace.h) for replay with replayheapmgr.                 */
+/*                                                                    */
+/*    HEAPMGR_TRACE=out.trace LD_PRELOAD=./tracepreload.so program    */
+/*--------------------------------------------------------------------*/
+
+#define _GNU_SOURCE
+#include "trace.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <malloc.h>
+
+/* glibc's own entry points, so no dlsym() bootstrap is needed. */
+extern void *__libc_malloc(size_t);
+extern void *__libc_calloc(size_t, size_t);
+extern void *__libc_realloc(void *, size_t);
+extern void *__libc_memalign(size_t, size_t);
+extern void *__libc_valloc(size_t);
+extern void *__libc_pvalloc(size_t);
+extern void __libc_free(void *);
+
+static struct trace_writer s_writer;
+static struct trace_ids s_ids;
+static int i_active = 0;              /* writer is open */
+static volatile char c_lock = 0;      /* serializes writer and ids */
+
+/* Set while this thread is inside the recorder, so allocations made
+   by the recorder itself (none are expected) are not traced. */
+static __thread int i_busy __attribute__((tls_model("initial-exec")));
+
+/*--------------------------------------------------------------------*/
+
+static void lock(void)
+{
+   while (__atomic_test_and_set(&c_lock, __ATOMIC_ACQUIRE))
+      ;
+}
+
+static void unlock(void)
+{
+   __atomic_clear(&c_lock, __ATOMIC_RELEASE);
+}
+
+/*--------------------------------------------------------------------*/
+
+static void record_malloc(void *pv, size_t ui_size)
+{
+   if (!i_active || i_busy || pv == NULL)
+      return;
+   i_busy = 1;
+   lock();
+   trace_write(&s_writer, TRACE_MALLOC, trace_ids_assign(&s_ids, pv), ui_size);
+   unlock();
+   i_busy = 0;
+}
+
+static void record_free(void *pv)
+{
+   long l_id;
+
+   if (!i_active || i_busy || pv == NULL)
+      return;
+   i_busy = 1;
+   lock();
+   l_id = trace_ids_release(&s_ids, pv);
+   if (l_id >= 0)          /* skip objects allocated before recording */
+      trace_write(&s_writer, TRACE_FREE, (unsigned long)l_id, 0);
+   unlock();
+   i_busy = 0;
+}
+
+/*--------------------------------------------------------------------*/
+
+__attribute__((constructor)) static void start_recording(void)
+{
+   const char *pc_path = getenv("HEAPMGR_TRACE");
+   if (pc_path != NULL && trace_writer_open(&s_writer, pc_path) == 0)
+      i_active = 1;
+}
+
+__attribute__((destructor)) static void stop_recording(void)
+{
+   if (!i_active)
+      return;
+   lock();
+   i_active = 0;
+   trace_writer_close(&s_writer);
+   unlock();
+}
+
+/*--------------------------------------------------------------------*/
+
+void *malloc(size_t ui_size)
+{
+   void *pv = __libc_malloc(ui_size);
+   record_malloc(pv, ui_size);
+   return pv;
+}
+
+void *calloc(size_t ui_n, size_t ui_size)
+{
+   void *pv;
+
+   if (ui_size != 0 && ui_n > SIZE_MAX / ui_size)
+   {
+      errno = ENOMEM;
+      return NULL;
+   }
+   pv = __libc_calloc(ui_n, ui_size);
+   record_malloc(pv, ui_n * ui_size);
+   return pv;
+}
+
+/* A realloc() is recorded as a free of the old object followed by a
+   malloc of the new one; replay does not model the copy. */
+void *realloc(void *pv_old, size_t ui_size)
+{
+   void *pv;
+
+   record_free(pv_old);
+   pv = __libc_realloc(pv_old, ui_size);
+   if (pv != NULL)
+      record_malloc(pv, ui_size);
+   else if (pv_old != NULL && ui_size != 0)   /* failed: old stays live */
+      record_malloc(pv_old, malloc_usable_size(pv_old));
+   return pv;
+}
+
+/* The aligned allocators are recorded as plain mallocs of their size;
+   the trace format has no alignment.  They all go through
+   __libc_memalign(), so only the argument checks are done here. */
+void *memalign(size_t ui_align, size_t ui_size)
+{
+   void *pv = __libc_memalign(ui_align, ui_size);
+   record_malloc(pv, ui_size);
+   return pv;
+}
+
+void *aligned_alloc(size_t ui_align, size_t ui_size)
+{
+   void *pv;
+
+   if (ui_align == 0 || (ui_align & (ui_align - 1)) != 0)
+   {
+      errno = EINVAL;
+      return NULL;
+   }
+   pv = __libc_memalign(ui_align, ui_size);
+   record_malloc(pv, ui_size);
+   return pv;
+}
+
+int posix_memalign(void **ppv, size_t ui_align, size_t ui_size)
+{
+   void *pv;
+
+   if (ui_align % sizeof(void *) != 0 || (ui_align & (ui_align - 1)) != 0
+       || ui_align == 0)
+      return EINVAL;
+   if ((pv = __libc_memalign(ui_align, ui_size)) == NULL)
+      return ENOMEM;
+   record_malloc(pv, ui_size);
+   *ppv = pv;
+   return 0;
+}
+
+void *valloc(size_t ui_size)
+{
+   void *pv = __libc_valloc(ui_size);
+   record_malloc(pv, ui_size);
+   return pv;
+}
+
+void *pvalloc(size_t ui_size)
+{
+   void *pv = __libc_pvalloc(ui_size);
+   record_malloc(pv, ui_size);
+   return pv;
+}
+
+void free(void *pv)
+{
+   record_free(pv);
+   __libc_free(pv);
+}
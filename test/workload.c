@@ -0,0 +1,241 @@
+/*--------------------------------------------------------------------*/
+/* workload.c                                                         */
+/*--------------------------------------------------------------------*/
+
+#include "workload.h"
+#include <math.h>
+#include <string.h>
+
+/* Probability at which step i of a quantile table is evaluated.
+   Offset by half a step so that the end points stay finite. */
+#define STEP_PROBABILITY(i) (((double)(i) + 0.5) / (QUANTILE_STEPS + 1))
+
+/* Size class width of SIZE_ZIPF, and its exponent. */
+enum {ZIPF_CLASS_BYTES = 16};
+static const double ZIPF_EXPONENT = 1.1;
+
+static const double LOGNORMAL_SIGMA = 1.2;
+
+/*--------------------------------------------------------------------*/
+
+void prng_seed(struct prng *ps_rng, unsigned long long ull_seed)
+
+/* Scramble ull_seed with one splitmix64 step, so that nearby seeds
+   give unrelated sequences and the state is never 0. */
+
+{
+   unsigned long long z = ull_seed + 0x9E3779B97F4A7C15ull;
+   z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+   z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+   z ^= z >> 31;
+   ps_rng->ull_state = (z != 0) ? z : 1;
+}
+
+/*--------------------------------------------------------------------*/
+
+static double normal_quantile(double p)
+
+/* Inverse of the standard normal CDF, 0 < p < 1, by Acklam's
+   rational approximation (relative error below 1.2e-9). */
+
+{
+   static const double a[] = {-3.969683028665376e+01, 2.209460984245205e+02,
+      -2.759285104469687e+02, 1.383577518672690e+02,
+      -3.066479806614716e+01, 2.506628277459239e+00};
+   static const double b[] = {-5.447609879822406e+01, 1.615858368580409e+02,
+      -1.556989798598866e+02, 6.680131188771972e+01,
+      -1.328068155288572e+01};
+   static const double c[] = {-7.784894002430293e-03, -3.223964580411365e-01,
+      -2.400758277161838e+00, -2.549732539343734e+00,
+      4.374664141464968e+00, 2.938163982698783e+00};
+   static const double d[] = {7.784695709041462e-03, 3.224671290700398e-01,
+      2.445134137142996e+00, 3.754408661907416e+00};
+   const double p_low = 0.02425;
+   double q, r;
+
+   if (p < p_low)
+   {
+      q = sqrt(-2.0 * log(p));
+      return (((((c[0]*q + c[1])*q + c[2])*q + c[3])*q + c[4])*q + c[5])
+         / ((((d[0]*q + d[1])*q + d[2])*q + d[3])*q + 1.0);
+   }
+   if (p > 1.0 - p_low)
+      return -normal_quantile(1.0 - p);
+   q = p - 0.5;
+   r = q * q;
+   return (((((a[0]*r + a[1])*r + a[2])*r + a[3])*r + a[4])*r + a[5]) * q
+      / (((((b[0]*r + b[1])*r + b[2])*r + b[3])*r + b[4])*r + 1.0);
+}
+
+/*--------------------------------------------------------------------*/
+
+static void fill_zipf(struct quantile_table *ps_table, size_t ui_max)
+
+/* Invert the CDF of SIZE_ZIPF: step i gets the upper byte bound of
+   the first class whose cumulative probability reaches its p. */
+
+{
+   size_t ui_classes = (ui_max + ZIPF_CLASS_BYTES - 1) / ZIPF_CLASS_BYTES;
+   double d_total = 0.0, d_cum = 0.0;
+   size_t k = 0;
+   int i;
+
+   for (k = 1; k <= ui_classes; k++)
+      d_total += pow((double)k, -ZIPF_EXPONENT);
+
+   k = 1;
+   d_cum = 1.0 / d_total;
+   for (i = 0; i <= QUANTILE_STEPS; i++)
+   {
+      double p = STEP_PROBABILITY(i);
+      while (d_cum < p && k < ui_classes)
+      {
+         k++;
+         d_cum += pow((double)k, -ZIPF_EXPONENT) / d_total;
+      }
+      ps_table->ad_q[i] = (double)(k * ZIPF_CLASS_BYTES);
+   }
+}
+
+/*--------------------------------------------------------------------*/
+
+int size_dist_from_name(const char *pc_name, enum size_dist *pe_dist)
+{
+   static const char *apc_names[] = {"uniform", "lognormal", "zipf", "bimodal"};
+   int i;
+
+   for (i = 0; i < (int)(sizeof(apc_names) / sizeof(apc_names[0])); i++)
+      if (strcmp(pc_name, apc_names[i]) == 0)
+      {
+         *pe_dist = (enum size_dist)i;
+         return 0;
+      }
+   return -1;
+}
+
+/*--------------------------------------------------------------------*/
+
+void size_gen_init(struct size_gen *ps_gen, enum size_dist e_dist,
+   size_t ui_max)
+{
+   double d_max = (double)ui_max;
+   double d_small = (ui_max < 64) ? d_max : 64.0;
+   int i;
+
+   ps_gen->ui_max = ui_max;
+   if (e_dist == SIZE_ZIPF)
+   {
+      fill_zipf(&ps_gen->s_table, ui_max);
+      return;
+   }
+   for (i = 0; i <= QUANTILE_STEPS; i++)
+   {
+      double p = STEP_PROBABILITY(i);
+      double d;
+      switch (e_dist)
+      {
+      case SIZE_LOGNORMAL:
+         d = (d_max / 16.0) * exp(LOGNORMAL_SIGMA * normal_quantile(p));
+         break;
+      case SIZE_BIMODAL:
+         if (p < 0.9)
+            d = 1.0 + (p / 0.9) * (d_small - 1.0);
+         else
+            d = d_max / 2.0 + ((p - 0.9) / 0.1) * (d_max / 2.0);
+         break;
+      default:
+         d = 1.0 + p * (d_max - 1.0);
+         break;
+      }
+      ps_gen->s_table.ad_q[i] = d;
+   }
+}
+
+/*--------------------------------------------------------------------*/
+
+int life_dist_from_name(const char *pc_name, enum life_dist *pe_dist)
+{
+   if (strcmp(pc_name, "exp") == 0)
+      *pe_dist = LIFE_EXPONENTIAL;
+   else if (strcmp(pc_name, "phase") == 0)
+      *pe_dist = LIFE_PHASE;
+   else
+      return -1;
+   return 0;
+}
+
+/*--------------------------------------------------------------------*/
+
+void life_gen_init(struct life_gen *ps_gen, enum life_dist e_dist,
+   double d_mean, size_t ui_max_size)
+{
+   int i;
+
+   ps_gen->e_dist = e_dist;
+   ps_gen->d_mean = (d_mean < 1.0) ? 1.0 : d_mean;
+   ps_gen->l_phase = (long)ps_gen->d_mean;
+   ps_gen->ui_max_size = (ui_max_size > 0) ? ui_max_size : 1;
+   for (i = 0; i <= QUANTILE_STEPS; i++)
+      ps_gen->s_exp.ad_q[i] = -log(1.0 - STEP_PROBABILITY(i));
+}
+
+/*--------------------------------------------------------------------*/
+
+long life_gen_death(const struct life_gen *ps_gen, struct prng *ps_rng,
+   long l_now, size_t ui_size)
+{
+   double d_s = (double)ui_size / (double)ps_gen->ui_max_size;
+   double d_exp = quantile_sample(&ps_gen->s_exp, ps_rng);
+   long l_phase_end;
+
+   if (ps_gen->e_dist == LIFE_EXPONENTIAL)
+      return l_now + 1 + (long)(d_exp * ps_gen->d_mean * (0.5 + d_s));
+
+   /* LIFE_PHASE. */
+   l_phase_end = (l_now / ps_gen->l_phase + 1) * ps_gen->l_phase;
+   if ((double)(prng_next(ps_rng) >> 11) * (1.0 / 9007199254740992.0)
+       < 0.1 + 0.4 * d_s)
+      l_phase_end += ps_gen->l_phase * (1 + (long)(2.0 * d_exp));
+   return l_phase_end;
+}
+
+/*--------------------------------------------------------------------*/
+
+void death_heap_push(struct death_heap *ps_heap, long l_obj)
+{
+   const long *pl_death = ps_heap->pl_death;
+   long *pl_heap = ps_heap->pl_heap;
+   long i = ps_heap->l_count++;
+
+   while (i > 0 && pl_death[pl_heap[(i - 1) / 2]] > pl_death[l_obj])
+   {
+      pl_heap[i] = pl_heap[(i - 1) / 2];
+      i = (i - 1) / 2;
+   }
+   pl_heap[i] = l_obj;
+}
+
+long death_heap_pop(struct death_heap *ps_heap)
+{
+   const long *pl_death = ps_heap->pl_death;
+   long *pl_heap = ps_heap->pl_heap;
+   long l_top = pl_heap[0];
+   long l_last = pl_heap[--ps_heap->l_count];
+   long i = 0;
+
+   for (;;)
+   {
+      long l_child = 2 * i + 1;
+      if (l_child >= ps_heap->l_count)
+         break;
+      if (l_child + 1 < ps_heap->l_count
+          && pl_death[pl_heap[l_child + 1]] < pl_death[pl_heap[l_child]])
+         l_child++;
+      if (pl_death[pl_heap[l_child]] >= pl_death[l_last])
+         break;
+      pl_heap[i] = pl_heap[l_child];
+      i = l_child;
+   }
+   pl_heap[i] = l_last;
+   return l_top;
+}
@@ -0,0 +1,157 @@
+/*--------------------------------------------------------------------*/
+/* workload.h                                                         */
+/* Seedable generators for allocation sizes and object lifetimes      */
+/*--------------------------------------------------------------------*/
+
+#ifndef WORKLOAD_INCLUDED
+#define WORKLOAD_INCLUDED
+
+#include <stddef.h>
+
+/* xorshift64* generator.  A few cycles per number, so drawing sizes
+   and lifetimes does not show up in the timings the way glibc's
+   locked rand() does. */
+struct prng {
+   unsigned long long ull_state;
+};
+
+/* Seed *ps_rng.  Every seed, including 0, gives a usable state. */
+void prng_seed(struct prng *ps_rng, unsigned long long ull_seed);
+
+static inline unsigned long long prng_next(struct prng *ps_rng)
+{
+   unsigned long long x = ps_rng->ull_state;
+   x ^= x >> 12;
+   x ^= x << 25;
+   x ^= x >> 27;
+   ps_rng->ull_state = x;
+   return x * 0x2545F4914F6CDD1Dull;
+}
+
+/*--------------------------------------------------------------------*/
+
+/* A distribution stored as its inverse CDF at QUANTILE_STEPS + 1
+   evenly spaced probabilities.  Sampling picks a step with the top
+   bits of one random number and interpolates with the next bits, so
+   every distribution costs the same: one prng_next() and a lookup. */
+enum {QUANTILE_BITS = 12};
+enum {QUANTILE_STEPS = 1 << QUANTILE_BITS};
+
+struct quantile_table {
+   double ad_q[QUANTILE_STEPS + 1];
+};
+
+static inline double quantile_sample(const struct quantile_table *ps_table,
+   struct prng *ps_rng)
+{
+   unsigned long long x = prng_next(ps_rng);
+   unsigned i = (unsigned)(x >> (64 - QUANTILE_BITS));
+   double d_frac = (double)((x >> 20) & 0xFFFFFFFFull) * (1.0 / 4294967296.0);
+   return ps_table->ad_q[i] + d_frac * (ps_table->ad_q[i + 1] - ps_table->ad_q[i]);
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Size distributions, all clamped to 1 .. ui_max bytes:
+      SIZE_UNIFORM: uniform, like rand() % max + 1.
+      SIZE_LOGNORMAL: log-normal with median max/16 and sigma 1.2;
+         heavy right tail, about 1% clamped to max.
+      SIZE_ZIPF: 16-byte size classes ranked by popularity with
+         P(class k) proportional to 1/k^1.1, so a few small sizes
+         dominate and large ones are rare.
+      SIZE_BIMODAL: 90% small (1 .. 64 bytes), 10% large
+         (max/2 .. max). */
+enum size_dist {SIZE_UNIFORM, SIZE_LOGNORMAL, SIZE_ZIPF, SIZE_BIMODAL};
+
+struct size_gen {
+   struct quantile_table s_table;
+   size_t ui_max;
+};
+
+/* Set *pe_dist to the distribution called pc_name ("uniform",
+   "lognormal", "zipf" or "bimodal").  Return 0, or -1 if there is no
+   such distribution. */
+int size_dist_from_name(const char *pc_name, enum size_dist *pe_dist);
+
+void size_gen_init(struct size_gen *ps_gen, enum size_dist e_dist,
+   size_t ui_max);
+
+static inline size_t size_gen_next(const struct size_gen *ps_gen,
+   struct prng *ps_rng)
+{
+   double d = quantile_sample(&ps_gen->s_table, ps_rng) + 0.5;
+   if (d < 1.0)
+      return 1;
+   if (d >= (double)ps_gen->ui_max)
+      return ps_gen->ui_max;
+   return (size_t)d;
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Lifetime models.  A lifetime is counted in allocations: an object
+   allocated at time t with death time t + n is freed after n more
+   objects have been allocated.  In both models larger objects tend
+   to live longer.
+      LIFE_EXPONENTIAL: exponential with mean d_mean * (0.5 + s),
+         where s = size / max_size.
+      LIFE_PHASE: the run is split into phases of d_mean allocations.
+         Most objects die when their phase ends; with probability
+         0.1 + 0.4 * s an object survives one or more further
+         phases. */
+enum life_dist {LIFE_EXPONENTIAL, LIFE_PHASE};
+
+struct life_gen {
+   enum life_dist e_dist;
+   double d_mean;
+   long l_phase;
+   size_t ui_max_size;
+   struct quantile_table s_exp;     /* unit-mean exponential */
+};
+
+/* Set *pe_dist to the model called pc_name ("exp" or "phase").
+   Return 0, or -1 if there is no such model. */
+int life_dist_from_name(const char *pc_name, enum life_dist *pe_dist);
+
+void life_gen_init(struct life_gen *ps_gen, enum life_dist e_dist,
+   double d_mean, size_t ui_max_size);
+
+/* Return the death time, always later than l_now, of an object of
+   ui_size bytes allocated at time l_now. */
+long life_gen_death(const struct life_gen *ps_gen, struct prng *ps_rng,
+   long l_now, size_t ui_size);
+
+/*--------------------------------------------------------------------*/
+
+/* Objects waiting to die: a binary min-heap of object numbers ordered
+   by their death times.  The caller owns both arrays; pl_death[l] is
+   the death time of object l, and pl_heap must have room for every
+   object that can be waiting at once. */
+struct death_heap {
+   const long *pl_death;
+   long *pl_heap;
+   long l_count;
+};
+
+static inline void death_heap_init(struct death_heap *ps_heap,
+   const long *pl_death, long *pl_heap)
+{
+   ps_heap->pl_death = pl_death;
+   ps_heap->pl_heap = pl_heap;
+   ps_heap->l_count = 0;
+}
+
+/* Return the earliest death time in *ps_heap, which must not be
+   empty. */
+static inline long death_heap_first(const struct death_heap *ps_heap)
+{
+   return ps_heap->pl_death[ps_heap->pl_heap[0]];
+}
+
+/* Add object l_obj, whose death time is pl_death[l_obj]. */
+void death_heap_push(struct death_heap *ps_heap, long l_obj);
+
+/* Remove and return the object with the earliest death time. */
+long death_heap_pop(struct death_heap *ps_heap);
+
+#endif